@@ -0,0 +1,410 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Stores engine-benchmark results as named baselines and compares new results against them.
+ *
+ *   benchmark-compare save <baseline> <results.json>...
+ *   benchmark-compare compare <baseline> <results.json>... [--threshold <percent>]
+ *
+ * Baselines are kept in the directory given by --dir (default: benchmark-baselines).  Several
+ * results files (runs) may be given, their samples are pooled.  A benchmark is a significant
+ * regression when its median ns/op is slower than the baseline median by more than the threshold
+ * (default 5%) and by more than 3 times the combined noise, measured by the median absolute
+ * deviation (MAD) of the samples.  A benchmark in the baseline that the current run did not
+ * produce is reported as missing.  compare exits with 1 if any benchmark regressed or is missing.
+ */
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+namespace {
+    // Just enough of a JSON reader for the files engine-benchmark writes.
+    struct JsonValue {
+        enum Type { null, boolean, number, string, array, object };
+        Type type = null;
+        double numberValue = 0.0;
+        std::string stringValue;
+        std::vector<JsonValue> arrayValue;
+        std::map<std::string, JsonValue> objectValue;
+
+        JsonValue const &operator[](std::string const &key) const {
+            auto it = objectValue.find(key);
+            if (type != object || it == objectValue.end()) {
+                throw std::runtime_error("Missing JSON field: " + key);
+            }
+            return it->second;
+        }
+    };
+
+    class JsonParser {
+    public:
+        explicit JsonParser(std::string text)
+                : m_text{std::move(text)},
+                  m_pos{0}
+        {
+        }
+
+        JsonValue parse() {
+            JsonValue value = parseValue();
+            skipSpace();
+            if (m_pos != m_text.size()) {
+                throw std::runtime_error("Trailing data in JSON");
+            }
+            return value;
+        }
+
+    private:
+        std::string m_text;
+        size_t m_pos;
+
+        void skipSpace() {
+            while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) {
+                m_pos++;
+            }
+        }
+
+        void expect(char c) {
+            skipSpace();
+            if (m_pos >= m_text.size() || m_text[m_pos] != c) {
+                throw std::runtime_error(std::string("Invalid JSON: expected ") + c);
+            }
+            m_pos++;
+        }
+
+        bool consume(char c) {
+            skipSpace();
+            if (m_pos < m_text.size() && m_text[m_pos] == c) {
+                m_pos++;
+                return true;
+            }
+            return false;
+        }
+
+        bool consumeWord(char const *word) {
+            size_t length = std::char_traits<char>::length(word);
+            if (m_text.compare(m_pos, length, word) == 0) {
+                m_pos += length;
+                return true;
+            }
+            return false;
+        }
+
+        std::string parseString() {
+            expect('"');
+            std::string out;
+            while (m_pos < m_text.size() && m_text[m_pos] != '"') {
+                char c = m_text[m_pos++];
+                if (c == '\\' && m_pos < m_text.size()) {
+                    char escaped = m_text[m_pos++];
+                    switch (escaped) {
+                        case 'n': out.push_back('\n'); break;
+                        case 't': out.push_back('\t'); break;
+                        case 'u': out.push_back('?'); m_pos = std::min(m_pos + 4, m_text.size()); break;
+                        default: out.push_back(escaped); break;
+                    }
+                } else {
+                    out.push_back(c);
+                }
+            }
+            expect('"');
+            return out;
+        }
+
+        JsonValue parseValue() {
+            skipSpace();
+            if (m_pos >= m_text.size()) {
+                throw std::runtime_error("Invalid JSON: unexpected end");
+            }
+
+            JsonValue value;
+            char c = m_text[m_pos];
+            if (c == '{') {
+                m_pos++;
+                value.type = JsonValue::object;
+                if (!consume('}')) {
+                    do {
+                        skipSpace();
+                        std::string key = parseString();
+                        expect(':');
+                        value.objectValue[key] = parseValue();
+                    } while (consume(','));
+                    expect('}');
+                }
+            } else if (c == '[') {
+                m_pos++;
+                value.type = JsonValue::array;
+                if (!consume(']')) {
+                    do {
+                        value.arrayValue.push_back(parseValue());
+                    } while (consume(','));
+                    expect(']');
+                }
+            } else if (c == '"') {
+                value.type = JsonValue::string;
+                value.stringValue = parseString();
+            } else if (consumeWord("true")) {
+                value.type = JsonValue::boolean;
+                value.numberValue = 1.0;
+            } else if (consumeWord("false")) {
+                value.type = JsonValue::boolean;
+            } else if (consumeWord("null")) {
+                value.type = JsonValue::null;
+            } else {
+                char const *start = m_text.c_str() + m_pos;
+                char *end = nullptr;
+                value.type = JsonValue::number;
+                value.numberValue = std::strtod(start, &end);
+                if (end == start) {
+                    throw std::runtime_error("Invalid JSON value");
+                }
+                m_pos += static_cast<size_t>(end - start);
+            }
+            return value;
+        }
+    };
+
+    std::string readFile(std::string const &path) {
+        std::ifstream in{path};
+        if (!in) {
+            throw std::runtime_error("Could not open: " + path);
+        }
+        std::stringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    struct Samples {
+        std::vector<double> nsPerOp;
+        std::vector<double> allocsPerOp;
+    };
+
+    // benchmark name -> samples pooled over all the runs given.
+    using ResultSet = std::map<std::string, Samples>;
+
+    void addResults(ResultSet &results, JsonValue const &json) {
+        for (auto const &benchmark : json["benchmarks"].arrayValue) {
+            Samples &samples = results[benchmark["name"].stringValue];
+            auto it = benchmark.objectValue.find("ns_per_op_samples");
+            if (it != benchmark.objectValue.end() && !it->second.arrayValue.empty()) {
+                for (auto const &sample : it->second.arrayValue) {
+                    samples.nsPerOp.push_back(sample.numberValue);
+                }
+            } else {
+                samples.nsPerOp.push_back(benchmark["ns_per_op"].numberValue);
+            }
+            samples.allocsPerOp.push_back(benchmark["allocs_per_op"].numberValue);
+        }
+    }
+
+    ResultSet loadResults(std::vector<std::string> const &paths) {
+        ResultSet results;
+        for (auto const &path : paths) {
+            addResults(results, JsonParser{readFile(path)}.parse());
+        }
+        return results;
+    }
+
+    double median(std::vector<double> values) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        if (values.size() % 2 == 0) {
+            return (values[middle - 1] + values[middle]) / 2.0;
+        }
+        return values[middle];
+    }
+
+    void writeResults(std::ostream &out, ResultSet const &results) {
+        out << "{\n  \"version\": 1,\n  \"benchmarks\": [";
+        char const *separator = "\n";
+        for (auto const &entry : results) {
+            Samples const &samples = entry.second;
+            out << separator << "    {\"name\": \"" << entry.first << "\", \"ns_per_op_samples\": [";
+            for (size_t i = 0; i < samples.nsPerOp.size(); i++) {
+                out << (i == 0 ? "" : ", ") << samples.nsPerOp[i];
+            }
+            out << "], \"allocs_per_op\": "
+                << median(samples.allocsPerOp) << "}";
+            separator = ",\n";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    // median absolute deviation, scaled to estimate the standard deviation of normal noise.
+    double mad(std::vector<double> const &values) {
+        double center = median(values);
+        std::vector<double> deviations;
+        for (double value : values) {
+            deviations.push_back(std::fabs(value - center));
+        }
+        return 1.4826 * median(deviations);
+    }
+
+    char const *category(std::string const &name) {
+        if (name.compare(0, 9, "loadModel") == 0) {
+            return "mesh-build";
+        } else if (name.compare(0, 6, "Random") == 0) {
+            return "rng";
+        } else if (name.compare(0, 6, "Filter") == 0) {
+            return "filter";
+        } else if (name.compare(0, 10, "DiceRoller") == 0) {
+            return "roller";
+        } else if (name.compare(0, 16, "DiceDistribution") == 0) {
+            return "distribution";
+        } else if (name.compare(0, 13, "PackedDiceSet") == 0) {
+            return "config";
+        } else if (name.compare(0, 12, "TextureAtlas") == 0) {
+            return "texture";
+        }
+        return "physics";
+    }
+
+    struct Arguments {
+        std::string command;
+        std::string baseline;
+        std::vector<std::string> resultFiles;
+        std::string directory = "benchmark-baselines";
+        double thresholdPercent = 5.0;
+    };
+
+    Arguments parseArguments(int argc, char *argv[]) {
+        Arguments args;
+        std::vector<std::string> positional;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--dir" && i + 1 < argc) {
+                args.directory = argv[++i];
+            } else if (arg == "--threshold" && i + 1 < argc) {
+                args.thresholdPercent = std::strtod(argv[++i], nullptr);
+            } else {
+                positional.push_back(arg);
+            }
+        }
+
+        if (positional.size() < 3 || (positional[0] != "save" && positional[0] != "compare")) {
+            throw std::runtime_error("usage: benchmark-compare save|compare <baseline> <results.json>... "
+                                     "[--dir <baselines directory>] [--threshold <percent>]");
+        }
+        args.command = positional[0];
+        args.baseline = positional[1];
+        args.resultFiles.assign(positional.begin() + 2, positional.end());
+        return args;
+    }
+
+    std::string baselinePath(Arguments const &args) {
+        return args.directory + "/" + args.baseline + ".json";
+    }
+
+    int save(Arguments const &args) {
+        ResultSet results = loadResults(args.resultFiles);
+        mkdir(args.directory.c_str(), 0755);
+        std::ofstream out{baselinePath(args)};
+        if (!out) {
+            throw std::runtime_error("Could not write baseline: " + baselinePath(args));
+        }
+        writeResults(out, results);
+        std::cout << "Saved " << results.size() << " benchmarks to " << baselinePath(args) << std::endl;
+        return 0;
+    }
+
+    int compare(Arguments const &args) {
+        ResultSet baseline = loadResults({baselinePath(args)});
+        ResultSet current = loadResults(args.resultFiles);
+
+        uint32_t nbrRegressions = 0;
+        std::printf("%-12s %-40s %14s %14s %9s %12s  %s\n", "category", "benchmark", "baseline ns",
+                    "current ns", "delta", "allocs/op", "verdict");
+        for (auto const &entry : current) {
+            auto it = baseline.find(entry.first);
+            double currentMedian = median(entry.second.nsPerOp);
+            double allocs = median(entry.second.allocsPerOp);
+            if (it == baseline.end()) {
+                std::printf("%-12s %-40s %14s %14.1f %9s %12.2f  %s\n", category(entry.first),
+                            entry.first.c_str(), "-", currentMedian, "-", allocs, "new");
+                continue;
+            }
+
+            double baselineMedian = median(it->second.nsPerOp);
+            double delta = currentMedian - baselineMedian;
+            double deltaPercent = baselineMedian > 0.0 ? 100.0 * delta / baselineMedian : 0.0;
+            double noise = std::sqrt(std::pow(mad(it->second.nsPerOp), 2) +
+                                     std::pow(mad(entry.second.nsPerOp), 2));
+            bool significant = std::fabs(delta) > 3.0 * noise &&
+                               std::fabs(deltaPercent) > args.thresholdPercent;
+
+            char const *verdict = "same";
+            if (significant && delta > 0.0) {
+                verdict = "REGRESSION";
+                nbrRegressions++;
+            } else if (significant) {
+                verdict = "faster";
+            }
+            std::printf("%-12s %-40s %14.1f %14.1f %+8.1f%% %12.2f  %s\n", category(entry.first),
+                        entry.first.c_str(), baselineMedian, currentMedian, deltaPercent, allocs,
+                        verdict);
+        }
+
+        uint32_t nbrMissing = 0;
+        for (auto const &entry : baseline) {
+            if (current.find(entry.first) == current.end()) {
+                std::printf("%-12s %-40s %14.1f %14s %9s %12s  %s\n", category(entry.first),
+                            entry.first.c_str(), median(entry.second.nsPerOp), "-", "-", "-",
+                            "MISSING");
+                nbrMissing++;
+            }
+        }
+
+        if (nbrRegressions > 0) {
+            std::printf("%u significant regression(s) against baseline %s\n", nbrRegressions,
+                        args.baseline.c_str());
+        }
+        if (nbrMissing > 0) {
+            std::printf("%u benchmark(s) in baseline %s missing from the current run\n", nbrMissing,
+                        args.baseline.c_str());
+        }
+        return nbrRegressions > 0 || nbrMissing > 0 ? 1 : 0;
+    }
+} /* namespace */
+
+int main(int argc, char *argv[]) {
+    try {
+        Arguments args = parseArguments(argc, argv);
+        if (args.command == "save") {
+            return save(args);
+        }
+        return compare(args);
+    } catch (std::exception &e) {
+        std::cerr << "benchmark-compare: " << e.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,606 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Microbenchmarks for the platform independent engine core.  Build with the host target in
+ * app/CMakeLists.txt and run:
+ *
+ *   engine-benchmark [--filter <substring>] [--repetitions <n>] [--min-time-ms <ms>]
+ *                    [--assets <dir>] [--trace <file>]
+ *
+ * The results are written to stdout as JSON.  Each benchmark is calibrated to run for at least
+ * min-time-ms and is then repeated, reporting the nanoseconds and allocations per operation for
+ * every repetition (samples) and their median.  The shaders are read out of the app's assets
+ * directory (--assets, by default the one in the source tree) as plain files.
+ *
+ * --trace records the engine's trace spans while the benchmarks run and writes them to the file in
+ * the Chrome trace event JSON format.  This needs a build with -DENGINE_TRACING=ON.  Each thread
+ * only keeps its latest spans, so use it with --filter to trace one benchmark.
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "assetView.hpp"
+#include "atlasCache.hpp"
+#include "dice.hpp"
+#include "diceDistribution.hpp"
+#include "diceRoller.hpp"
+#include "distanceField.hpp"
+#include "metrics.hpp"
+#include "packedDice.hpp"
+#include "rainbowDice.hpp"
+#include "random.hpp"
+#include "text.hpp"
+#include "textureAtlasManager.hpp"
+#include "trace.hpp"
+
+namespace {
+    // keep the compiler from optimizing away a value that is never used.
+    template <typename T>
+    inline void keep(T const &value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    struct Options {
+        std::string filter;
+        uint32_t repetitions = 5;
+        uint64_t minTimeNs = 200000000;
+        std::string assetDirectory = ENGINE_ASSET_DIR;
+        std::string traceFile;
+    };
+
+    struct Result {
+        std::string name;
+        uint64_t iterations;
+        std::vector<double> nsPerOp;
+        std::vector<double> allocsPerOp;
+    };
+
+    double median(std::vector<double> values) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        if (values.size() % 2 == 0) {
+            return (values[middle - 1] + values[middle]) / 2.0;
+        }
+        return values[middle];
+    }
+
+    class Benchmarks {
+    public:
+        explicit Benchmarks(Options options)
+                : m_options{std::move(options)},
+                  m_results{}
+        {
+        }
+
+        /* body(n) performs the operation being measured n times.  Setup that should not be
+         * measured goes outside of body.
+         */
+        template <typename Body>
+        void run(std::string const &name, Body &&body) {
+            if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos) {
+                return;
+            }
+
+            // find how many iterations it takes to run for the minimum time.
+            uint64_t iterations = 1;
+            while (true) {
+                uint64_t elapsed = timeIt(body, iterations);
+                if (elapsed >= m_options.minTimeNs || iterations >= (uint64_t{1} << 40)) {
+                    break;
+                }
+                uint64_t scale = elapsed == 0 ? 100 : (m_options.minTimeNs * 12 / 10) / elapsed + 1;
+                iterations *= std::min(std::max(scale, uint64_t{2}), uint64_t{100});
+            }
+
+            Result result{name, iterations, {}, {}};
+            for (uint32_t i = 0; i < m_options.repetitions; i++) {
+                uint64_t allocationsBefore = metrics::registry().value(metrics::allocations);
+                uint64_t elapsed = timeIt(body, iterations);
+                uint64_t allocations = metrics::registry().value(metrics::allocations) - allocationsBefore;
+                result.nsPerOp.push_back(static_cast<double>(elapsed) / iterations);
+                result.allocsPerOp.push_back(static_cast<double>(allocations) / iterations);
+            }
+
+            std::cerr << name << ": " << median(result.nsPerOp) << " ns/op, "
+                      << median(result.allocsPerOp) << " allocs/op" << std::endl;
+            m_results.push_back(std::move(result));
+        }
+
+        void writeJson(std::ostream &out) const {
+            out << "{\n  \"version\": 1,\n  \"repetitions\": " << m_options.repetitions
+                << ",\n  \"benchmarks\": [";
+            char const *separator = "\n";
+            for (auto const &result : m_results) {
+                out << separator << "    {\"name\": \"" << result.name << "\""
+                    << ", \"iterations\": " << result.iterations
+                    << ", \"ns_per_op\": " << median(result.nsPerOp)
+                    << ", \"allocs_per_op\": " << median(result.allocsPerOp)
+                    << ", \"ns_per_op_samples\": [";
+                for (size_t i = 0; i < result.nsPerOp.size(); i++) {
+                    out << (i == 0 ? "" : ", ") << result.nsPerOp[i];
+                }
+                out << "]}";
+                separator = ",\n";
+            }
+            out << "\n  ]\n}\n";
+        }
+
+    private:
+        Options m_options;
+        std::vector<Result> m_results;
+
+        template <typename Body>
+        static uint64_t timeIt(Body &body, uint64_t iterations) {
+            auto start = std::chrono::steady_clock::now();
+            body(iterations);
+            auto end = std::chrono::steady_clock::now();
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+    };
+
+    std::vector<std::string> symbolsFor(uint32_t nbrSymbols) {
+        std::vector<std::string> symbols;
+        for (uint32_t i = 0; i < nbrSymbols; i++) {
+            symbols.push_back(std::to_string(i + 1));
+        }
+        return symbols;
+    }
+
+    // A texture atlas with every symbol used by the benchmarks stacked in one column.  The bitmap
+    // is never read by the engine core.
+    std::shared_ptr<TextureAtlas> createTextureAtlas() {
+        std::vector<std::string> symbols = symbolsFor(30);
+        std::vector<std::pair<float, float>> leftRight;
+        std::vector<std::pair<float, float>> topBottom;
+        for (uint32_t i = 0; i < symbols.size(); i++) {
+            leftRight.emplace_back(0.0f, 1.0f);
+            topBottom.emplace_back(static_cast<float>(i) / symbols.size(),
+                                   static_cast<float>(i + 1) / symbols.size());
+        }
+        std::unique_ptr<unsigned char[]> bitmap{new unsigned char[1]{}};
+        return std::make_shared<TextureAtlas>(symbols, 64, 64, leftRight, topBottom,
+                                              std::move(bitmap), 1);
+    }
+
+    struct ModelType {
+        char const *name;
+        uint32_t nbrSymbols;
+        bool reverseGravity;
+    };
+
+    // one entry for each of the models DicePhysicsModel::createDice chooses from.
+    std::vector<ModelType> const modelTypes = {
+            {"coin", 2, false},
+            {"tetrahedron", 4, true},
+            {"octahedron", 4, false},
+            {"cube", 6, false},
+            {"hedron10", 10, false},
+            {"dodecahedron", 12, false},
+            {"icosahedron", 20, false},
+            {"rhombicTriacontahedron", 30, false}
+    };
+
+    std::shared_ptr<DicePhysicsModel> createLoadedDie(ModelType const &type,
+                                                      std::shared_ptr<TextureAtlas> const &atlas) {
+        static std::vector<float> const color{};
+        DicePhysicsModel::setReverseGravity(type.reverseGravity);
+        std::shared_ptr<DicePhysicsModel> die = DicePhysicsModel::createDice(
+                atlas->symbolIds(symbolsFor(type.nbrSymbols)), color);
+        die->loadModel(atlas);
+        DicePhysicsModel::setReverseGravity(false);
+        return die;
+    }
+
+    void loadModelBenchmarks(Benchmarks &benchmarks, std::shared_ptr<TextureAtlas> const &atlas) {
+        for (auto const &type : modelTypes) {
+            // the symbols are interned once per dice description, as setDice does.
+            SymbolIds symbols = atlas->symbolIds(symbolsFor(type.nbrSymbols));
+            std::vector<float> color{};
+            // includes constructing the die: loadModel may only be called once per die.
+            benchmarks.run(std::string("loadModel/") + type.name, [&](uint64_t n) {
+                DicePhysicsModel::setReverseGravity(type.reverseGravity);
+                for (uint64_t i = 0; i < n; i++) {
+                    std::shared_ptr<DicePhysicsModel> die = DicePhysicsModel::createDice(symbols, color);
+                    die->loadModel(atlas);
+                    keep(die);
+                }
+                DicePhysicsModel::setReverseGravity(false);
+            });
+        }
+    }
+
+    void calculateUpFaceBenchmarks(Benchmarks &benchmarks, std::shared_ptr<TextureAtlas> const &atlas) {
+        for (auto const &type : modelTypes) {
+            std::shared_ptr<DicePhysicsModel> die = createLoadedDie(type, atlas);
+            die->resetPosition();
+            benchmarks.run(std::string("calculateUpFace/") + type.name, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    uint32_t upFace = die->calculateUpFace();
+                    keep(upFace);
+                }
+            });
+        }
+    }
+
+    void calculateBounceBenchmarks(Benchmarks &benchmarks, std::shared_ptr<TextureAtlas> const &atlas) {
+        for (uint32_t poolSize : {2u, 8u, 32u, 128u}) {
+            // lay the dice out on a grid a little tighter than their diameter so that some pairs
+            // collide and some do not.
+            std::vector<std::shared_ptr<DicePhysicsModel>> dice;
+            uint32_t columns = 1;
+            while (columns * columns < poolSize) {
+                columns++;
+            }
+            float spacing = 1.5f * DicePhysicsModel::radius;
+            for (uint32_t i = 0; i < poolSize; i++) {
+                std::shared_ptr<DicePhysicsModel> die = createLoadedDie(modelTypes[3], atlas);
+                die->positionDice(0u, (i % columns) * spacing, (i / columns) * spacing);
+                dice.push_back(std::move(die));
+            }
+
+            // one operation is a bounce test of every pair of dice in the pool.
+            benchmarks.run("calculateBounce/pool" + std::to_string(poolSize), [&](uint64_t n) {
+                for (uint64_t k = 0; k < n; k++) {
+                    for (size_t i = 0; i < dice.size(); i++) {
+                        for (size_t j = i + 1; j < dice.size(); j++) {
+                            dice[i]->calculateBounce(dice[j].get());
+                        }
+                    }
+                }
+                keep(dice);
+            });
+        }
+    }
+
+    void updateModelMatrixBenchmarks(Benchmarks &benchmarks, std::shared_ptr<TextureAtlas> const &atlas) {
+        std::shared_ptr<DicePhysicsModel> die = createLoadedDie(modelTypes[3], atlas);
+        die->resetPosition();
+        benchmarks.run("updateModelMatrix/cube", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                // keep the die rolling
+                if (die->isStopped()) {
+                    die->resetPosition();
+                }
+                bool needsRedraw = die->updateModelMatrix();
+                keep(needsRedraw);
+            }
+        });
+    }
+
+    void filterBenchmarks(Benchmarks &benchmarks) {
+        Filter filter;
+        benchmarks.run("Filter::acceleration", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                float x = static_cast<float>(i % 17) * 0.1f;
+                glm::vec3 acceleration = filter.acceleration(glm::vec3{x, 0.5f, 9.8f});
+                keep(acceleration);
+            }
+        });
+    }
+
+    void randomBenchmarks(Benchmarks &benchmarks) {
+        Random random;
+        benchmarks.run("Random::getUInt", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                unsigned int value = random.getUInt(1, 6);
+                keep(value);
+            }
+        });
+        benchmarks.run("Random::getFloat", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                float value = random.getFloat(0.0f, 1.0f);
+                keep(value);
+            }
+        });
+        std::array<uint32_t, 64> faces;
+        benchmarks.run("Random::getUInts/64", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                random.getUInts(faces.data(), faces.size(), 1, 6);
+                keep(faces[0]);
+            }
+        });
+        std::array<float, 64> floats;
+        benchmarks.run("Random::getFloats/64", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                random.getFloats(floats.data(), floats.size(), 0.0f, 1.0f);
+                keep(floats[0]);
+            }
+        });
+    }
+
+    // An RGBA atlas of black squares on a transparent background, like the ones Java draws.
+    std::vector<unsigned char> monochromeBitmap(uint32_t width, uint32_t height) {
+        std::vector<unsigned char> bitmap(4 * width * height, 0);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                if ((x / 32 + y / 32) % 2 == 0) {
+                    bitmap[4 * (y * width + x) + 3] = 255;
+                }
+            }
+        }
+        return bitmap;
+    }
+
+    /* An atlas laid out like the one Java draws: the symbols in a grid of 64 by 64 cells, 8 to a
+     * row.  Each symbol is drawn in the middle of its cell, far enough from the other cells that
+     * it looks the same in every atlas it is in.
+     */
+    std::shared_ptr<TextureAtlas> symbolAtlas(uint32_t nbrSymbols) {
+        uint32_t const cell = 64;
+        uint32_t const columns = 8;
+        uint32_t const width = cell * columns;
+        uint32_t const height = cell * ((nbrSymbols + columns - 1) / columns);
+        std::unique_ptr<unsigned char[]> bitmap{new unsigned char[4 * width * height]()};
+        std::vector<std::string> symbols;
+        std::vector<std::pair<float, float>> leftRight;
+        std::vector<std::pair<float, float>> topBottom;
+        for (uint32_t i = 0; i < nbrSymbols; i++) {
+            uint32_t cellX = i % columns * cell;
+            uint32_t cellY = i / columns * cell;
+            for (uint32_t y = cell / 4; y < cell * 3 / 4; y++) {
+                for (uint32_t x = cell / 4; x < cell * 3 / 4; x++) {
+                    if ((x / 4 + y / 4 + i) % 3 != 0) {
+                        bitmap[4 * ((cellY + y) * width + cellX + x) + 3] = 255;
+                    }
+                }
+            }
+            symbols.push_back(std::to_string(i));
+            leftRight.emplace_back(static_cast<float>(cellX) / width,
+                                   static_cast<float>(cellX + cell) / width);
+            topBottom.emplace_back(static_cast<float>(cellY) / height,
+                                   static_cast<float>(cellY + cell) / height);
+        }
+        return std::make_shared<TextureAtlas>(symbols, width, height, leftRight, topBottom,
+                                              std::move(bitmap), 4 * width * height);
+    }
+
+    void textureBenchmarks(Benchmarks &benchmarks) {
+        uint32_t const width = 512;
+        uint32_t const height = 1024;
+        std::vector<unsigned char> rgba = monochromeBitmap(width, height);
+        std::vector<std::string> symbols{"1"};
+        std::vector<std::pair<float, float>> coords{{0.0f, 1.0f}};
+
+        // includes copying the RGBA bitmap into the atlas, as initDice does.
+        benchmarks.run("TextureAtlas/monochrome512x1024", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::unique_ptr<unsigned char[]> bitmap{new unsigned char[rgba.size()]};
+                std::memcpy(bitmap.get(), rgba.data(), rgba.size());
+                TextureAtlas atlas(symbols, width, height, coords, coords, std::move(bitmap),
+                                   static_cast<uint32_t>(rgba.size()));
+                keep(atlas.bitmapLength());
+            }
+        });
+
+        std::vector<unsigned char> alpha(width * height);
+        for (size_t i = 0; i < alpha.size(); i++) {
+            alpha[i] = rgba[4 * i + 3];
+        }
+        uint32_t fieldLength = 0;
+        benchmarks.run("TextureAtlas/distanceField512x1024", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                DistanceField field = signedDistanceField(alpha.data(), width, height, 4, 8.0f);
+                fieldLength = field.m_width * field.m_height;
+                keep(field.m_bitmap[0]);
+            }
+        });
+        if (fieldLength != 0) {
+            std::cerr << "TextureAtlas/distanceField512x1024: " << rgba.size() << " byte RGBA atlas, "
+                      << alpha.size() << " byte alpha atlas, " << fieldLength
+                      << " byte distance field" << std::endl;
+        }
+
+        // a cache hit after the app restarted: the atlas is mapped from its cache file.
+        char directory[] = "/tmp/engine-benchmark-XXXXXX";
+        if (mkdtemp(directory) != nullptr) {
+            std::unique_ptr<unsigned char[]> bitmap{new unsigned char[rgba.size()]};
+            std::memcpy(bitmap.get(), rgba.data(), rgba.size());
+            AtlasCache writer;
+            writer.setDirectory(directory);
+            writer.add(1, std::make_shared<TextureAtlas>(symbols, width, height, coords, coords,
+                    std::move(bitmap), static_cast<uint32_t>(rgba.size())));
+
+            benchmarks.run("TextureAtlas/cacheHit512x1024", [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    AtlasCache cache;
+                    cache.setDirectory(directory);
+                    std::shared_ptr<TextureAtlas> atlas = cache.find(1);
+                    keep(atlas->bitmapLength());
+                }
+            });
+
+            remove((std::string(directory) + "/atlas-0000000000000001.bin").c_str());
+            rmdir(directory);
+        }
+
+        // the atlases for a set of 24 symbols with 0 to 64 symbols added to it one at a time.
+        std::vector<std::shared_ptr<TextureAtlas>> atlases;
+        for (uint32_t i = 0; i <= 64; i++) {
+            atlases.push_back(symbolAtlas(24 + i));
+        }
+
+        benchmarks.run("TextureAtlasManager/rebuild88Symbols", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                TextureAtlasManager manager;
+                TextureAtlasManager::Update update = manager.merge(atlases.back());
+                keep(update.m_rebuilt);
+            }
+        });
+
+        // starts over every 64 symbols, so this includes a rebuild now and then.
+        uint64_t bytesAdded = 0;
+        uint64_t nbrAdded = 0;
+        benchmarks.run("TextureAtlasManager/addSymbol", [&](uint64_t n) {
+            TextureAtlasManager manager;
+            for (uint64_t i = 0; i < n; i++) {
+                size_t next = i % (atlases.size() - 1) + 1;
+                if (next == 1) {
+                    manager = TextureAtlasManager{};
+                    manager.merge(atlases.front());
+                }
+                TextureAtlasManager::Update update = manager.merge(atlases[next]);
+                if (!update.m_rebuilt) {
+                    for (auto const &region : update.m_regions) {
+                        bytesAdded += region.width * region.height *
+                                bytesPerTexel(manager.atlas()->format());
+                    }
+                    nbrAdded++;
+                }
+                keep(update.m_regions.size());
+            }
+        });
+        if (nbrAdded != 0) {
+            std::cerr << "TextureAtlasManager/addSymbol: " << bytesAdded / nbrAdded
+                      << " bytes uploaded per symbol added instead of the "
+                      << atlases.back()->bitmapLength() << " byte atlas" << std::endl;
+        }
+    }
+
+    // the host reads the shaders straight from the files in the assets directory.
+    void assetBenchmarks(Benchmarks &benchmarks, std::string const &assetDirectory) {
+        for (char const *name : {"shaderGL.vert", "shaderGL.frag"}) {
+            std::string path = assetDirectory + "/" + name;
+            benchmarks.run(std::string("AssetView::mapFile/") + name, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; i++) {
+                    AssetView shader = AssetView::mapFile(path);
+                    // touch every byte as the shader compiler would.
+                    uint32_t sum = 0;
+                    for (char c : shader) {
+                        sum += static_cast<unsigned char>(c);
+                    }
+                    keep(sum);
+                }
+            });
+        }
+    }
+
+    void rollerBenchmarks(Benchmarks &benchmarks) {
+        std::vector<std::string> symbols{"1", "2", "3", "4", "5", "6"};
+        std::vector<std::shared_ptr<int32_t>> values;
+        for (int32_t i = 1; i <= 6; i++) {
+            values.push_back(std::make_shared<int32_t>(i));
+        }
+        std::vector<std::shared_ptr<DiceDescription>> dice{std::make_shared<DiceDescription>(
+                500, symbols, values, std::vector<float>{}, std::vector<uint32_t>{5}, true)};
+        benchmarks.run("DiceRoller::roll/500d6", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                std::vector<std::vector<uint32_t>> results = DiceRoller::roll(dice);
+                keep(results.size());
+            }
+        });
+
+        // not through DiceDistribution::forDice, that would just measure the cache.
+        benchmarks.run("DiceDistribution/500d6", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                DiceDistribution distribution(dice);
+                keep(distribution.pmf().size());
+            }
+        });
+
+        PackedDiceSet diceSet;
+        diceSet.m_dice = dice;
+        diceSet.m_symbols = symbols;
+        diceSet.m_textureCoordLeft.assign(symbols.size(), 0.0f);
+        diceSet.m_textureCoordRight.assign(symbols.size(), 1.0f);
+        diceSet.m_textureCoordTop.assign(symbols.size(), 0.0f);
+        diceSet.m_textureCoordBottom.assign(symbols.size(), 1.0f);
+        std::vector<uint8_t> packed = diceSet.pack();
+        benchmarks.run("PackedDiceSet::unpack/d6", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                PackedDiceSet unpacked = PackedDiceSet::unpack(packed.data(), packed.size());
+                keep(unpacked.m_dice.size());
+            }
+        });
+    }
+
+    Options parseOptions(int argc, char *argv[]) {
+        Options options;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for option: " + arg);
+            }
+            if (arg == "--filter") {
+                options.filter = argv[++i];
+            } else if (arg == "--repetitions") {
+                options.repetitions = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+            } else if (arg == "--min-time-ms") {
+                options.minTimeNs = static_cast<uint64_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10))) * 1000000;
+            } else if (arg == "--assets") {
+                options.assetDirectory = argv[++i];
+            } else if (arg == "--trace") {
+                options.traceFile = argv[++i];
+#ifndef CQ_ENABLE_TRACING
+                throw std::runtime_error("--trace needs a build with -DENGINE_TRACING=ON");
+#endif
+            } else {
+                throw std::runtime_error("Unknown option: " + arg);
+            }
+        }
+        return options;
+    }
+} /* namespace */
+
+int main(int argc, char *argv[]) {
+    try {
+        Options options = parseOptions(argc, argv);
+        Benchmarks benchmarks{options};
+        if (!options.traceFile.empty()) {
+            trace::setEnabled(true);
+        }
+        std::shared_ptr<TextureAtlas> atlas = createTextureAtlas();
+
+        loadModelBenchmarks(benchmarks, atlas);
+        calculateUpFaceBenchmarks(benchmarks, atlas);
+        calculateBounceBenchmarks(benchmarks, atlas);
+        updateModelMatrixBenchmarks(benchmarks, atlas);
+        filterBenchmarks(benchmarks);
+        randomBenchmarks(benchmarks);
+        rollerBenchmarks(benchmarks);
+        textureBenchmarks(benchmarks);
+        assetBenchmarks(benchmarks, options.assetDirectory);
+
+        benchmarks.writeJson(std::cout);
+        if (!options.traceFile.empty()) {
+            trace::setEnabled(false);
+            trace::dumpChromeJson(options.traceFile);
+            std::cerr << "trace written to " << options.traceFile << std::endl;
+        }
+    } catch (std::exception &e) {
+        std::cerr << "engine-benchmark: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
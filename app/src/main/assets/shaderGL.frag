@@ -1,4 +1,7 @@
 #version 100
+#ifdef GL_OES_standard_derivatives
+#extension GL_OES_standard_derivatives : enable
+#endif
 precision highp float;
 /**
  * Copyright 2019 Cerulean Quasar. All Rights Reserved.
@@ -36,6 +39,7 @@ uniform sampler2D texSampler;
 uniform vec3 viewPosition;
 uniform int isSelected;
 uniform float edgeWidth;
+uniform int isDistanceField;
 
 float proximity(vec3 position, vec3 sideNormal, float factor, vec3 sideAvg) {
     if (length(sideNormal) == 0.0) {
@@ -52,7 +56,20 @@ void main() {
     vec3 color;
     float alpha = 1.0;
     vec4 textureColor = texture2D(texSampler, vec2(fragTexCoord.x, fragTexCoord.y));
-    if (textureColor.a != 0.0) {
+    if (isDistanceField > 0) {
+        // a is the distance to the edge of the symbol, 0.5 on the edge and more inside it.
+        // Blend over about one pixel on the screen so that the edge is smooth at any zoom.
+        float distance = textureColor.a;
+#ifdef GL_OES_standard_derivatives
+        float smoothing = max(0.7 * fwidth(distance), 0.001);
+#else
+        float smoothing = 0.05;
+#endif
+        float coverage = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+        color = mix(vec3(fragColor.r, fragColor.g, fragColor.b),
+                    vec3(1.0 - fragColor.r, 1.0 - fragColor.g, 1.0 - fragColor.b), coverage);
+        alpha = fragColor.a;
+    } else if (textureColor.a != 0.0) {
         if (textureColor.r == 0.0 && textureColor.g == 0.0 && textureColor.b == 0.0) {
             color = vec3(1.0 - fragColor.r, 1.0 - fragColor.g, 1.0 - fragColor.b);
         } else {
@@ -22,8 +22,12 @@
 #define RAINBOWDICE_TEXTUREATLASGL_HPP
 
 #include <memory>
+#include <vector>
 #include <GLES2/gl2.h>
 #include "text.hpp"
+#include "textureAtlasManager.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 class TextureGL {
 public:
@@ -38,6 +42,8 @@ public:
     }
 
     void initGLResources() {
+        TRACE_SPAN("textureUpload");
+
         // load the textures
         glGenTextures(1, &m_texture);
         glActiveTexture(GL_TEXTURE0);
@@ -47,13 +53,47 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-        // when the texture is scaled up or down
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, /*GL_LINEAR_MIPMAP_LINEAR*/GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, /*GL_LINEAR*/ GL_NEAREST);
+        // when the texture is scaled up or down.  A distance field has to be interpolated for
+        // the shader to find the edges between its texels.
+        GLint filter = GL_NEAREST;
+        if (m_textureAtlas->format() == TextureFormat::distanceField8) {
+            filter = GL_LINEAR;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
 
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_textureAtlas->getImageWidth(),
-                     m_textureAtlas->getImageHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                     m_textureAtlas->bitmap().get());
+        GLenum format = glFormat();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, m_textureAtlas->getImageWidth(),
+                     m_textureAtlas->getImageHeight(), 0, format, GL_UNSIGNED_BYTE,
+                     m_textureAtlas->bitmap());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        metrics::add(metrics::textureBytesUploaded, m_textureAtlas->bitmapLength());
+
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    // uploads the regions of the atlas that TextureAtlasManager changed in place.
+    void updateRegions(std::vector<AtlasRegion> const &regions) {
+        if (regions.empty()) {
+            return;
+        }
+
+        TRACE_SPAN("textureUpload");
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+
+        // GLES2 has no GL_UNPACK_ROW_LENGTH: copy the rows of each region next to each other.
+        GLenum format = glFormat();
+        std::vector<unsigned char> texels;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (auto const &region : regions) {
+            copyAtlasRegion(*m_textureAtlas, region, texels);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, region.x, region.y, region.width, region.height,
+                            format, GL_UNSIGNED_BYTE, texels.data());
+            metrics::add(metrics::textureBytesUploaded, texels.size());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
         glGenerateMipmap(GL_TEXTURE_2D);
     }
@@ -69,6 +109,12 @@ public:
 private:
     std::shared_ptr<TextureAtlas> m_textureAtlas;
     GLuint m_texture;
+
+    // an alpha texture samples as (0, 0, 0, a): the same black or transparent texels the
+    // shader gets from the RGBA version, or the distance in a for a distance field.
+    GLenum glFormat() {
+        return m_textureAtlas->format() == TextureFormat::rgba8 ? GL_RGBA : GL_ALPHA;
+    }
 };
 
 #endif /* RAINBOWDICE_TEXTUREATLASGL_HPP */
\ No newline at end of file
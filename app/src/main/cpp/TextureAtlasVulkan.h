@@ -60,6 +60,10 @@ public:
     inline std::shared_ptr<TextureAtlas> const &textureAtlas() {
         return m_textureAtlas;
     }
+
+    inline std::shared_ptr<vulkan::ImageSampler> const &sampler() {
+        return m_textureSampler;
+    }
 };
 
 #endif //RAINBOWDICE_TEXTUREATLASVULKAN_H
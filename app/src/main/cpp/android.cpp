@@ -19,13 +19,13 @@
  */
 #include "android_native_app_glue.h"
 #include <string>
-#include <asm/fcntl.h>
-#include <istream>
+#include <unistd.h>
 #include <vector>
 
 #include "android.hpp"
 
 std::unique_ptr<AssetManagerWrapper> assetWrapper;
+static std::string cacheDir;
 
 constexpr int Sensors::MAX_EVENT_REPORT_TIME;
 
@@ -100,67 +100,51 @@ void setAssetManager(AAssetManager *mgr) {
     assetWrapper.reset(new AssetManagerWrapper(mgr));
 }
 
-std::unique_ptr<AAsset> AssetManagerWrapper::getAsset(std::string const &path) {
-    AAsset *asset = AAssetManager_open(manager, path.c_str(), O_RDONLY);
+void setCacheDirectory(std::string const &dir) {
+    cacheDir = dir;
+}
+
+std::string const &cacheDirectory() {
+    return cacheDir;
+}
+
+std::unique_ptr<AAsset> AssetManagerWrapper::getAsset(std::string const &path, int mode) {
+    AAsset *asset = AAssetManager_open(manager, path.c_str(), mode);
     if (asset == nullptr) {
         throw std::runtime_error(std::string("File not found: ") + path);
     }
     return std::unique_ptr<AAsset>(asset);
 }
 
-AssetStreambuf::int_type AssetStreambuf::underflow() {
-    int bytesRead = AAsset_read(asset.get(), buffer, sizeof(buffer) - 1);
-    if (bytesRead <= 0) {
-        return traits_type::eof();
+AssetView readAsset(std::string const &filename) {
+    std::shared_ptr<AAsset> asset = assetWrapper->getAsset(filename, AASSET_MODE_BUFFER);
+    size_t length = static_cast<size_t>(AAsset_getLength64(asset.get()));
+    if (length == 0) {
+        return AssetView();
     }
 
-    setg(buffer, buffer, buffer + bytesRead);
-    return traits_type::to_int_type(buffer[0]);
-}
-
-std::streampos AssetStreambuf::seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which) {
-    if (which != std::ios_base::in) {
-        return -1;
+    // For compressed assets, this decompresses the asset once into a buffer owned by the asset.
+    // For uncompressed assets, the asset manager maps the file directly.
+    auto buffer = static_cast<char const *>(AAsset_getBuffer(asset.get()));
+    if (buffer != nullptr) {
+        return AssetView(asset, buffer, length);
     }
-    off64_t offset = off;
-    int whence;
-    switch (way) {
-        case std::ios_base::beg :
-            whence = SEEK_SET;
-            break;
-        case std::ios_base::cur :
-            whence = SEEK_CUR;
-            break;
-        case std::ios_base::end :
-            whence = SEEK_END;
-            break;
-        default:
-            return -1;
-    }
-    offset = AAsset_seek64(asset.get(), offset, whence);
 
-    return offset;
-}
-
-std::streampos AssetStreambuf::seekpos(std::streampos pos, std::ios_base::openmode which) {
-    return seekoff(pos, std::ios_base::beg, which);
-}
-
-std::vector<char> readFile(std::string const &filename) {
-    AssetStreambuf assetStreambuf(assetWrapper->getAsset(filename));
-    std::istream reader(&assetStreambuf);
-    std::vector<char> data;
-    unsigned long const readSize = 1024;
-
-    while (!reader.eof()) {
-        unsigned long size = data.size();
-        data.resize(size + readSize);
-        long bytesRead = reader.read(data.data()+size, readSize).gcount();
-
-        if (bytesRead != readSize) {
-            data.resize(size + bytesRead);
-        }
+    // The asset manager could not give us a buffer.  Try to map the asset ourselves.  This only
+    // works for uncompressed assets.
+    off64_t start;
+    off64_t fdLength;
+    int fd = AAsset_openFileDescriptor64(asset.get(), &start, &fdLength);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Could not read asset: ") + filename);
     }
 
-    return data;
+    try {
+        AssetView view = AssetView::mapFile(fd, start, static_cast<size_t>(fdLength));
+        close(fd);
+        return view;
+    } catch (...) {
+        close(fd);
+        throw;
+    }
 }
@@ -24,9 +24,9 @@
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
 #include <memory>
-#include <streambuf>
 #include <bitset>
 #include <android/sensor.h>
+#include "assetView.hpp"
 
 static char constexpr const * packageName = "com.quasar.cerulean.amazingLabyrinth";
 
@@ -184,28 +184,22 @@ namespace std {
     };
 }
 
-class AssetStreambuf : public std::streambuf {
-private:
-    std::unique_ptr<AAsset> asset;
-    char buffer[4096];
-public:
-    explicit AssetStreambuf(std::unique_ptr<AAsset> &&inAsset) : asset(std::move(inAsset)) {}
-    int underflow() override;
-    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which) override;
-    std::streampos seekpos(std::streampos pos, std::ios_base::openmode which) override;
-};
-
 class AssetManagerWrapper {
 private:
     AAssetManager *manager;
 public:
     explicit AssetManagerWrapper(AAssetManager *inManager) : manager(inManager) {}
-    std::unique_ptr<AAsset> getAsset(std::string const &file);
+    std::unique_ptr<AAsset> getAsset(std::string const &file, int mode = AASSET_MODE_UNKNOWN);
 };
 
 extern std::unique_ptr<AssetManagerWrapper> assetWrapper;
 
-std::vector<char> readFile(std::string const &filename);
+AssetView readAsset(std::string const &filename);
 void setAssetManager(AAssetManager *mgr);
 
+// The application's cache directory.  Files stored here may be deleted by Android at any time, so
+// anything stored here must be able to be regenerated.  Empty if the directory is not known.
+void setCacheDirectory(std::string const &dir);
+std::string const &cacheDirectory();
+
 #endif
\ No newline at end of file
@@ -0,0 +1,71 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "assetView.hpp"
+
+AssetView AssetView::mapFile(int fd, off_t offset, size_t length) {
+    if (length == 0) {
+        return AssetView();
+    }
+
+    // mmap requires the offset to be a multiple of the page size.
+    off_t pageSize = sysconf(_SC_PAGESIZE);
+    off_t alignedOffset = offset - offset % pageSize;
+    size_t mapLength = length + static_cast<size_t>(offset - alignedOffset);
+
+    void *addr = mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, alignedOffset);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Could not memory map file.");
+    }
+
+    auto deleter = [mapLength](void const *mapped) {
+        munmap(const_cast<void*>(mapped), mapLength);
+    };
+    std::shared_ptr<void const> owner(addr, deleter);
+
+    return AssetView(owner, static_cast<char const *>(addr) + (offset - alignedOffset), length);
+}
+
+AssetView AssetView::mapFile(std::string const &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        throw std::runtime_error(std::string("File not found: ") + path);
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        throw std::runtime_error(std::string("Not a regular file: ") + path);
+    }
+
+    try {
+        AssetView view = mapFile(fd, 0, static_cast<size_t>(st.st_size));
+        close(fd);
+        return view;
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_ASSET_VIEW_HPP
+#define RAINBOWDICE_ASSET_VIEW_HPP
+
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+/* A read only view over the bytes of an asset or file.  The bytes are not copied: they are either
+ * memory mapped or owned by the platform's asset object.  The owner keeps the mapping or asset
+ * alive for as long as any copy of the view exists.
+ */
+class AssetView {
+public:
+    AssetView()
+            : m_owner{},
+              m_data{nullptr},
+              m_size{0}
+    {}
+
+    AssetView(std::shared_ptr<void const> owner, char const *data, size_t size)
+            : m_owner{std::move(owner)},
+              m_data{data},
+              m_size{size}
+    {}
+
+    inline char const *data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+    inline bool empty() const { return m_size == 0; }
+    inline char const *begin() const { return m_data; }
+    inline char const *end() const { return m_data + m_size; }
+
+    // Map length bytes of the file referred to by fd starting at offset.  The offset need not be
+    // page aligned.  The caller still owns fd and may close it after this call returns.
+    static AssetView mapFile(int fd, off_t offset, size_t length);
+
+    // Map an entire regular file.  Throws if the file cannot be opened or is not a regular file.
+    static AssetView mapFile(std::string const &path);
+private:
+    std::shared_ptr<void const> m_owner;
+    char const *m_data;
+    size_t m_size;
+};
+
+#endif // RAINBOWDICE_ASSET_VIEW_HPP
@@ -0,0 +1,350 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "atlasCache.hpp"
+
+constexpr uint32_t AtlasCache::m_magic;
+constexpr uint32_t AtlasCache::m_fileVersion;
+constexpr size_t AtlasCache::m_maxFiles;
+
+/* The cache file is only ever read on the device that wrote it, so it is in the native byte
+ * order:
+ *
+ *   uint32 magic, uint32 version, uint64 key, uint32 format, uint32 width, uint32 height,
+ *   uint32 nbrSymbols, uint32 bitmapLength,
+ *   for each symbol: uint32 byte length, the UTF-8 bytes, float32 left, right, top, bottom
+ *   uint8[bitmapLength] bitmap
+ */
+namespace {
+    char const *const filePrefix = "atlas-";
+    char const *const fileSuffix = ".bin";
+
+    // A read only mapping of a whole file.
+    class FileMapping {
+    public:
+        explicit FileMapping(std::string const &path)
+                : m_data{nullptr},
+                  m_size{0}
+        {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+
+            struct stat fileStat = {};
+            if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+                void *data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ,
+                                  MAP_PRIVATE, fd, 0);
+                if (data != MAP_FAILED) {
+                    m_data = static_cast<unsigned char const *>(data);
+                    m_size = static_cast<size_t>(fileStat.st_size);
+                }
+            }
+            close(fd);
+        }
+
+        FileMapping(FileMapping const &) = delete;
+        FileMapping &operator=(FileMapping const &) = delete;
+
+        ~FileMapping() {
+            if (m_data != nullptr) {
+                munmap(const_cast<unsigned char *>(m_data), m_size);
+            }
+        }
+
+        unsigned char const *data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        unsigned char const *m_data;
+        size_t m_size;
+    };
+
+    // Reads values out of the mapping, failing instead of reading past its end.
+    class MappingReader {
+    public:
+        explicit MappingReader(FileMapping const &mapping)
+                : m_mapping{mapping},
+                  m_position{0}
+        {
+        }
+
+        template <typename T>
+        bool get(T &value) {
+            if (!has(sizeof (value))) {
+                return false;
+            }
+            std::memcpy(&value, m_mapping.data() + m_position, sizeof (value));
+            m_position += sizeof (value);
+            return true;
+        }
+
+        bool getString(std::string &value) {
+            uint32_t length = 0;
+            if (!get(length) || !has(length)) {
+                return false;
+            }
+            value.assign(reinterpret_cast<char const *>(m_mapping.data() + m_position), length);
+            m_position += length;
+            return true;
+        }
+
+        bool has(size_t length) const { return length <= m_mapping.size() - m_position; }
+        size_t position() const { return m_position; }
+
+    private:
+        FileMapping const &m_mapping;
+        size_t m_position;
+    };
+
+    // texture coordinates are fractions of the atlas, so anything else means a damaged file.
+    bool validCoordinate(float value) {
+        return std::isfinite(value) && value >= 0.0f && value <= 1.0f;
+    }
+
+    template <typename T>
+    void put(std::vector<char> &out, T const &value) {
+        char const *bytes = reinterpret_cast<char const *>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof (value));
+    }
+}
+
+AtlasCache::AtlasCache()
+        : m_mutex{},
+          m_directory{},
+          m_residentKey{0},
+          m_resident{}
+{
+}
+
+void AtlasCache::setDirectory(std::string const &directory) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_directory = directory;
+}
+
+std::shared_ptr<TextureAtlas> AtlasCache::find(uint64_t key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_resident != nullptr && m_residentKey == key) {
+        return m_resident;
+    }
+
+    std::shared_ptr<TextureAtlas> atlas = load(key);
+    if (atlas != nullptr) {
+        m_residentKey = key;
+        m_resident = atlas;
+    }
+    return atlas;
+}
+
+void AtlasCache::add(uint64_t key, std::shared_ptr<TextureAtlas> const &atlas) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_residentKey = key;
+    m_resident = atlas;
+    save(key, atlas);
+}
+
+std::string AtlasCache::fileName(uint64_t key) {
+    char name[32];
+    snprintf(name, sizeof (name), "%s%016llx%s", filePrefix, static_cast<unsigned long long>(key),
+             fileSuffix);
+    return m_directory + "/" + name;
+}
+
+std::shared_ptr<TextureAtlas> AtlasCache::load(uint64_t key) {
+    if (m_directory.empty()) {
+        return nullptr;
+    }
+
+    std::string cacheFile = fileName(key);
+    auto mapping = std::make_shared<FileMapping>(cacheFile);
+    if (mapping->data() == nullptr) {
+        return nullptr;
+    }
+
+    MappingReader reader(*mapping);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t fileKey = 0;
+    uint32_t format = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t nbrSymbols = 0;
+    uint32_t bitmapLength = 0;
+    if (!reader.get(magic) || !reader.get(version) || !reader.get(fileKey) ||
+        !reader.get(format) || !reader.get(width) || !reader.get(height) ||
+        !reader.get(nbrSymbols) || !reader.get(bitmapLength)) {
+        return nullptr;
+    }
+    if (magic != m_magic || version != m_fileVersion || fileKey != key ||
+        format > static_cast<uint32_t>(TextureFormat::distanceField8)) {
+        return nullptr;
+    }
+
+    // the bitmap has to be exactly the texels the atlas says it has: the renderers upload
+    // width * height texels from it without looking at its length.
+    uint64_t expectedLength = static_cast<uint64_t>(width) * height *
+            bytesPerTexel(static_cast<TextureFormat>(format));
+    if (width == 0 || height == 0 || bitmapLength != expectedLength) {
+        return nullptr;
+    }
+
+    // every symbol takes at least its length and its four coordinates, so a symbol count the
+    // file is too short for is rejected before it is used to size anything.
+    size_t minSymbolSize = sizeof (uint32_t) + 4 * sizeof (float);
+    if (nbrSymbols > (mapping->size() - reader.position()) / minSymbolSize) {
+        return nullptr;
+    }
+
+    std::vector<std::string> symbols(nbrSymbols);
+    std::vector<TextureImage> images(nbrSymbols);
+    for (uint32_t i = 0; i < nbrSymbols; i++) {
+        TextureImage &image = images[i];
+        if (!reader.getString(symbols[i]) || !reader.get(image.left) || !reader.get(image.right) ||
+            !reader.get(image.top) || !reader.get(image.bottom)) {
+            return nullptr;
+        }
+        if (!validCoordinate(image.left) || !validCoordinate(image.right) ||
+            !validCoordinate(image.top) || !validCoordinate(image.bottom)) {
+            return nullptr;
+        }
+    }
+
+    if (bitmapLength == 0 || !reader.has(bitmapLength) ||
+        reader.position() + bitmapLength != mapping->size()) {
+        return nullptr;
+    }
+
+    // mark the file as used so that it is not the next one removed (see removeOldFiles).
+    utimensat(AT_FDCWD, cacheFile.c_str(), nullptr, 0);
+
+    // the bitmap is used straight out of the mapping, which it keeps alive.
+    std::shared_ptr<unsigned char const> bitmap(mapping, mapping->data() + reader.position());
+    return std::make_shared<TextureAtlas>(width, height, static_cast<TextureFormat>(format),
+            symbols, images, std::move(bitmap), bitmapLength);
+}
+
+void AtlasCache::save(uint64_t key, std::shared_ptr<TextureAtlas> const &atlas) {
+    if (m_directory.empty()) {
+        return;
+    }
+
+    std::vector<char> header;
+    put(header, m_magic);
+    put(header, m_fileVersion);
+    put(header, key);
+    put(header, static_cast<uint32_t>(atlas->format()));
+    put(header, atlas->getImageWidth());
+    put(header, atlas->getImageHeight());
+    put(header, atlas->getNbrImages());
+    put(header, atlas->bitmapLength());
+    // in ID order, so that the atlas read back gives the symbols the same IDs.
+    for (uint32_t id = 0; id < atlas->getNbrImages(); id++) {
+        std::string const &symbol = atlas->symbols()[id];
+        TextureImage const &image = atlas->getTextureCoordinates(id);
+        put(header, static_cast<uint32_t>(symbol.size()));
+        header.insert(header.end(), symbol.begin(), symbol.end());
+        put(header, image.left);
+        put(header, image.right);
+        put(header, image.top);
+        put(header, image.bottom);
+    }
+
+    // write to a temporary file and rename so that a partially written cache file is never
+    // mapped.
+    std::string cacheFile = fileName(key);
+    std::string tmpFile = cacheFile + ".tmp";
+    {
+        std::ofstream file(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return;
+        }
+        file.write(header.data(), header.size());
+        file.write(reinterpret_cast<char const *>(atlas->bitmap()), atlas->bitmapLength());
+        if (!file) {
+            file.close();
+            remove(tmpFile.c_str());
+            return;
+        }
+    }
+    if (rename(tmpFile.c_str(), cacheFile.c_str()) != 0) {
+        remove(tmpFile.c_str());
+        return;
+    }
+
+    removeOldFiles();
+}
+
+void AtlasCache::removeOldFiles() {
+    DIR *dir = opendir(m_directory.c_str());
+    if (dir == nullptr) {
+        return;
+    }
+
+    size_t prefixLength = strlen(filePrefix);
+    size_t suffixLength = strlen(fileSuffix);
+    std::vector<std::pair<time_t, std::string>> files;
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+        std::string name(entry->d_name);
+        if (name.size() <= prefixLength + suffixLength ||
+            name.compare(0, prefixLength, filePrefix) != 0 ||
+            name.compare(name.size() - suffixLength, suffixLength, fileSuffix) != 0) {
+            continue;
+        }
+
+        std::string path = m_directory + "/" + name;
+        struct stat fileStat = {};
+        if (stat(path.c_str(), &fileStat) == 0) {
+            files.emplace_back(fileStat.st_mtime, std::move(path));
+        }
+    }
+    closedir(dir);
+
+    if (files.size() <= m_maxFiles) {
+        return;
+    }
+
+    // most recently used first.  A file that was just mapped stays valid after it is removed.
+    std::sort(files.begin(), files.end(), [](std::pair<time_t, std::string> const &a,
+                                              std::pair<time_t, std::string> const &b) {
+        return a.first > b.first;
+    });
+    for (size_t i = m_maxFiles; i < files.size(); i++) {
+        remove(files[i].second.c_str());
+    }
+}
+
+AtlasCache &atlasCache() {
+    static AtlasCache cache;
+    return cache;
+}
@@ -0,0 +1,72 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_ATLAS_CACHE_HPP
+#define RAINBOWDICE_ATLAS_CACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "text.hpp"
+
+/* Keeps the texture atlases Java rasterized so that the next roll with the same symbols does not
+ * have to rasterize, copy, convert or upload the atlas again.  Java computes the key from
+ * everything the atlas layout depends on (Draw.atlasKey).
+ *
+ * The most recent atlas stays in memory: when it is handed out again, the renderers see the same
+ * TextureAtlas object and keep the texture they already uploaded.  Every atlas is also written
+ * (after its conversion, see TextureAtlas) to a file in the cache directory, which is mapped
+ * into memory instead of read when the atlas is needed again after the app restarts.
+ */
+class AtlasCache {
+public:
+    AtlasCache();
+
+    // The cache files are only used after the directory is set.
+    void setDirectory(std::string const &directory);
+
+    // Returns the atlas with the key or nullptr if it is not cached.
+    std::shared_ptr<TextureAtlas> find(uint64_t key);
+
+    // Makes the atlas the one in memory and writes it to its cache file.
+    void add(uint64_t key, std::shared_ptr<TextureAtlas> const &atlas);
+
+private:
+    static uint32_t constexpr m_magic = 0x52444154; // "RDAT"
+    static uint32_t constexpr m_fileVersion = 1;
+    // the least recently used files are removed when there are more than this.
+    static size_t constexpr m_maxFiles = 16;
+
+    std::mutex m_mutex;
+    std::string m_directory;
+    uint64_t m_residentKey;
+    std::shared_ptr<TextureAtlas> m_resident;
+
+    std::string fileName(uint64_t key);
+    std::shared_ptr<TextureAtlas> load(uint64_t key);
+    void save(uint64_t key, std::shared_ptr<TextureAtlas> const &atlas);
+    void removeOldFiles();
+};
+
+// The atlas cache shared by the JNI calls and the draw thread.
+AtlasCache &atlasCache();
+
+#endif // RAINBOWDICE_ATLAS_CACHE_HPP
@@ -77,7 +77,7 @@ bool Vertex::operator==(const Vertex& other) const {
     return pos == other.pos && color == other.color && texCoord == other.texCoord && normal == other.normal;
 }
 
-std::shared_ptr<DicePhysicsModel> DicePhysicsModel::createDice(std::vector<std::string> const &symbols,
+std::shared_ptr<DicePhysicsModel> DicePhysicsModel::createDice(SymbolIds const &symbols,
         std::vector<float> const &color) {
     std::shared_ptr<DicePhysicsModel> die;
     glm::vec3 position(0.0f, 0.0f, -1.0f);
@@ -91,16 +91,17 @@ private:
 
 class DiceModel {
 protected:
-    std::vector<std::string> symbols;
+    // the IDs of the symbols in the texture atlas the model is built with.
+    SymbolIds symbols;
 
     /* vertex, index, and texture data for drawing the model */
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
 
 public:
-    explicit DiceModel(std::vector<std::string> const &inSymbols)
+    explicit DiceModel(SymbolIds const &inSymbols)
+            : symbols{inSymbols}
     {
-        symbols = inSymbols;
     }
 
     bool operator==(DiceModel const &other) {
@@ -119,7 +120,7 @@ public:
         return static_cast<uint32_t> (symbols.size());
     }
 
-    std::vector<std::string> const &getSymbols() {
+    SymbolIds const &getSymbols() {
         return symbols;
     }
 
@@ -229,7 +230,7 @@ public:
     static float constexpr stoppedMoveToZ = -1.0f - radius - 2*stoppedRadius;
 
     /* Set previous position to a bogus value to make sure the die is drawn first thing */
-    DicePhysicsModel(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor,
+    DicePhysicsModel(SymbolIds const &inSymbols, std::vector<float> const &inColor,
                      uint32_t inNumberFaces)
         : DiceModel(inSymbols), qTotalRotated(), numberFaces(inNumberFaces),
           prevTime(std::chrono::high_resolution_clock::now()),
@@ -241,7 +242,7 @@ public:
     {
     }
 
-    DicePhysicsModel(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DicePhysicsModel(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                      std::vector<float> const &inColor, uint32_t inNumberFaces)
         : DiceModel(inSymbols), qTotalRotated(), numberFaces(inNumberFaces),
           prevTime(std::chrono::high_resolution_clock::now()),
@@ -307,6 +308,9 @@ public:
     bool isStoppedAnimationDone() { return animationDone; }
     bool isStoppedAnimationStarted() { return doneY != 0.0f; }
     uint32_t getResult() { return result; }
+
+    // the result is fixed as soon as the die starts settling, before it is stopped.
+    bool hasResult() { return goingToStop; }
     void resetPosition();
     virtual void loadModel(std::shared_ptr<TextureAtlas> const &texAtlas) = 0;
     virtual float stoppedEdgeWidth() = 0;
@@ -322,16 +326,6 @@ public:
     void randomizeUpFace();
     virtual uint32_t getUpFaceIndex(uint32_t index) { return index; }
     virtual uint32_t getFaceIndexForSymbol(uint32_t symbolIndex) { return symbolIndex; }
-    virtual uint32_t getFaceIndexForSymbol(std::string symbol) {
-        uint32_t i=0;
-        for (auto &&s : symbols) {
-            if (symbol == s) {
-                return i;
-            }
-            i++;
-        }
-        return 0;  // shouldn't be reached.
-    }
     virtual void getAngleAxis(uint32_t faceIndex, float &angle, glm::vec3 &axis) = 0;
     virtual void yAlign(uint32_t faceIndex) = 0;
 
@@ -350,7 +344,7 @@ public:
         M_reverseGravity = reverseGravity;
     }
 
-    static std::shared_ptr<DicePhysicsModel> createDice(std::vector<std::string> const &symbols,
+    static std::shared_ptr<DicePhysicsModel> createDice(SymbolIds const &symbols,
                                                         std::vector<float> const &color);
 };
 
@@ -359,12 +353,12 @@ private:
     void cubeTop(glm::vec3 &pos, uint32_t i);
     void cubeBottom(glm::vec3 &pos, uint32_t i);
 public:
-    DiceModelCube(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor)
+    DiceModelCube(SymbolIds const &inSymbols, std::vector<float> const &inColor)
         : DicePhysicsModel(inSymbols, inColor, 6)
     {
     }
 
-    DiceModelCube(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DiceModelCube(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                   std::vector<float> const &inColor)
         : DicePhysicsModel(inSymbols, inPosition, inColor, 6)
     {
@@ -394,7 +388,7 @@ protected:
     void bottomCorners(glm::vec3 &p0, glm::vec3 &q, glm::vec3 &r, int i);
     void topCorners(glm::vec3 &p0, glm::vec3 &q, glm::vec3 &r, int i);
 public:
-    DiceModelHedron(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor,
+    DiceModelHedron(SymbolIds const &inSymbols, std::vector<float> const &inColor,
                     uint32_t inNumberFaces = 0)
         : DicePhysicsModel(inSymbols, inColor, inNumberFaces)
     {
@@ -406,7 +400,7 @@ public:
         }
     }
 
-    DiceModelHedron(std::vector<std::string> const &inSymbols,
+    DiceModelHedron(SymbolIds const &inSymbols,
                     glm::vec3 &inPosition,
                     std::vector<float> const &inColor,
                     uint32_t inNumberFaces = 0)
@@ -431,22 +425,18 @@ public:
 class DiceModelTetrahedron : public DiceModelHedron {
     void corners(glm::vec3 &p0, glm::vec3 &q, glm::vec3 &r, uint32_t i);
 public:
-    DiceModelTetrahedron(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor)
+    DiceModelTetrahedron(SymbolIds const &inSymbols, std::vector<float> const &inColor)
         : DiceModelHedron(inSymbols, inColor, 4)
     {
     }
 
-    DiceModelTetrahedron(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DiceModelTetrahedron(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                          std::vector<float> const &inColor)
         : DiceModelHedron(inSymbols, inPosition, inColor, 4)
     {
     }
 
     void loadModel(std::shared_ptr<TextureAtlas> const &texAtlas) override;
-    uint32_t getFaceIndexForSymbol(std::string symbol) override {
-        return DicePhysicsModel::getFaceIndexForSymbol(symbol);
-    }
-
     uint32_t getUpFaceIndex(uint32_t index) override { return index; }
     float rollingEdgeWidth() override { return 0.01f; }
     float stoppedEdgeWidth() override { return 0.03f; }
@@ -455,12 +445,12 @@ public:
 class DiceModelIcosahedron : public DiceModelHedron {
     void corners(glm::vec3 &p0, glm::vec3 &q, glm::vec3 &r, uint32_t i);
 public:
-    DiceModelIcosahedron(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor)
+    DiceModelIcosahedron(SymbolIds const &inSymbols, std::vector<float> const &inColor)
             : DiceModelHedron(inSymbols, inColor, 20)
     {
     }
 
-    DiceModelIcosahedron(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DiceModelIcosahedron(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                          std::vector<float> const &inColor)
             : DiceModelHedron(inSymbols, inPosition, inColor, 20)
     {
@@ -468,9 +458,6 @@ public:
 
     void loadModel(std::shared_ptr<TextureAtlas> const &texAtlas) override;
     uint32_t getUpFaceIndex(uint32_t index) override { return index; }
-    uint32_t getFaceIndexForSymbol(std::string symbol) override {
-        return DicePhysicsModel::getFaceIndexForSymbol(symbol);
-    }
     float rollingEdgeWidth() override { return 0.01f; }
     float stoppedEdgeWidth() override { return 0.02f; }
 };
@@ -483,12 +470,12 @@ private:
                      glm::vec3 cornerNormalD, glm::vec3 cornerNormalE, uint32_t i);
     void corners(glm::vec3 &a, glm::vec3 &b, glm::vec3 &c, glm::vec3 &d, glm::vec3 &e, uint32_t i);
 public:
-    DiceModelDodecahedron(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor)
+    DiceModelDodecahedron(SymbolIds const &inSymbols, std::vector<float> const &inColor)
     : DicePhysicsModel(inSymbols, inColor, 12)
             {
             }
 
-    DiceModelDodecahedron(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DiceModelDodecahedron(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                           std::vector<float> const &inColor)
     : DicePhysicsModel(inSymbols, inPosition, inColor, 12)
     {
@@ -524,7 +511,7 @@ private:
     // returns a vector of face indices that contain the given vertex number.
     std::vector<uint32_t> facesForVertex(uint32_t vertexNumber);
 public:
-    DiceModelRhombicTriacontahedron(std::vector<std::string> const &inSymbols,
+    DiceModelRhombicTriacontahedron(SymbolIds const &inSymbols,
                                     std::vector<float> const &inColor)
             : DicePhysicsModel(inSymbols, inColor, 30)
     {
@@ -533,7 +520,7 @@ public:
         }
     }
 
-    DiceModelRhombicTriacontahedron(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DiceModelRhombicTriacontahedron(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                                     std::vector<float> const &inColor)
             : DicePhysicsModel(inSymbols, inPosition, inColor, 30)
     {
@@ -557,12 +544,12 @@ private:
     void addEdgeVertices();
     void addFaceVertices(std::shared_ptr<TextureAtlas> const &texAtlas);
 public:
-    DiceModelCoin(std::vector<std::string> const &inSymbols, std::vector<float> const &inColor)
+    DiceModelCoin(SymbolIds const &inSymbols, std::vector<float> const &inColor)
             : DicePhysicsModel(inSymbols, inColor, 2)
     {
     }
 
-    DiceModelCoin(std::vector<std::string> const &inSymbols, glm::vec3 &inPosition,
+    DiceModelCoin(SymbolIds const &inSymbols, glm::vec3 &inPosition,
                   std::vector<float> const &inColor)
             : DicePhysicsModel(inSymbols, inPosition, inColor, 2)
     {
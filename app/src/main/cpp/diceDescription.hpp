@@ -50,6 +50,15 @@ struct DiceDescription {
               m_isAddOperation{inIsAddOperation} {}
 };
 
+// A die that landed on a face while the other dice are still rolling.  It is sent to java right
+// away so that the total can be shown before all the dice stop.  m_group is the index of the die
+// in the results from RainbowDice::getDiceResults and m_index is its place in the die's rerolls.
+struct SettledDie {
+    uint32_t m_group;
+    uint32_t m_index;
+    uint32_t m_result;
+};
+
 struct GraphicsDescription {
     bool m_isVulkan;
     std::string m_graphicsName;
@@ -0,0 +1,306 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "diceDistribution.hpp"
+
+constexpr double DiceDistribution::m_tailProbability;
+constexpr size_t DiceDistribution::m_fftThreshold;
+constexpr size_t DiceDistribution::m_maxSize;
+
+namespace {
+    // in place iterative radix 2 FFT, the size of a must be a power of 2.
+    void fft(std::vector<std::complex<double>> &a, bool inverse) {
+        size_t n = a.size();
+        for (size_t i = 1, j = 0; i < n; i++) {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(a[i], a[j]);
+            }
+        }
+
+        double const pi = std::acos(-1.0);
+        for (size_t length = 2; length <= n; length <<= 1) {
+            double angle = 2 * pi / static_cast<double>(length) * (inverse ? -1 : 1);
+            std::complex<double> step(std::cos(angle), std::sin(angle));
+            for (size_t i = 0; i < n; i += length) {
+                std::complex<double> w(1.0);
+                for (size_t j = 0; j < length / 2; j++) {
+                    std::complex<double> u = a[i + j];
+                    std::complex<double> v = a[i + j + length / 2] * w;
+                    a[i + j] = u + v;
+                    a[i + j + length / 2] = u - v;
+                    w *= step;
+                }
+            }
+        }
+
+        if (inverse) {
+            for (auto &x : a) {
+                x /= static_cast<double>(n);
+            }
+        }
+    }
+
+    // the parts of a configuration that affect the distribution of the total.
+    std::vector<int64_t> configurationKey(std::vector<std::shared_ptr<DiceDescription>> const &dice) {
+        std::vector<int64_t> key;
+        for (auto const &die : dice) {
+            key.push_back(die->m_nbrDice);
+            key.push_back(die->m_isAddOperation ? 1 : 0);
+            key.push_back(static_cast<int64_t>(die->m_values.size()));
+            for (auto const &value : die->m_values) {
+                key.push_back(value == nullptr ? 0 : *value);
+            }
+            std::vector<uint32_t> rerollOn = die->m_rerollOnIndices;
+            std::sort(rerollOn.begin(), rerollOn.end());
+            rerollOn.erase(std::unique(rerollOn.begin(), rerollOn.end()), rerollOn.end());
+            key.push_back(static_cast<int64_t>(rerollOn.size()));
+            key.insert(key.end(), rerollOn.begin(), rerollOn.end());
+        }
+        return key;
+    }
+
+    // FNV-1a over the key.
+    struct KeyHash {
+        size_t operator()(std::vector<int64_t> const &key) const {
+            uint64_t hash = 14695981039346656037ULL;
+            for (int64_t value : key) {
+                for (int i = 0; i < 8; i++) {
+                    hash ^= static_cast<uint64_t>(value >> (8 * i)) & 0xff;
+                    hash *= 1099511628211ULL;
+                }
+            }
+            return static_cast<size_t>(hash);
+        }
+    };
+
+    // the most distributions kept in the cache.
+    size_t constexpr const maxCached = 32;
+} /* namespace */
+
+std::vector<double> const &DiceDistribution::standardPercentiles() {
+    static std::vector<double> const percentiles{0.01, 0.05, 0.10, 0.25, 0.50, 0.75, 0.90, 0.95, 0.99};
+    return percentiles;
+}
+
+std::shared_ptr<DiceDistribution const> DiceDistribution::forDice(
+        std::vector<std::shared_ptr<DiceDescription>> const &dice) {
+    static std::mutex lock;
+    static std::unordered_map<std::vector<int64_t>, std::shared_ptr<DiceDistribution const>, KeyHash> cache;
+
+    std::vector<int64_t> key = configurationKey(dice);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second;
+        }
+    }
+
+    auto distribution = std::make_shared<DiceDistribution const>(dice);
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (cache.size() >= maxCached) {
+        cache.clear();
+    }
+    cache.emplace(std::move(key), distribution);
+    return distribution;
+}
+
+DiceDistribution::DiceDistribution(std::vector<std::shared_ptr<DiceDescription>> const &dice)
+        : m_minTotal{0},
+          m_pmf{},
+          m_cdf{}
+{
+    Pmf total{0, {1.0}};
+    for (auto const &die : dice) {
+        if (die->m_symbols.size() == 1) {
+            // a constant just moves the total.
+            int64_t value = die->m_values.empty() || die->m_values[0] == nullptr ? 0 : *die->m_values[0];
+            value *= die->m_nbrDice;
+            total.offset += die->m_isAddOperation ? value : -value;
+            continue;
+        }
+
+        Pmf one = singleDie(*die);
+        if (!die->m_isAddOperation) {
+            one.offset = -(one.offset + static_cast<int64_t>(one.p.size()) - 1);
+            std::reverse(one.p.begin(), one.p.end());
+        }
+        total = convolve(total, power(one, die->m_nbrDice));
+    }
+
+    m_minTotal = total.offset;
+    m_pmf = std::move(total.p);
+    m_cdf.reserve(m_pmf.size());
+    double sum = 0.0;
+    for (double p : m_pmf) {
+        sum += p;
+        m_cdf.push_back(std::min(sum, 1.0));
+    }
+}
+
+int64_t DiceDistribution::percentile(double probability) const {
+    auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), probability);
+    if (it == m_cdf.end()) {
+        // only the dropped tail is above the last total.
+        return m_minTotal + static_cast<int64_t>(m_cdf.size()) - 1;
+    }
+    return m_minTotal + (it - m_cdf.begin());
+}
+
+std::vector<std::pair<double, int64_t>> DiceDistribution::percentiles() const {
+    std::vector<std::pair<double, int64_t>> result;
+    for (double probability : standardPercentiles()) {
+        result.emplace_back(probability, percentile(probability));
+    }
+    return result;
+}
+
+DiceDistribution::Pmf DiceDistribution::convolve(Pmf const &a, Pmf const &b) {
+    size_t size = a.p.size() + b.p.size() - 1;
+    if (size > m_maxSize) {
+        throw std::runtime_error("Too many possible totals to compute the distribution.");
+    }
+
+    Pmf result{a.offset + b.offset, std::vector<double>(size, 0.0)};
+    if (std::min(a.p.size(), b.p.size()) <= m_fftThreshold) {
+        for (size_t i = 0; i < a.p.size(); i++) {
+            if (a.p[i] == 0.0) {
+                continue;
+            }
+            for (size_t j = 0; j < b.p.size(); j++) {
+                result.p[i + j] += a.p[i] * b.p[j];
+            }
+        }
+        return result;
+    }
+
+    size_t n = 1;
+    while (n < size) {
+        n <<= 1;
+    }
+    std::vector<std::complex<double>> fa(a.p.begin(), a.p.end());
+    std::vector<std::complex<double>> fb(b.p.begin(), b.p.end());
+    fa.resize(n);
+    fb.resize(n);
+    fft(fa, false);
+    fft(fb, false);
+    for (size_t i = 0; i < n; i++) {
+        fa[i] *= fb[i];
+    }
+    fft(fa, true);
+    for (size_t i = 0; i < size; i++) {
+        // rounding error can make the probability of an impossible total slightly negative.
+        result.p[i] = std::max(fa[i].real(), 0.0);
+    }
+    return result;
+}
+
+// a convolved with itself n times, by repeated squaring.
+DiceDistribution::Pmf DiceDistribution::power(Pmf const &a, uint32_t n) {
+    Pmf result{0, {1.0}};
+    Pmf base = a;
+    while (n > 0) {
+        if (n & 1) {
+            result = convolve(result, base);
+        }
+        n >>= 1;
+        if (n > 0) {
+            base = convolve(base, base);
+        }
+    }
+    return result;
+}
+
+/* The total of one die: the faces that are not rerolled (final) plus any number of reroll faces
+ * before one of them, i.e. the sum over k of reroll^k * final, stopping when the chance of k
+ * more rerolls is below m_tailProbability.
+ */
+DiceDistribution::Pmf DiceDistribution::singleDie(DiceDescription const &die) {
+    size_t nbrSymbols = die.m_symbols.size();
+    std::vector<int64_t> values(nbrSymbols, 0);
+    for (size_t i = 0; i < nbrSymbols && i < die.m_values.size(); i++) {
+        if (die.m_values[i] != nullptr) {
+            values[i] = *die.m_values[i];
+        }
+    }
+    std::vector<bool> isReroll(nbrSymbols, false);
+    for (auto index : die.m_rerollOnIndices) {
+        if (index < nbrSymbols) {
+            isReroll[index] = true;
+        }
+    }
+
+    auto minmax = std::minmax_element(values.begin(), values.end());
+    int64_t offset = *minmax.first;
+    auto size = static_cast<size_t>(*minmax.second - offset + 1);
+    if (size > m_maxSize) {
+        throw std::runtime_error("Too many possible totals to compute the distribution.");
+    }
+    Pmf final{offset, std::vector<double>(size, 0.0)};
+    Pmf reroll{offset, std::vector<double>(size, 0.0)};
+    double rerollProbability = 0.0;
+    for (size_t i = 0; i < nbrSymbols; i++) {
+        double p = 1.0 / static_cast<double>(nbrSymbols);
+        if (isReroll[i]) {
+            reroll.p[values[i] - offset] += p;
+            rerollProbability += p;
+        } else {
+            final.p[values[i] - offset] += p;
+        }
+    }
+
+    if (rerollProbability == 0.0) {
+        return final;
+    }
+    if (rerollProbability >= 1.0) {
+        throw std::runtime_error("All the faces of a die are to be rerolled.");
+    }
+
+    Pmf result = final;
+    Pmf term = final;
+    for (double remaining = rerollProbability; remaining >= m_tailProbability;
+         remaining *= rerollProbability) {
+        term = convolve(reroll, term);
+        Pmf sum{std::min(result.offset, term.offset), {}};
+        int64_t end = std::max(result.offset + static_cast<int64_t>(result.p.size()),
+                               term.offset + static_cast<int64_t>(term.p.size()));
+        sum.p.assign(static_cast<size_t>(end - sum.offset), 0.0);
+        for (size_t i = 0; i < result.p.size(); i++) {
+            sum.p[result.offset - sum.offset + i] += result.p[i];
+        }
+        for (size_t i = 0; i < term.p.size(); i++) {
+            sum.p[term.offset - sum.offset + i] += term.p[i];
+        }
+        result = std::move(sum);
+    }
+    return result;
+}
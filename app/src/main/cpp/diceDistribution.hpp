@@ -0,0 +1,82 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_DICE_DISTRIBUTION_HPP
+#define RAINBOWDICE_DICE_DISTRIBUTION_HPP
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "diceDescription.hpp"
+
+/* The exact probability distribution of the total of a roll.  Each die adds (or subtracts for a
+ * subtract operation) the values of every face it lands on, including the faces that make it get
+ * rerolled.  Symbols without a value count as 0.  The chance of a die getting rerolled more than
+ * enough times to matter (m_tailProbability) is dropped.
+ */
+class DiceDistribution {
+public:
+    // the percentiles returned by percentiles().
+    static std::vector<double> const &standardPercentiles();
+
+    /* Returns the distribution for dice (as built by initDice).  Distributions are cached by a
+     * hash of the parts of the configuration that affect the total.
+     */
+    static std::shared_ptr<DiceDistribution const> forDice(
+            std::vector<std::shared_ptr<DiceDescription>> const &dice);
+
+    // the smallest possible total, pmf()[i] is the probability of the total minTotal() + i.
+    int64_t minTotal() const { return m_minTotal; }
+    std::vector<double> const &pmf() const { return m_pmf; }
+    std::vector<double> const &cdf() const { return m_cdf; }
+
+    // the smallest total for which the CDF is at least probability.
+    int64_t percentile(double probability) const;
+
+    // (probability, total) for each of standardPercentiles().
+    std::vector<std::pair<double, int64_t>> percentiles() const;
+
+    explicit DiceDistribution(std::vector<std::shared_ptr<DiceDescription>> const &dice);
+
+private:
+    static double constexpr m_tailProbability = 1.0e-12;
+
+    // convolutions of arrays both longer than this are done with an FFT.
+    static size_t constexpr m_fftThreshold = 64;
+
+    // the largest number of totals a distribution can have.
+    static size_t constexpr m_maxSize = 1 << 24;
+
+    int64_t m_minTotal;
+    std::vector<double> m_pmf;
+    std::vector<double> m_cdf;
+
+    struct Pmf {
+        int64_t offset;
+        std::vector<double> p;
+    };
+
+    static Pmf convolve(Pmf const &a, Pmf const &b);
+    static Pmf power(Pmf const &a, uint32_t n);
+    static Pmf singleDie(DiceDescription const &die);
+};
+
+#endif // RAINBOWDICE_DICE_DISTRIBUTION_HPP
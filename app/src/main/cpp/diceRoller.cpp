@@ -0,0 +1,126 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "diceRoller.hpp"
+#include "random.hpp"
+
+namespace {
+    // the faces of a die split into the ones that get rerolled and the ones a roll can end on.
+    struct Faces {
+        std::vector<uint32_t> reroll;
+        std::vector<uint32_t> final;
+    };
+
+    Faces splitFaces(uint32_t nbrSymbols, std::vector<uint32_t> const &rerollOnIndices) {
+        Faces faces;
+        for (uint32_t i = 0; i < nbrSymbols; i++) {
+            if (std::find(rerollOnIndices.begin(), rerollOnIndices.end(), i) != rerollOnIndices.end()) {
+                faces.reroll.push_back(i);
+            } else {
+                faces.final.push_back(i);
+            }
+        }
+
+        if (faces.final.empty()) {
+            throw std::runtime_error("All the faces of a die are to be rerolled.");
+        }
+        return faces;
+    }
+
+    /* The number of reroll faces a die lands on in a row before it lands on a final face: a
+     * geometric distribution, P(length = k) = p^k (1 - p) where p is the chance of landing on a
+     * reroll face.  Sampled by inversion from a uniform double in (0, 1] with 53 random bits.
+     */
+    uint32_t chainLength(Random &random, Faces const &faces) {
+        if (faces.reroll.empty()) {
+            return 0;
+        }
+
+        double p = static_cast<double>(faces.reroll.size()) /
+                static_cast<double>(faces.reroll.size() + faces.final.size());
+        uint64_t bits = (static_cast<uint64_t>(random.getUInt(0, 0x1fffff)) << 32) |
+                random.getUInt(0, 0xffffffff);
+        double u = static_cast<double>(bits + 1) / 9007199254740992.0;
+        return static_cast<uint32_t>(std::floor(std::log(u) / std::log(p)));
+    }
+
+    /* Rolls count dice with the given faces, appending each die's rolls (its reroll faces then the
+     * face it ends on) to a group in results.  The faces are drawn in batches: the reroll faces of
+     * all the dice together and then the final faces of all the dice together.
+     */
+    void rollChains(Random &random, Faces const &faces, size_t count,
+                    std::vector<std::vector<uint32_t>> &results, size_t firstGroup) {
+        std::vector<uint32_t> lengths(count);
+        size_t nbrRerolls = 0;
+        for (auto &length : lengths) {
+            length = chainLength(random, faces);
+            nbrRerolls += length;
+        }
+
+        std::vector<uint32_t> rerolls(nbrRerolls);
+        if (nbrRerolls > 0) {
+            random.getUInts(rerolls.data(), rerolls.size(), 0,
+                            static_cast<uint32_t>(faces.reroll.size() - 1));
+        }
+        std::vector<uint32_t> finals(count);
+        random.getUInts(finals.data(), finals.size(), 0,
+                        static_cast<uint32_t>(faces.final.size() - 1));
+
+        size_t k = 0;
+        for (size_t i = 0; i < count; i++) {
+            auto &group = results[firstGroup + i];
+            for (uint32_t j = 0; j < lengths[i]; j++) {
+                group.push_back(faces.reroll[rerolls[k++]]);
+            }
+            group.push_back(faces.final[finals[i]]);
+        }
+    }
+} /* namespace */
+
+std::vector<std::vector<uint32_t>> DiceRoller::roll(
+        std::vector<std::shared_ptr<DiceDescription>> const &dice) {
+    Random random;
+    std::vector<std::vector<uint32_t>> results;
+    for (auto const &description : dice) {
+        auto nbrSymbols = static_cast<uint32_t>(description->m_symbols.size());
+        if (nbrSymbols <= 1) {
+            // a constant, it does not get rolled.
+            continue;
+        }
+
+        size_t firstGroup = results.size();
+        results.resize(firstGroup + description->m_nbrDice);
+        rollChains(random, splitFaces(nbrSymbols, description->m_rerollOnIndices),
+                   description->m_nbrDice, results, firstGroup);
+    }
+
+    return results;
+}
+
+void DiceRoller::rollChain(uint32_t nbrSymbols, std::vector<uint32_t> const &rerollOnIndices,
+                           std::vector<uint32_t> &group) {
+    Random random;
+    std::vector<std::vector<uint32_t>> results(1);
+    rollChains(random, splitFaces(nbrSymbols, rerollOnIndices), 1, results, 0);
+    group.insert(group.end(), results[0].begin(), results[0].end());
+}
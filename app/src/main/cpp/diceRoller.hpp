@@ -0,0 +1,52 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_DICE_ROLLER_HPP
+#define RAINBOWDICE_DICE_ROLLER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "diceDescription.hpp"
+
+/* Rolls dice straight from the random number generator without building any models, meshes or
+ * graphics buffers.  Used when the roll is not animated: the time to a result only depends on how
+ * fast random numbers can be drawn, not on the number of dice that would need to be built.
+ */
+class DiceRoller {
+public:
+    /* Returns the results in the same shape as RainbowDice::getDiceResults(): one group for each
+     * die in dice (constants, the descriptions with only one symbol, do not get a group), holding
+     * the symbol index the die landed on followed by the results of its rerolls.  The rerolls
+     * are sampled as in rollChain.
+     */
+    static std::vector<std::vector<uint32_t>> roll(
+            std::vector<std::shared_ptr<DiceDescription>> const &dice);
+
+    /* Appends the rolls of a die that gets rerolled to group: the number of reroll faces it lands
+     * on in a row comes from the geometric distribution those faces give, then the face it ends
+     * on is drawn from the faces that are not rerolled.  This is the same distribution as rolling
+     * the die until it lands on a face that is not rerolled, without looping over the rolls.
+     */
+    static void rollChain(uint32_t nbrSymbols, std::vector<uint32_t> const &rerollOnIndices,
+                          std::vector<uint32_t> &group);
+};
+
+#endif // RAINBOWDICE_DICE_ROLLER_HPP
@@ -0,0 +1,167 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "distanceField.hpp"
+
+namespace {
+    float constexpr farAway = 1e20f;
+
+    /* Squared distance from every texel to the nearest texel where isFeature is set.
+     *
+     * The first pass finds the distance to the nearest feature in the same column.  It sweeps
+     * down and then up the image a whole row at a time, so the inner loops run along contiguous
+     * memory with no dependency between texels and the compiler turns them into SIMD code.  The
+     * second pass is the exact one dimensional transform of Felzenszwalb and Huttenlocher along
+     * each row: the squared distance is the lower envelope of the parabolas (x - q)^2 + f(q).
+     */
+    void squaredDistances(std::vector<unsigned char> const &isFeature, uint32_t width,
+                          uint32_t height, std::vector<float> &distances) {
+        uint32_t const none = width + height;
+        std::vector<uint32_t> column(isFeature.size());
+        for (uint32_t x = 0; x < width; x++) {
+            column[x] = isFeature[x] ? 0 : none;
+        }
+        for (uint32_t y = 1; y < height; y++) {
+            uint32_t const *above = column.data() + (y - 1) * width;
+            uint32_t *row = column.data() + y * width;
+            unsigned char const *features = isFeature.data() + y * width;
+            for (uint32_t x = 0; x < width; x++) {
+                row[x] = features[x] ? 0 : std::min(above[x] + 1, none);
+            }
+        }
+        for (uint32_t y = height - 1; y > 0; y--) {
+            uint32_t const *below = column.data() + y * width;
+            uint32_t *row = column.data() + (y - 1) * width;
+            for (uint32_t x = 0; x < width; x++) {
+                row[x] = std::min(row[x], below[x] + 1);
+            }
+        }
+
+        distances.resize(isFeature.size());
+        for (size_t i = 0; i < column.size(); i++) {
+            float d = static_cast<float>(column[i]);
+            distances[i] = column[i] >= none ? farAway : d * d;
+        }
+
+        std::vector<float> f(width);
+        std::vector<uint32_t> v(width);
+        std::vector<float> z(width + 1);
+        for (uint32_t y = 0; y < height; y++) {
+            float *row = distances.data() + y * width;
+            std::copy(row, row + width, f.begin());
+
+            // build the lower envelope: v holds the roots of its parabolas, z the boundaries.
+            uint32_t k = 0;
+            v[0] = 0;
+            z[0] = -std::numeric_limits<float>::infinity();
+            z[1] = std::numeric_limits<float>::infinity();
+            for (uint32_t q = 1; q < width; q++) {
+                float fq = f[q] + static_cast<float>(q) * q;
+                float s = (fq - (f[v[k]] + static_cast<float>(v[k]) * v[k])) / (2.0f * (q - v[k]));
+                // z[0] is -infinity, so this stops at the first parabola at the latest.
+                while (s <= z[k]) {
+                    k--;
+                    s = (fq - (f[v[k]] + static_cast<float>(v[k]) * v[k])) / (2.0f * (q - v[k]));
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k + 1] = std::numeric_limits<float>::infinity();
+            }
+
+            // read the envelope back out.
+            k = 0;
+            for (uint32_t q = 0; q < width; q++) {
+                while (z[k + 1] < q) {
+                    k++;
+                }
+                float dx = static_cast<float>(q) - v[k];
+                row[q] = dx * dx + f[v[k]];
+            }
+        }
+    }
+}
+
+DistanceField signedDistanceField(unsigned char const *coverage, uint32_t width, uint32_t height,
+                                  uint32_t downscale, float spread) {
+    if (coverage == nullptr || width == 0 || height == 0 || downscale == 0 || spread <= 0.0f) {
+        throw std::runtime_error("Invalid bitmap for the distance field.");
+    }
+
+    size_t nbrTexels = static_cast<size_t>(width) * height;
+    std::vector<unsigned char> inside(nbrTexels);
+    std::vector<unsigned char> outside(nbrTexels);
+    for (size_t i = 0; i < nbrTexels; i++) {
+        inside[i] = coverage[i] >= 128 ? 1 : 0;
+        outside[i] = 1 - inside[i];
+    }
+
+    std::vector<float> toInside;
+    std::vector<float> toOutside;
+    squaredDistances(inside, width, height, toInside);
+    squaredDistances(outside, width, height, toOutside);
+
+    // positive inside the shapes.  The edge lies half way between an inside texel and its
+    // outside neighbour.
+    std::vector<float> distances(nbrTexels);
+    for (size_t i = 0; i < nbrTexels; i++) {
+        distances[i] = std::sqrt(toOutside[i]) - std::sqrt(toInside[i]) +
+                       (inside[i] ? -0.5f : 0.5f);
+    }
+
+    DistanceField field;
+    field.m_width = (width + downscale - 1) / downscale;
+    field.m_height = (height + downscale - 1) / downscale;
+    field.m_bitmap = std::make_unique<unsigned char[]>(
+            static_cast<size_t>(field.m_width) * field.m_height);
+
+    // box filter each downscale by downscale block (clipped to the bitmap) into one texel.
+    std::vector<float> sums(field.m_width);
+    float const scale = 1.0f / (2.0f * spread);
+    for (uint32_t oy = 0; oy < field.m_height; oy++) {
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        uint32_t yBegin = oy * downscale;
+        uint32_t yEnd = std::min(yBegin + downscale, height);
+        for (uint32_t y = yBegin; y < yEnd; y++) {
+            float const *row = distances.data() + static_cast<size_t>(y) * width;
+            for (uint32_t ox = 0; ox < field.m_width; ox++) {
+                uint32_t xEnd = std::min((ox + 1) * downscale, width);
+                for (uint32_t x = ox * downscale; x < xEnd; x++) {
+                    sums[ox] += row[x];
+                }
+            }
+        }
+
+        unsigned char *out = field.m_bitmap.get() + static_cast<size_t>(oy) * field.m_width;
+        for (uint32_t ox = 0; ox < field.m_width; ox++) {
+            uint32_t blockWidth = std::min((ox + 1) * downscale, width) - ox * downscale;
+            float value = 0.5f + sums[ox] / static_cast<float>(blockWidth * (yEnd - yBegin)) * scale;
+            value = std::min(std::max(value, 0.0f), 1.0f);
+            out[ox] = static_cast<unsigned char>(value * 255.0f + 0.5f);
+        }
+    }
+
+    return field;
+}
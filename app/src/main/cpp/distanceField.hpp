@@ -0,0 +1,49 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_DISTANCE_FIELD_HPP
+#define RAINBOWDICE_DISTANCE_FIELD_HPP
+
+#include <cstdint>
+#include <memory>
+
+/* A signed distance field of a one byte per texel coverage bitmap.  Each texel holds the distance
+ * from its centre to the nearest edge of the shapes in the bitmap, mapped into a byte so that
+ * 128 lies on the edge, larger values are inside the shapes and smaller values are outside.
+ * Distances further than spread source texels away from the edge are clamped to 0 or 255.
+ *
+ * Since the distance varies smoothly, the field can be stored at a fraction of the resolution
+ * of the original bitmap and sampled with linear filtering, and the shader can still recover a
+ * sharp edge at any zoom level by thresholding it at 0.5.
+ */
+struct DistanceField {
+    uint32_t m_width;
+    uint32_t m_height;
+    std::unique_ptr<unsigned char[]> m_bitmap;
+};
+
+/* Computes the exact Euclidean distance transform of the texels with coverage of at least half
+ * (the inside of the shapes) and of the others, and box filters the signed distance down by
+ * downscale in each direction.  The result is ceil(width/downscale) by ceil(height/downscale)
+ * texels.
+ */
+DistanceField signedDistanceField(unsigned char const *coverage, uint32_t width, uint32_t height,
+                                  uint32_t downscale, float spread);
+
+#endif // RAINBOWDICE_DISTANCE_FIELD_HPP
@@ -17,80 +17,255 @@
  *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "rainbowDiceGL.hpp"
 #include "rainbowDiceGlobal.hpp"
 #include "android.hpp"
 #include "drawer.hpp"
 #include "native-lib.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 #ifdef CQ_ENABLE_VULKAN
 #include "rainbowDiceVulkan.hpp"
 #include "TextureAtlasVulkan.h"
 #endif
 
-std::shared_ptr<DrawEvent> DiceChannel::getEventNoWait() {
-    // critical section
-    std::unique_lock<std::mutex> lock(m_eventLock);
+static_assert(sizeof (std::atomic<int32_t>) == sizeof (int32_t), "futex word must be 32 bits");
+
+constexpr uint64_t DiceChannel::m_ringSize;
+constexpr std::chrono::milliseconds DiceChannel::m_maxPushWait;
+
+DiceChannel::DiceChannel()
+        : m_head{0},
+          m_tail{0},
+          m_stopDrawing{false},
+          m_futex{0},
+          m_consumerWaiting{false},
+          m_stopDrawingEvent{},
+          m_surfaceChangedEvent{0, 0},
+          m_scrollEvent{0.0f, 0.0f},
+          m_scaleEvent{1.0f},
+          m_tapDiceEvent{0.0f, 0.0f},
+          m_rerollSelectedEvent{},
+          m_addRerollSelectedEvent{},
+          m_deleteSelectedEvent{},
+          m_resetViewEvent{},
+          m_currentEvent{}
+{
+    for (auto &slot : m_ring) {
+        slot.state.store(slotEmpty, std::memory_order_relaxed);
+        slot.type = DrawEvent::stopDrawing;
+        slot.x = 0.0f;
+        slot.y = 0.0f;
+    }
+}
+
+bool DiceChannel::push(DrawEvent::evtype type, float x, float y, std::shared_ptr<DrawEvent> event) {
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= m_ringSize) {
+        // full: the drawing thread is not keeping up or is not running.
+        wake();
+        return false;
+    }
+
+    // The drawing thread marks the slot empty before advancing the tail, so no one else is using
+    // this slot.
+    Slot &slot = m_ring[head & (m_ringSize - 1)];
+    slot.type = type;
+    slot.x = x;
+    slot.y = y;
+    slot.event = std::move(event);
+    slot.state.store(slotPublished, std::memory_order_release);
+    m_head.store(head + 1, std::memory_order_release);
+
+    wake();
+    return true;
+}
+
+bool DiceChannel::pushWaiting(DrawEvent::evtype type, float x, float y,
+        std::shared_ptr<DrawEvent> event) {
+    // push gets its own reference to event, so it can be tried again.
+    auto giveUp = std::chrono::steady_clock::now() + m_maxPushWait;
+    while (!push(type, x, y, event)) {
+        if (std::chrono::steady_clock::now() >= giveUp) {
+            metrics::add(metrics::eventsDropped);
+            return false;
+        }
+        // push already woke the drawing thread.  Give it a moment to empty some slots.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+bool DiceChannel::merge(DrawEvent::evtype type, float x, float y) {
+    // Only the most recently published slot can be merged into.  If the drawing thread has
+    // already started reading it (or read it), the state will not be slotPublished.
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    Slot &slot = m_ring[(head - 1) & (m_ringSize - 1)];
+    uint32_t expected = slotPublished;
+    if (!slot.state.compare_exchange_strong(expected, slotMerging, std::memory_order_acquire)) {
+        return false;
+    }
+
+    bool merged = false;
+    if (slot.type == type) {
+        if (type == DrawEvent::scrollSurface) {
+            slot.x += x;
+            slot.y += y;
+            merged = true;
+        } else if (type == DrawEvent::scaleSurface) {
+            slot.x *= x;
+            merged = true;
+        }
+    }
+
+    slot.state.store(slotPublished, std::memory_order_release);
+    return merged;
+}
+
+DrawEvent *DiceChannel::pop() {
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    Slot &slot = m_ring[tail & (m_ringSize - 1)];
+    uint32_t expected = slotPublished;
+    while (!slot.state.compare_exchange_weak(expected, slotReading, std::memory_order_acquire)) {
+        // the gui thread is merging an event into this slot.  It only takes a few instructions.
+        expected = slotPublished;
+    }
 
-    if (m_stopDrawing) {
-        m_stopDrawing = false;
-        return std::make_shared<StopDrawingEvent>(StopDrawingEvent{});
+    DrawEvent::evtype type = slot.type;
+    float x = slot.x;
+    float y = slot.y;
+    m_currentEvent = std::move(slot.event);
+    slot.event.reset();
+
+    slot.state.store(slotEmpty, std::memory_order_release);
+    m_tail.store(tail + 1, std::memory_order_release);
+    metrics::add(metrics::eventsProcessed);
+
+    switch (type) {
+        case DrawEvent::surfaceChanged:
+            m_surfaceChangedEvent.set(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+            return &m_surfaceChangedEvent;
+        case DrawEvent::scrollSurface:
+            m_scrollEvent.set(x, y);
+            return &m_scrollEvent;
+        case DrawEvent::scaleSurface:
+            m_scaleEvent.set(x);
+            return &m_scaleEvent;
+        case DrawEvent::tapDice:
+            m_tapDiceEvent.set(x, y);
+            return &m_tapDiceEvent;
+        case DrawEvent::rerollSelected:
+            return &m_rerollSelectedEvent;
+        case DrawEvent::addRerollSelected:
+            return &m_addRerollSelectedEvent;
+        case DrawEvent::deleteSelected:
+            return &m_deleteSelectedEvent;
+        case DrawEvent::resetView:
+            return &m_resetViewEvent;
+        case DrawEvent::stopDrawing:
+            return &m_stopDrawingEvent;
+        case DrawEvent::diceChange:
+        case DrawEvent::drawStoppedDice:
+        default:
+            return m_currentEvent.get();
     }
+}
+
+void DiceChannel::wake() {
+    m_futex.fetch_add(1, std::memory_order_seq_cst);
+    if (m_consumerWaiting.load(std::memory_order_seq_cst)) {
+        syscall(SYS_futex, reinterpret_cast<int32_t *>(&m_futex), FUTEX_WAKE_PRIVATE, 1,
+                nullptr, nullptr, 0);
+    }
+}
 
-    if (m_drawEventQueue.empty()) {
-        return std::shared_ptr<DrawEvent>();
+DrawEvent *DiceChannel::getEventNoWait() {
+    if (m_stopDrawing.exchange(false, std::memory_order_acquire)) {
+        return &m_stopDrawingEvent;
     }
 
-    std::shared_ptr<DrawEvent> event = m_drawEventQueue.front();
-    m_drawEventQueue.pop();
-    return event;
+    return pop();
 }
 
 // blocks waiting for the next event.
-std::shared_ptr<DrawEvent> DiceChannel::getEvent() {
-    // critical section
-    std::unique_lock<std::mutex> lock(m_eventLock);
+DrawEvent *DiceChannel::getEvent() {
+    while (true) {
+        if (m_stopDrawing.exchange(false, std::memory_order_acquire)) {
+            return &m_stopDrawingEvent;
+        }
 
-    if (m_stopDrawing) {
-        m_stopDrawing = false;
-        return std::make_shared<StopDrawingEvent>(StopDrawingEvent{});
+        int32_t sequence = m_futex.load(std::memory_order_acquire);
+        DrawEvent *event = pop();
+        if (event != nullptr) {
+            return event;
+        }
+
+        // Announce that we are going to sleep and then check again so that an event published
+        // before the gui thread saw the announcement is not missed.  The kernel also rechecks the
+        // futex word before sleeping.
+        m_consumerWaiting.store(true, std::memory_order_seq_cst);
+        if (m_futex.load(std::memory_order_seq_cst) == sequence) {
+            syscall(SYS_futex, reinterpret_cast<int32_t *>(&m_futex), FUTEX_WAIT_PRIVATE, sequence,
+                    nullptr, nullptr, 0);
+        }
+        m_consumerWaiting.store(false, std::memory_order_relaxed);
     }
+}
 
-    if (m_drawEventQueue.empty()) {
-        m_eventConditionVariable.wait(lock);
+void DiceChannel::sendEvent(std::shared_ptr<DrawEvent> event) {
+    DrawEvent::evtype type = event->type();
+    if (!pushWaiting(type, 0.0f, 0.0f, std::move(event))) {
+        throw std::runtime_error("Too many events waiting for the drawing thread.");
     }
+}
 
-    if (m_stopDrawing) {
-        m_stopDrawing = false;
-        return std::make_shared<StopDrawingEvent>(StopDrawingEvent{});
+void DiceChannel::sendSurfaceChanged(uint32_t width, uint32_t height) {
+    if (!pushWaiting(DrawEvent::surfaceChanged, static_cast<float>(width),
+            static_cast<float>(height), nullptr)) {
+        throw std::runtime_error("Too many events waiting for the drawing thread.");
     }
+}
 
-    std::shared_ptr<DrawEvent> event = m_drawEventQueue.front();
-    m_drawEventQueue.pop();
-    return event;
+void DiceChannel::sendScroll(float distanceX, float distanceY) {
+    if (!merge(DrawEvent::scrollSurface, distanceX, distanceY) &&
+        !push(DrawEvent::scrollSurface, distanceX, distanceY, nullptr)) {
+        metrics::add(metrics::eventsDropped);
+    }
 }
 
-void DiceChannel::sendEvent(std::shared_ptr<DrawEvent> const &event) {
-    std::unique_lock<std::mutex> lock(m_eventLock);
+void DiceChannel::sendScale(float scaleFactor) {
+    if (!merge(DrawEvent::scaleSurface, scaleFactor, 0.0f) &&
+        !push(DrawEvent::scaleSurface, scaleFactor, 0.0f, nullptr)) {
+        metrics::add(metrics::eventsDropped);
+    }
+}
 
-    m_drawEventQueue.push(event);
-    m_eventConditionVariable.notify_one();
+bool DiceChannel::sendTapDice(float x, float y) {
+    return pushWaiting(DrawEvent::tapDice, x, y, nullptr);
 }
 
-void DiceChannel::sendStopDrawingEvent() {
-    std::unique_lock<std::mutex> lock(m_eventLock);
+bool DiceChannel::sendEvent(DrawEvent::evtype type) {
+    return pushWaiting(type, 0.0f, 0.0f, nullptr);
+}
 
-    m_stopDrawing = true;
-    m_eventConditionVariable.notify_one();
+void DiceChannel::sendStopDrawingEvent() {
+    m_stopDrawing.store(true, std::memory_order_release);
+    wake();
 }
 
 void DiceChannel::clearQueue() {
-    std::unique_lock<std::mutex> lock(m_eventLock);
-    m_stopDrawing = false;
+    m_stopDrawing.store(false, std::memory_order_relaxed);
 
-    while (!m_drawEventQueue.empty()) {
-        m_drawEventQueue.pop();
-    }
+    while (pop() != nullptr);
+    m_currentEvent.reset();
 }
 
 DiceChannel &diceChannel() {
@@ -147,13 +322,19 @@ void DiceWorker::waitingLoop() {
             reportResult = reportResult || needsReport(event->type());
         }
 
+        if (reportResult) {
+            // the roll starts now, measure the time until its result is sent.
+            m_rollStart = std::chrono::steady_clock::now();
+        }
+
         if (m_diceGraphics->hasDice()) {
             if (nbrRequireRedraw > 0) {
                 m_diceGraphics->drawFrame();
+                metrics::registry().endFrame();
             }
 
             while (!m_diceGraphics->allStopped()) {
-                std::shared_ptr<DrawEvent> eventDrawing = drawingLoop(reportResult);
+                DrawEvent *eventDrawing = drawingLoop(reportResult);
                 if (eventDrawing != nullptr) {
                     if (eventDrawing->type() == DrawEvent::stopDrawing) {
                         return;
@@ -166,39 +347,101 @@ void DiceWorker::waitingLoop() {
     }
 }
 
-std::shared_ptr<DrawEvent> DiceWorker::drawingLoop(bool reportResult) {
-    Sensors sensor{m_whichSensors};
+constexpr uint32_t DiceWorker::m_targetFramesPerSecond;
+constexpr uint32_t DiceWorker::m_settlingFramesPerSecond;
 
-    while (true) {
-        if (m_whichSensors.test(Sensors::LINEAR_ACCELERATION_SENSOR) && sensor.hasLinearAccerationEvents()) {
-            std::vector<Sensors::AccelerationEvent> events = sensor.getLinearAccelerationEvents();
-            for (auto const &event : events) {
-                m_diceGraphics->updateAcceleration(RainbowDice::AccelerationEventType::LINEAR_ACCELERATION_EVENT,
-                        event.x, event.y, event.z);
-            }
+void DiceWorker::drainSensors(Sensors &sensor) {
+    TRACE_SPAN("sensorDrain");
 
+    if (m_whichSensors.test(Sensors::LINEAR_ACCELERATION_SENSOR) && sensor.hasLinearAccerationEvents()) {
+        std::vector<Sensors::AccelerationEvent> events = sensor.getLinearAccelerationEvents();
+        for (auto const &event : events) {
+            m_diceGraphics->updateAcceleration(RainbowDice::AccelerationEventType::LINEAR_ACCELERATION_EVENT,
+                    event.x, event.y, event.z);
         }
 
-        if (m_whichSensors.test(Sensors::GRAVITY_SENSOR) && sensor.hasGravityEvents()) {
-            std::vector<Sensors::AccelerationEvent> events = sensor.getGravityEvents();
-            for (auto const &event : events) {
-                m_diceGraphics->updateAcceleration(RainbowDice::AccelerationEventType::GRAVITY_EVENT,
-                        event.x, event.y, event.z);
-            }
+    }
 
+    if (m_whichSensors.test(Sensors::GRAVITY_SENSOR) && sensor.hasGravityEvents()) {
+        std::vector<Sensors::AccelerationEvent> events = sensor.getGravityEvents();
+        for (auto const &event : events) {
+            m_diceGraphics->updateAcceleration(RainbowDice::AccelerationEventType::GRAVITY_EVENT,
+                    event.x, event.y, event.z);
         }
 
-        if (m_whichSensors.test(Sensors::ACCELEROMETER_SENSOR) && sensor.hasAccelerometerEvents()) {
-            std::vector<Sensors::AccelerationEvent> events = sensor.getAccelerometerEvents();
-            for (auto const &event : events) {
-                m_diceGraphics->updateAcceleration(RainbowDice::AccelerationEventType::ACCELEROMETER,
-                        event.x, event.y, event.z);
+    }
+
+    if (m_whichSensors.test(Sensors::ACCELEROMETER_SENSOR) && sensor.hasAccelerometerEvents()) {
+        std::vector<Sensors::AccelerationEvent> events = sensor.getAccelerometerEvents();
+        for (auto const &event : events) {
+            m_diceGraphics->updateAcceleration(RainbowDice::AccelerationEventType::ACCELEROMETER,
+                    event.x, event.y, event.z);
+        }
+
+    }
+}
+
+void DiceWorker::simulationLoop(Sensors &sensor) {
+    try {
+        FrameScheduler<> scheduler{m_targetFramesPerSecond, m_settlingFramesPerSecond};
+        scheduler.start();
+        while (!m_stopSimulation.load(std::memory_order_acquire)) {
+            drainSensors(sensor);
+
+            m_diceGraphics->simulate();
+
+            // The render thread takes over once all the dice are stopped (for rerolls, results,
+            // etc).
+            if (m_diceGraphics->allStopped()) {
+                break;
             }
 
+            scheduler.frameDone(!m_diceGraphics->anyRolling());
         }
+    } catch (...) {
+        m_simulationError = std::current_exception();
+    }
+}
+
+void DiceWorker::startSimulation(Sensors &sensor) {
+    m_diceGraphics->setSimulationThreaded(true);
+    m_stopSimulation.store(false, std::memory_order_release);
+    m_simulationError = nullptr;
+    m_simulationThread = std::thread(&DiceWorker::simulationLoop, this, std::ref(sensor));
+}
 
+void DiceWorker::joinSimulation() {
+    m_stopSimulation.store(true, std::memory_order_release);
+    if (m_simulationThread.joinable()) {
+        m_simulationThread.join();
+    }
+    m_diceGraphics->setSimulationThreaded(false);
+}
+
+void DiceWorker::stopSimulation() {
+    joinSimulation();
+    if (m_simulationError != nullptr) {
+        std::exception_ptr error = m_simulationError;
+        m_simulationError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+DrawEvent *DiceWorker::drawingLoop(bool reportResult) {
+    // The sensors are created (and their event queues attached to a looper) on this thread, but the
+    // simulation thread is the only one to read from them while it is running.
+    Sensors sensor{m_whichSensors};
+    m_frameScheduler.start();
+
+    // the first dice that land in this roll start a new running total in java.
+    bool firstSettled = true;
+    m_diceGraphics->restartSettledDice();
+
+    // the event the waiting loop has to handle, if the drawing loop stopped for one.
+    DrawEvent *eventForWaitingLoop = nullptr;
+
+    auto handleEvents = [&](uint32_t &nbrRequireRedraw) -> bool {
         // events are a lot cheaper than a redraw, so process several of them.
-        uint32_t nbrRequireRedraw = 0;
         while (nbrRequireRedraw < m_maxEventsBeforeRedraw) {
             auto event = diceChannel().getEventNoWait();
             if (event != nullptr) {
@@ -208,12 +451,21 @@ std::shared_ptr<DrawEvent> DiceWorker::drawingLoop(bool reportResult) {
                     case DrawEvent::drawStoppedDice:
                         // let the waiting loop handle these.  Just return the event - this signals
                         // that the waiting loop needs to handle these events.
-                        return event;
+                        stopSimulation();
+                        eventForWaitingLoop = event;
+                        return false;
                     case DrawEvent::surfaceChanged:
+                        // this moves the dice, so the simulation cannot be running.
+                        stopSimulation();
+                        if ((*event)(m_diceGraphics, m_notify)) {
+                            nbrRequireRedraw++;
+                        }
+                        startSimulation(sensor);
+                        break;
                     case DrawEvent::scrollSurface:
                     case DrawEvent::scaleSurface:
                     case DrawEvent::resetView:
-                        // process the event.
+                        // process the event.  These only change the view.
                         if ((*event)(m_diceGraphics, m_notify)) {
                             nbrRequireRedraw++;
                         }
@@ -229,23 +481,68 @@ std::shared_ptr<DrawEvent> DiceWorker::drawingLoop(bool reportResult) {
                 break;
             }
         }
+        return true;
+    };
 
-        bool needsRedraw = m_diceGraphics->updateUniformBuffer();
-        if (needsRedraw || nbrRequireRedraw > 0) {
-            m_diceGraphics->drawFrame();
+    auto frameDrawn = [&](bool drew, bool moved) {
+        recordFrameStatistics();
+        if (drew) {
+            metrics::registry().endFrame();
         }
 
-        if (m_diceGraphics->allStopped()) {
-            if (m_diceGraphics->needsReroll()) {
-                m_diceGraphics->addRollingDice();
-                continue;
+        // send each die's result as soon as it lands instead of waiting for all the dice to
+        // finish their stopped animations.
+        if (reportResult && moved) {
+            std::vector<SettledDie> settled = m_diceGraphics->takeSettledDice();
+            if (!settled.empty()) {
+                m_notify->sendSettledDice(m_diceGraphics->configurationId(), settled,
+                                          firstSettled);
+                firstSettled = false;
             }
-            if (reportResult) {
-                std::vector<std::vector<uint32_t>> results = m_diceGraphics->getDiceResults();
-                m_notify->sendResult(m_diceGraphics->diceName(), m_diceGraphics->isModifiedRoll(),
-                                     results, m_diceGraphics->getDiceDescriptions());
-            }
-            return std::shared_ptr<DrawEvent>();
         }
+    };
+
+    auto allStopped = [&]() -> bool {
+        stopSimulation();
+        if (m_diceGraphics->needsReroll()) {
+            m_diceGraphics->addRollingDice();
+            startSimulation(sensor);
+            return false;
+        }
+        if (reportResult) {
+            std::vector<std::vector<uint32_t>> results = m_diceGraphics->getDiceResults();
+            m_notify->sendResult(m_diceGraphics->diceName(), m_diceGraphics->isModifiedRoll(),
+                                 m_diceGraphics->configurationId(), results,
+                                 m_diceGraphics->rollSeed());
+            metrics::add(metrics::rollsCompleted);
+            metrics::record(metrics::timeToResultMs,
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::steady_clock::now() - m_rollStart).count()));
+        }
+        return true;
+    };
+
+    try {
+        startSimulation(sensor);
+        runFrameLoop(*m_diceGraphics, m_frameScheduler, handleEvents, frameDrawn, allStopped);
+        recordFrameStatistics();
+        return eventForWaitingLoop;
+    } catch (...) {
+        joinSimulation();
+        throw;
     }
 }
+
+void DiceWorker::recordFrameStatistics() {
+    FrameStatistics const &stats = m_frameScheduler.stats();
+    if (stats.nbrFrames == m_nbrFramesRecorded) {
+        return;
+    }
+    m_nbrFramesRecorded = stats.nbrFrames;
+
+    metrics::record(metrics::frameTimeUs, static_cast<uint64_t>(stats.lastFrameTime * 1e6f));
+    metrics::record(metrics::frameBusyTimeUs, static_cast<uint64_t>(stats.lastBusyTime * 1e6f));
+    metrics::add(metrics::missedFrameDeadlines,
+                 stats.nbrMissedDeadlines - m_nbrMissedDeadlinesRecorded);
+    m_nbrMissedDeadlinesRecorded = stats.nbrMissedDeadlines;
+}
@@ -20,16 +20,19 @@
 #ifndef RAINBOWDICE_DRAWER_HPP
 #define RAINBOWDICE_DRAWER_HPP
 
+#include <array>
 #include <atomic>
-#include <mutex>
-#include <queue>
+#include <exception>
+#include <thread>
 #include <vector>
 #include <bitset>
+#include <chrono>
 #include "dice.hpp"
 #include "rainbowDice.hpp"
 #include "text.hpp"
 #include "native-lib.hpp"
 #include "diceDescription.hpp"
+#include "frameScheduler.hpp"
 
 class DrawEvent {
 public:
@@ -75,6 +78,11 @@ public:
         : m_width(width),
         m_height(height) {
     }
+
+    void set(uint32_t width, uint32_t height) {
+        m_width = width;
+        m_height = height;
+    }
     bool operator() (std::unique_ptr<RainbowDice> &diceGraphics,
                      std::shared_ptr<Notify> &notify) override {
         // giggle the device so that when the swapchain is recreated, it gets the correct width and
@@ -110,6 +118,11 @@ public:
           m_distanceY{inDistanceY} {
     }
 
+    void set(float inDistanceX, float inDistanceY) {
+        m_distanceX = inDistanceX;
+        m_distanceY = inDistanceY;
+    }
+
     bool operator() (std::unique_ptr<RainbowDice> &diceGraphics,
                      std::shared_ptr<Notify> &notify) override {
         diceGraphics->scroll(m_distanceX, m_distanceY);
@@ -129,6 +142,10 @@ public:
             : m_scaleFactor{inScaleFactor} {
     }
 
+    void set(float inScaleFactor) {
+        m_scaleFactor = inScaleFactor;
+    }
+
     bool operator() (std::unique_ptr<RainbowDice> &diceGraphics,
                      std::shared_ptr<Notify> &notify) override {
         diceGraphics->scale(m_scaleFactor);
@@ -150,6 +167,11 @@ public:
               m_y{inY} {
     }
 
+    void set(float inX, float inY) {
+        m_x = inX;
+        m_y = inY;
+    }
+
     bool operator() (std::unique_ptr<RainbowDice> &diceGraphics,
                      std::shared_ptr<Notify> &notify) override {
         bool before = diceGraphics->diceSelected();
@@ -178,7 +200,7 @@ public:
             if (hasResult) {
                 std::vector<std::vector<uint32_t>> results = diceGraphics->getDiceResults();
                 notify->sendResult(diceGraphics->diceName(), diceGraphics->isModifiedRoll(),
-                                   results, diceGraphics->getDiceDescriptions());
+                                   diceGraphics->configurationId(), results, diceGraphics->rollSeed());
                 return true;
             } else {
                 // Return false here because we will enter the drawing loop and then the dice will get
@@ -209,7 +231,7 @@ public:
             if (hasResult) {
                 std::vector<std::vector<uint32_t>> results = diceGraphics->getDiceResults();
                 notify->sendResult(diceGraphics->diceName(), diceGraphics->isModifiedRoll(),
-                                   results, diceGraphics->getDiceDescriptions());
+                                   diceGraphics->configurationId(), results, diceGraphics->rollSeed());
                 return true;
             } else {
                 // Return false here because we will enter the drawing loop and then the dice will get
@@ -237,7 +259,7 @@ public:
         if (diceGraphics->deleteSelected()) {
             std::vector<std::vector<uint32_t>> results = diceGraphics->getDiceResults();
             notify->sendResult(diceGraphics->diceName(), diceGraphics->isModifiedRoll(),
-                                 results, diceGraphics->getDiceDescriptions());
+                                 diceGraphics->configurationId(), results, diceGraphics->rollSeed());
             notify->sendSelected(false);
             return true;
         } else {
@@ -268,16 +290,19 @@ public:
 class DrawStoppedDiceEvent : public DrawEvent {
     std::string m_name;
     bool m_isModifiedRoll;
+    int32_t m_configurationId;
     std::vector<std::shared_ptr<DiceDescription>> m_dice;
     std::shared_ptr<TextureAtlas> m_texture;
     std::vector<std::vector<uint32_t>> m_upFaceIndices;
 public:
     DrawStoppedDiceEvent(std::string inName,
+                int32_t inConfigurationId,
                 std::vector<std::shared_ptr<DiceDescription>> inDice,
                 std::shared_ptr<TextureAtlas> inTexture,
                 std::vector<std::vector<uint32_t>> inUpFaceIndices,
                 bool inIsModifiedRoll)
             : m_name{std::move(inName)},
+              m_configurationId{inConfigurationId},
               m_dice{std::move(inDice)},
               m_texture{std::move(inTexture)},
               m_upFaceIndices{std::move(inUpFaceIndices)},
@@ -287,10 +312,9 @@ public:
 
     bool operator() (std::unique_ptr<RainbowDice> &diceGraphics,
                      std::shared_ptr<Notify> &notify) override {
+        diceGraphics->setConfigurationId(m_configurationId);
         diceGraphics->setTexture(m_texture);
-        diceGraphics->setDice(m_name, m_dice, m_isModifiedRoll);
-        diceGraphics->initModels();
-        diceGraphics->resetToStoppedPositions(m_upFaceIndices);
+        diceGraphics->showStoppedDice(m_name, m_dice, m_isModifiedRoll, m_upFaceIndices);
 
         // redraw the frame right away and then return false because this event means that we
         // should redraw immediately and not wait for some number of events to come up before we
@@ -307,19 +331,30 @@ public:
 
 class DiceChangeEvent : public DrawEvent {
     std::string m_diceName;
+    int32_t m_configurationId;
     std::vector<std::shared_ptr<DiceDescription>> m_dice;
     std::shared_ptr<TextureAtlas> m_texture;
+    RandomSeed m_seed;
 public:
-    DiceChangeEvent(std::string inDiceName, std::vector<std::shared_ptr<DiceDescription>> inDice,
-        std::shared_ptr<TextureAtlas> inTexture)
+    // configurationId: the ID Java knows the dice configuration by, it is sent back with the
+    // results.
+    // seed: the seed to roll the dice with, to replay a roll.  Each roll gets a new random seed
+    // if this is null.
+    DiceChangeEvent(std::string inDiceName, int32_t inConfigurationId,
+        std::vector<std::shared_ptr<DiceDescription>> inDice,
+        std::shared_ptr<TextureAtlas> inTexture, RandomSeed const *seed)
         : m_diceName{std::move(inDiceName)},
+        m_configurationId{inConfigurationId},
         m_dice{std::move(inDice)},
-        m_texture{std::move(inTexture)}
+        m_texture{std::move(inTexture)},
+        m_seed{seed != nullptr ? *seed : Random::newSeed()}
     {
     }
 
     bool operator() (std::unique_ptr<RainbowDice> &diceGraphics,
                      std::shared_ptr<Notify> &notify) override {
+        diceGraphics->setRollSeed(m_seed);
+        diceGraphics->setConfigurationId(m_configurationId);
         bool hasResult = diceGraphics->changeDice(m_diceName, m_dice, m_texture);
         notify->sendSelected(false);
         if (hasResult) {
@@ -327,7 +362,7 @@ public:
             // Return the results to the GUI.
             std::vector<std::vector<uint32_t>> results = diceGraphics->getDiceResults();
             notify->sendResult(diceGraphics->diceName(), diceGraphics->isModifiedRoll(),
-                                 results, diceGraphics->getDiceDescriptions());
+                                 diceGraphics->configurationId(), results, diceGraphics->rollSeed());
             return true;
         } else {
             // We don't have a result for the dice here because these are rolling dice.
@@ -345,26 +380,103 @@ public:
 };
 
 /* Used to communicate between the gui thread and the drawing thread.
+ *
+ * This is a bounded single producer (the gui thread), single consumer (the drawing thread)
+ * lock-free ring of preallocated slots.  The small, frequent events (scroll, scale, tap, etc) are
+ * stored directly in the slots so sending them does not allocate.  A scroll or scale event is merged
+ * into the previous event if that event is of the same type and the drawing thread has not picked
+ * it up yet.  The drawing thread only blocks (on a futex) when the ring is empty.  If the ring is
+ * full, the gui thread waits up to m_maxPushWait for the drawing thread to make room for an event
+ * that cannot be merged (only scroll and scale can be dropped right away).  Every event that is
+ * dropped is counted in metrics::eventsDropped.
+ *
+ * The events returned by getEvent and getEventNoWait are owned by the channel and are only valid
+ * until the next call to getEvent, getEventNoWait, or clearQueue.
  */
 class DiceChannel {
 private:
-    std::mutex m_eventLock;
-    std::condition_variable m_eventConditionVariable;
+    // must be a power of 2.
+    static uint64_t constexpr const m_ringSize = 256;
+
+    // how long the gui thread waits for room in a full ring before giving up on an event.
+    static std::chrono::milliseconds constexpr const m_maxPushWait{50};
+
+    enum SlotState : uint32_t {
+        slotEmpty,
+        slotPublished,
+        slotMerging,
+        slotReading
+    };
+
+    struct Slot {
+        std::atomic<uint32_t> state;
+        DrawEvent::evtype type;
+        float x;
+        float y;
+
+        // only used for the events that carry dice configurations.
+        std::shared_ptr<DrawEvent> event;
+    };
+
+    std::array<Slot, m_ringSize> m_ring;
+
+    // the next slot the gui thread will write.  Only written by the gui thread.
+    std::atomic<uint64_t> m_head;
+
+    // the next slot the drawing thread will read.  Only written by the drawing thread.
+    std::atomic<uint64_t> m_tail;
 
-    std::queue<std::shared_ptr<DrawEvent>> m_drawEventQueue;
-    bool m_stopDrawing;
+    std::atomic<bool> m_stopDrawing;
+
+    // incremented every time an event is published.  The drawing thread waits on this word.
+    std::atomic<int32_t> m_futex;
+    std::atomic<bool> m_consumerWaiting;
+
+    // The events handed to the drawing thread.  These are only accessed by the drawing thread.
+    StopDrawingEvent m_stopDrawingEvent;
+    SurfaceChangedEvent m_surfaceChangedEvent;
+    ScrollEvent m_scrollEvent;
+    ScaleEvent m_scaleEvent;
+    TapDiceEvent m_tapDiceEvent;
+    RerollSelected m_rerollSelectedEvent;
+    AddRerollSelected m_addRerollSelectedEvent;
+    DeleteSelected m_deleteSelectedEvent;
+    ResetView m_resetViewEvent;
+    std::shared_ptr<DrawEvent> m_currentEvent;
+
+    bool push(DrawEvent::evtype type, float x, float y, std::shared_ptr<DrawEvent> event);
+    bool pushWaiting(DrawEvent::evtype type, float x, float y, std::shared_ptr<DrawEvent> event);
+    bool merge(DrawEvent::evtype type, float x, float y);
+    DrawEvent *pop();
+    void wake();
 
 public:
-    DiceChannel()
-            : m_stopDrawing{false}
-    {}
+    DiceChannel();
+
+    DrawEvent *getEventNoWait();
+
+    // blocks waiting for the next event.
+    DrawEvent *getEvent();
 
-    std::shared_ptr<DrawEvent> getEventNoWait();
-    std::shared_ptr<DrawEvent> getEvent();
+    // for the events that carry data that cannot be stored in a slot (diceChange and
+    // drawStoppedDice).  Throws if the ring stays full for m_maxPushWait.
+    void sendEvent(std::shared_ptr<DrawEvent> event);
+
+    // Throws if the ring stays full for m_maxPushWait.
+    void sendSurfaceChanged(uint32_t width, uint32_t height);
+
+    // These are merged into the last event if they can be and dropped if the ring is full.
+    void sendScroll(float distanceX, float distanceY);
+    void sendScale(float scaleFactor);
+
+    // These are dropped if the ring stays full for m_maxPushWait, i.e. if the drawing thread is
+    // not running.  Returns false if the event was dropped.
+    bool sendTapDice(float x, float y);
+    bool sendEvent(DrawEvent::evtype type);
 
-    // blocks on sending event
-    void sendEvent(std::shared_ptr<DrawEvent> const &event);
     void sendStopDrawingEvent();
+
+    // must only be called from the drawing thread.
     void clearQueue();
 };
 
@@ -384,12 +496,22 @@ public:
                bool inUseGravity,
                bool inDrawRollingDice,
                bool inUseLegacy,
-               bool reverseGravity)
+               bool reverseGravity,
+               float displayRefreshRate)
             : m_whichSensors{},
               m_tryVulkan{!inUseLegacy},
               m_diceGraphics{},
-              m_notify{std::move(inNotify)}
+              m_notify{std::move(inNotify)},
+              m_frameScheduler{m_targetFramesPerSecond, m_settlingFramesPerSecond},
+              m_nbrFramesRecorded{0},
+              m_nbrMissedDeadlinesRecorded{0},
+              m_simulationThread{},
+              m_stopSimulation{false},
+              m_simulationError{},
+              m_rollStart{}
     {
+        m_frameScheduler.setDisplayRefreshRate(displayRefreshRate);
+
         std::bitset<3> whichSensors = Sensors::hasWhichSensors();
         if (inDrawRollingDice) {
             if (!inUseGravity) {
@@ -430,15 +552,51 @@ public:
     }
 
     void waitingLoop();
+
+    ~DiceWorker() {
+        if (m_simulationThread.joinable()) {
+            m_stopSimulation.store(true, std::memory_order_release);
+            m_simulationThread.join();
+        }
+    }
 private:
     static constexpr uint32_t m_maxEventsBeforeRedraw = 128;
 
+    // the frame rate while dice are rolling and the frame rate while the only animations are the
+    // stopped dice moving into place.
+    static constexpr uint32_t m_targetFramesPerSecond = 60;
+    static constexpr uint32_t m_settlingFramesPerSecond = 30;
+
     std::bitset<3> m_whichSensors;
     bool m_tryVulkan;
     std::unique_ptr<RainbowDice> m_diceGraphics;
     std::shared_ptr<Notify> m_notify;
+    FrameScheduler<> m_frameScheduler;
+
+    // how much of the frame statistics was already recorded in the metrics.
+    uint64_t m_nbrFramesRecorded;
+    uint64_t m_nbrMissedDeadlinesRecorded;
+
+    // While dice are rolling, the physics runs on this thread and publishes the dice positions to
+    // the drawing thread through a triple buffer (see RainbowDice::simulate).
+    std::thread m_simulationThread;
+    std::atomic<bool> m_stopSimulation;
+    std::exception_ptr m_simulationError;
+
+    // when the roll being drawn was requested, for the time to result metric.
+    std::chrono::steady_clock::time_point m_rollStart;
+
+    DrawEvent *drawingLoop(bool reportResult);
+
+    // records the frame statistics of the last frame in the metrics.
+    void recordFrameStatistics();
+    void simulationLoop(Sensors &sensor);
+    void drainSensors(Sensors &sensor);
+    void startSimulation(Sensors &sensor);
+    void joinSimulation();
 
-    std::shared_ptr<DrawEvent> drawingLoop(bool reportResult);
+    // joins the simulation thread and rethrows any exception it had.
+    void stopSimulation();
     void initDiceGraphics(std::shared_ptr<WindowType> surface,
                           bool inUseGravity, bool inDrawRollingDice, bool reverseGravity);
 };
@@ -0,0 +1,244 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_FRAME_SCHEDULER_HPP
+#define RAINBOWDICE_FRAME_SCHEDULER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <limits>
+
+/* The real clock used by the frame scheduler.  A test can substitute a clock with the same
+ * interface whose sleepUntil just advances its notion of the current time.
+ */
+class SteadyFrameClock {
+public:
+    using clock = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+    using duration = clock::duration;
+
+    time_point now() { return clock::now(); }
+    void sleepUntil(time_point deadline) { std::this_thread::sleep_until(deadline); }
+};
+
+struct FrameStatistics {
+    uint64_t nbrFrames;
+    uint64_t nbrMissedDeadlines;
+
+    // all times are in seconds.  frame time is the time between the starts of consecutive frames,
+    // busy time is the time spent working on a frame (i.e. excluding the time spent sleeping).
+    float lastFrameTime;
+    float averageFrameTime;
+    float minFrameTime;
+    float maxFrameTime;
+    float lastBusyTime;
+    float averageBusyTime;
+
+    FrameStatistics()
+            : nbrFrames{0},
+              nbrMissedDeadlines{0},
+              lastFrameTime{0.0f},
+              averageFrameTime{0.0f},
+              minFrameTime{std::numeric_limits<float>::max()},
+              maxFrameTime{0.0f},
+              lastBusyTime{0.0f},
+              averageBusyTime{0.0f}
+    {}
+};
+
+/* Paces the drawing loop.  After each frame, the caller calls frameDone which sleeps until the next
+ * frame deadline.  Deadlines are spaced by the target frame period, or by the (longer) idle period
+ * when only the animations that move stopped dice into place are running.  If a frame runs past its
+ * deadline, the schedule is restarted from the current time instead of trying to catch up.
+ *
+ * A frame that was presented (eglSwapBuffers, vkQueuePresentKHR) already waited for a vsync, and
+ * the next one will wait for one too.  So the schedule after a presented frame starts from when
+ * the present returned, and the scheduler only sleeps for the part of the period that the next
+ * present does not cover, i.e. the period less one display refresh.  At a frame rate the display
+ * can keep up with it does not sleep at all and the presents pace the frames.  Sleeping to a
+ * fixed deadline on top of the presents would make them miss every other vsync.
+ */
+template <typename ClockType = SteadyFrameClock>
+class FrameScheduler {
+public:
+    using time_point = typename ClockType::time_point;
+    using duration = typename ClockType::duration;
+
+    FrameScheduler(uint32_t targetFramesPerSecond, uint32_t idleFramesPerSecond,
+                   ClockType inClock = ClockType{})
+            : m_clock{std::move(inClock)},
+              m_targetPeriod{periodFromRate(targetFramesPerSecond)},
+              m_idlePeriod{periodFromRate(idleFramesPerSecond)},
+              m_refreshPeriod{periodFromRate(m_defaultRefreshRate)},
+              m_frameStart{},
+              m_deadline{},
+              m_stats{}
+    {}
+
+    // call before the first frame of a drawing loop.
+    void start() {
+        m_frameStart = m_clock.now();
+        m_deadline = m_frameStart;
+    }
+
+    /* call after a frame.  presented is true if the frame was drawn and presented, in which case
+     * the present is assumed to have returned at a vsync.  Sleeps until it is time to start the next
+     * frame.
+     */
+    void frameDone(bool onlySettling, bool presented = false) {
+        time_point now = m_clock.now();
+        float busyTime = seconds(now - m_frameStart);
+        duration period = onlySettling ? m_idlePeriod : m_targetPeriod;
+
+        if (presented) {
+            // the present is due at the first vsync after the frame started, at most a refresh
+            // later.  It is late if it returned more than half a refresh after that.
+            if (now - m_deadline > m_refreshPeriod + m_refreshPeriod / 2) {
+                m_stats.nbrMissedDeadlines++;
+            }
+            m_deadline = now + (period - std::min(period, m_refreshPeriod));
+        } else {
+            m_deadline += period;
+            if (m_deadline < now) {
+                m_stats.nbrMissedDeadlines++;
+                m_deadline = now;
+            }
+        }
+
+        if (m_deadline > now) {
+            m_clock.sleepUntil(m_deadline);
+            now = m_clock.now();
+        }
+
+        float frameTime = seconds(now - m_frameStart);
+        m_frameStart = now;
+        updateStats(frameTime, busyTime);
+    }
+
+    void setTargetFramesPerSecond(uint32_t targetFramesPerSecond) {
+        m_targetPeriod = periodFromRate(targetFramesPerSecond);
+    }
+
+    void setIdleFramesPerSecond(uint32_t idleFramesPerSecond) {
+        m_idlePeriod = periodFromRate(idleFramesPerSecond);
+    }
+
+    // the refresh rate of the display the frames are presented on (Display.getRefreshRate).
+    void setDisplayRefreshRate(float refreshRate) {
+        if (refreshRate >= 1.0f) {
+            m_refreshPeriod = std::chrono::duration_cast<duration>(
+                    std::chrono::duration<float>(1.0f / refreshRate));
+        }
+    }
+
+    FrameStatistics const &stats() const { return m_stats; }
+    void resetStats() { m_stats = FrameStatistics{}; }
+
+    ClockType &clock() { return m_clock; }
+
+private:
+    // used until the display's refresh rate is set.
+    static uint32_t constexpr const m_defaultRefreshRate = 60;
+
+    ClockType m_clock;
+    duration m_targetPeriod;
+    duration m_idlePeriod;
+    duration m_refreshPeriod;
+    time_point m_frameStart;
+
+    // when the current frame was due to start.
+    time_point m_deadline;
+    FrameStatistics m_stats;
+
+    static duration periodFromRate(uint32_t framesPerSecond) {
+        if (framesPerSecond == 0) {
+            // no pacing.
+            return duration::zero();
+        }
+        return std::chrono::duration_cast<duration>(std::chrono::seconds(1)) / framesPerSecond;
+    }
+
+    static float seconds(duration d) {
+        return std::chrono::duration<float, std::chrono::seconds::period>(d).count();
+    }
+
+    void updateStats(float frameTime, float busyTime) {
+        m_stats.nbrFrames++;
+        m_stats.lastFrameTime = frameTime;
+        m_stats.lastBusyTime = busyTime;
+        if (frameTime < m_stats.minFrameTime) {
+            m_stats.minFrameTime = frameTime;
+        }
+        if (frameTime > m_stats.maxFrameTime) {
+            m_stats.maxFrameTime = frameTime;
+        }
+
+        // running mean
+        float n = static_cast<float>(m_stats.nbrFrames);
+        m_stats.averageFrameTime += (frameTime - m_stats.averageFrameTime) / n;
+        m_stats.averageBusyTime += (busyTime - m_stats.averageBusyTime) / n;
+    }
+};
+
+/* The frame loop of DiceWorker::drawingLoop.  The events, sensors and results are left to the
+ * caller so that the loop runs the same on the host, with a fake clock and a renderer that draws
+ * nothing.  Each turn:
+ *   - handleEvents(nbrRequireRedraw) handles the pending events and counts the ones that need a
+ *     redraw.  The loop ends if it returns false.
+ *   - the latest simulation snapshot is applied.  If it moved anything or an event needs a redraw,
+ *     a frame is drawn and presented.  Then frameDrawn(drew, moved) is called.
+ *   - once the snapshot has all the dice stopped, allStopped() is called.  The loop ends if it
+ *     returns true.  Otherwise a reroll was started: the schedule starts over and the loop goes on
+ *     without waiting.
+ *   - otherwise the scheduler waits for the next frame.
+ * The renderer needs applySimulationSnapshot, drawFrame and simulationSnapshot (see RainbowDice).
+ * The caller starts the scheduler.
+ */
+template <typename Renderer, typename ClockType, typename HandleEvents, typename FrameDrawn,
+          typename AllStopped>
+void runFrameLoop(Renderer &renderer, FrameScheduler<ClockType> &scheduler,
+                  HandleEvents &&handleEvents, FrameDrawn &&frameDrawn, AllStopped &&allStopped) {
+    while (true) {
+        uint32_t nbrRequireRedraw = 0;
+        if (!handleEvents(nbrRequireRedraw)) {
+            return;
+        }
+
+        bool moved = renderer.applySimulationSnapshot();
+        bool drew = moved || nbrRequireRedraw > 0;
+        if (drew) {
+            renderer.drawFrame();
+        }
+        frameDrawn(drew, moved);
+
+        if (renderer.simulationSnapshot().allStopped) {
+            if (allStopped()) {
+                return;
+            }
+            scheduler.start();
+            continue;
+        }
+
+        scheduler.frameDone(!renderer.simulationSnapshot().anyRolling, drew);
+    }
+}
+
+#endif // RAINBOWDICE_FRAME_SCHEDULER_HPP
@@ -19,7 +19,10 @@
  */
 
 #include <set>
+#include <cstring>
 #include "graphicsVulkan.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 namespace vulkan {
 /**
@@ -742,14 +745,24 @@ namespace vulkan {
     }
 
     void Shader::createShaderModule(std::string const &codeFile) {
-        auto code = readFile(codeFile.c_str());
+        TRACE_SPAN("loadShader");
+        AssetView code = readAsset(codeFile);
 
         VkShaderModuleCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         createInfo.codeSize = code.size();
 
-        /* vector.data is 32 bit aligned as is required. */
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        /* pCode must be 32 bit aligned.  Mapped assets and asset buffers normally are (assets are
+         * zipaligned), but copy the code if it is not.
+         */
+        std::vector<uint32_t> alignedCode;
+        if (reinterpret_cast<uintptr_t>(code.data()) % alignof(uint32_t) == 0) {
+            createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+        } else {
+            alignedCode.resize((code.size() + sizeof (uint32_t) - 1) / sizeof (uint32_t));
+            memcpy(alignedCode.data(), code.data(), code.size());
+            createInfo.pCode = alignedCode.data();
+        }
 
         VkShaderModule shaderModuleRaw;
         if (vkCreateShaderModule(m_device->logicalDevice().get(), &createInfo, nullptr, &shaderModuleRaw) !=
@@ -1151,11 +1164,14 @@ namespace vulkan {
             throw std::runtime_error("Failed to allocate buffer memory!");
         }
 
-        auto bufmemdeleter = [capDevice](VkDeviceMemory bufmem) {
+        auto bytes = static_cast<int64_t>(allocInfo.allocationSize);
+        auto bufmemdeleter = [capDevice, bytes](VkDeviceMemory bufmem) {
             vkFreeMemory(capDevice->logicalDevice().get(), bufmem, nullptr);
+            metrics::add(metrics::bufferBytesAllocated, -bytes);
         };
 
         m_bufferMemory.reset(bufmem, bufmemdeleter);
+        metrics::add(metrics::bufferBytesAllocated, bytes);
 
         VkResult result = vkBindBufferMemory(m_device->logicalDevice().get(), m_buffer.get(), m_bufferMemory.get(),
                                              0 /* offset into the memory */);
@@ -1328,12 +1344,15 @@ namespace vulkan {
         VkPipelineStageFlags destinationStage;
 
 
-        /* There are two transitions that we handle:
+        /* There are three transitions that we handle:
          *
          * undefined -> transfer destination: transfer writes don't need to wait on anything
          *
          * transfer destination -> shader reading: fragment shader reads need to wait on
          *      transfer writes
+         *
+         * shader reading -> transfer destination: updating part of a texture.  Transfer writes
+         *      need to wait on the fragment shader reads of the frames drawn with it.
          */
         if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
             newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
@@ -1349,6 +1368,13 @@ namespace vulkan {
 
             sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
             destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        } else if (oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL &&
+                   newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            sourceStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         } else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
                    newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
             barrier.srcAccessMask = 0;
@@ -1409,7 +1435,20 @@ namespace vulkan {
         cmds.end();
     }
 
-    void ImageView::createImageView(VkFormat format, VkImageAspectFlags aspectFlags) {
+    void Image::copyBufferToImage(Buffer &buffer, std::vector<VkBufferImageCopy> const &regions,
+                                  std::shared_ptr<CommandPool> const &pool) {
+        SingleTimeCommands cmds{m_device, pool};
+        cmds.begin();
+
+        vkCmdCopyBufferToImage(cmds.commandBuffer().get(), buffer.buffer().get(),
+                               m_image.get(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(regions.size()), regions.data());
+
+        cmds.end();
+    }
+
+    void ImageView::createImageView(VkFormat format, VkImageAspectFlags aspectFlags,
+                                    VkComponentMapping const &components) {
         VkImageViewCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
         createInfo.image = m_image->image().get();
@@ -1421,12 +1460,9 @@ namespace vulkan {
         createInfo.format = format;
 
         /* components enables swizzling the color channels around.  Can map to other channels
-         * or use the constant values of 0 and 1.  Use the default mapping...
+         * or use the constant values of 0 and 1.
          */
-        createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+        createInfo.components = components;
 
         /* subresourcesRange describes the image's purpose and which part of the image
          * should be accessed.  Use the images as color targets without any mimapping levels
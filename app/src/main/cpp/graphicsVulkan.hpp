@@ -595,6 +595,10 @@ namespace vulkan {
 
         void copyBufferToImage(Buffer &buffer, std::shared_ptr<CommandPool> const &pool);
 
+        // copies parts of buffer to parts of the image.
+        void copyBufferToImage(Buffer &buffer, std::vector<VkBufferImageCopy> const &regions,
+                               std::shared_ptr<CommandPool> const &pool);
+
         void transitionImageLayout(VkFormat format, VkImageLayout oldLayout,
                                    VkImageLayout newLayout, std::shared_ptr<CommandPool> const &pool);
 
@@ -624,10 +628,13 @@ namespace vulkan {
     class ImageView {
     public:
         ImageView(std::shared_ptr<Image> const &inImage, VkFormat format,
-                  VkImageAspectFlags aspectFlags)
+                  VkImageAspectFlags aspectFlags,
+                  VkComponentMapping const &components = {VK_COMPONENT_SWIZZLE_IDENTITY,
+                          VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                          VK_COMPONENT_SWIZZLE_IDENTITY})
                 : m_image{inImage},
                   m_imageView{} {
-            createImageView(format, aspectFlags);
+            createImageView(format, aspectFlags, components);
         }
 
         inline std::shared_ptr<VkImageView_T> const &imageView() { return m_imageView; }
@@ -640,7 +647,8 @@ namespace vulkan {
     private:
         inline VkDevice logicalDevice() { return m_image->device()->logicalDevice().get(); }
 
-        void createImageView(VkFormat format, VkImageAspectFlags aspectFlags);
+        void createImageView(VkFormat format, VkImageAspectFlags aspectFlags,
+                             VkComponentMapping const &components);
     };
 
     class ImageFactory {
@@ -0,0 +1,252 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_GROUPED_VECTOR_HPP
+#define RAINBOWDICE_GROUPED_VECTOR_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/* Vector that keeps its values in one dense array, divided into ordered groups.  Each group owns
+ * a contiguous range of the array with some spare capacity at its end, so iterating over the
+ * groups (and the values in each group) walks contiguous memory.
+ *
+ * Appending to a group is O(1) amortized: when a group runs out of capacity it is moved to the end
+ * of the array with double the capacity, and the abandoned ranges are reclaimed by compacting the
+ * array once they make up half of it.  Inserting or erasing inside a group only shifts the values
+ * in that group.  Pointers and references to values, and group views, are invalidated by any
+ * insert or erase.
+ */
+template <typename T>
+class GroupedVector {
+public:
+    template <typename U>
+    class BasicGroupView {
+    public:
+        BasicGroupView(U *inBegin, uint32_t inSize)
+                : m_begin{inBegin},
+                  m_size{inSize}
+        {}
+
+        U *begin() const { return m_begin; }
+        U *end() const { return m_begin + m_size; }
+        uint32_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        U &operator[](uint32_t i) const { return m_begin[i]; }
+        U &front() const { return m_begin[0]; }
+        U &back() const { return m_begin[m_size - 1]; }
+
+    private:
+        U *m_begin;
+        uint32_t m_size;
+    };
+
+    using GroupView = BasicGroupView<T>;
+    using ConstGroupView = BasicGroupView<T const>;
+
+    template <typename VectorType, typename ViewType>
+    class BasicGroupIterator {
+    public:
+        BasicGroupIterator(VectorType *inVector, uint32_t inGroup)
+                : m_vector{inVector},
+                  m_group{inGroup}
+        {}
+
+        ViewType operator*() const { return m_vector->group(m_group); }
+        BasicGroupIterator &operator++() { m_group++; return *this; }
+        bool operator==(BasicGroupIterator const &other) const { return m_group == other.m_group; }
+        bool operator!=(BasicGroupIterator const &other) const { return m_group != other.m_group; }
+
+    private:
+        VectorType *m_vector;
+        uint32_t m_group;
+    };
+
+    using iterator = BasicGroupIterator<GroupedVector, GroupView>;
+    using const_iterator = BasicGroupIterator<GroupedVector const, ConstGroupView>;
+
+    GroupedVector()
+            : m_values{},
+              m_groups{},
+              m_size{0},
+              m_abandoned{0}
+    {}
+
+    // iterates over the groups in order.
+    iterator begin() { return iterator{this, 0}; }
+    iterator end() { return iterator{this, nbrGroups()}; }
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, nbrGroups()}; }
+
+    uint32_t nbrGroups() const { return static_cast<uint32_t>(m_groups.size()); }
+
+    // the total number of values in all the groups.
+    uint32_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    // the number of entries in the dense array, including spare capacity and abandoned ranges.
+    uint32_t capacity() const { return static_cast<uint32_t>(m_values.size()); }
+
+    GroupView group(uint32_t g) {
+        return GroupView{m_values.data() + m_groups[g].begin, m_groups[g].size};
+    }
+
+    ConstGroupView group(uint32_t g) const {
+        return ConstGroupView{m_values.data() + m_groups[g].begin, m_groups[g].size};
+    }
+
+    // removes all the values and groups.
+    void clear() {
+        m_values.clear();
+        m_groups.clear();
+        m_size = 0;
+        m_abandoned = 0;
+    }
+
+    // adds an empty group after the existing groups and returns its index.  Most groups only
+    // ever hold one value, so by default no spare capacity is reserved.
+    uint32_t addGroup(uint32_t capacity = 1) {
+        capacity = std::max(capacity, uint32_t{1});
+        m_groups.push_back(Group{static_cast<uint32_t>(m_values.size()), 0, capacity});
+        m_values.resize(m_values.size() + capacity);
+        return nbrGroups() - 1;
+    }
+
+    void append(uint32_t g, T value) {
+        if (g >= m_groups.size()) {
+            throw std::out_of_range("Grouped vector append out of range.");
+        }
+        insert(g, m_groups[g].size, std::move(value));
+    }
+
+    // inserts value in group g before the value at position.
+    void insert(uint32_t g, uint32_t position, T value) {
+        if (g >= m_groups.size() || position > m_groups[g].size) {
+            throw std::out_of_range("Grouped vector insert out of range.");
+        }
+
+        if (m_groups[g].size == m_groups[g].capacity) {
+            relocate(g, 2 * m_groups[g].capacity);
+        }
+
+        Group &grp = m_groups[g];
+        std::move_backward(m_values.begin() + grp.begin + position,
+                           m_values.begin() + grp.begin + grp.size,
+                           m_values.begin() + grp.begin + grp.size + 1);
+        m_values[grp.begin + position] = std::move(value);
+        grp.size++;
+        m_size++;
+    }
+
+    // erases the value at position in group g.
+    void erase(uint32_t g, uint32_t position) {
+        if (g >= m_groups.size() || position >= m_groups[g].size) {
+            throw std::out_of_range("Grouped vector erase out of range.");
+        }
+
+        Group &grp = m_groups[g];
+        std::move(m_values.begin() + grp.begin + position + 1,
+                  m_values.begin() + grp.begin + grp.size,
+                  m_values.begin() + grp.begin + position);
+        m_values[grp.begin + grp.size - 1] = T{};
+        grp.size--;
+        m_size--;
+    }
+
+    // removes all the values from group g, the group itself remains (empty).
+    void clearGroup(uint32_t g) {
+        Group &grp = m_groups[g];
+        std::fill(m_values.begin() + grp.begin, m_values.begin() + grp.begin + grp.size, T{});
+        m_size -= grp.size;
+        grp.size = 0;
+    }
+
+    // erases every value for which pred returns true, keeping the order of the others.  Returns
+    // the number of values erased.
+    template <typename Predicate>
+    uint32_t eraseIf(Predicate pred) {
+        uint32_t nbrErased = 0;
+        for (auto &grp : m_groups) {
+            auto first = m_values.begin() + grp.begin;
+            auto last = first + grp.size;
+            auto kept = std::remove_if(first, last, pred);
+            std::fill(kept, last, T{});
+            uint32_t nbrKept = static_cast<uint32_t>(kept - first);
+            nbrErased += grp.size - nbrKept;
+            grp.size = nbrKept;
+        }
+        m_size -= nbrErased;
+        return nbrErased;
+    }
+
+private:
+    struct Group {
+        uint32_t begin;
+        uint32_t size;
+        uint32_t capacity;
+    };
+
+    std::vector<T> m_values;
+    std::vector<Group> m_groups;
+
+    uint32_t m_size;
+
+    // the number of entries in ranges left behind when groups were moved.
+    uint32_t m_abandoned;
+
+    // moves group g to the end of the dense array with the new capacity.
+    void relocate(uint32_t g, uint32_t capacity) {
+        uint32_t newBegin = static_cast<uint32_t>(m_values.size());
+        m_values.resize(m_values.size() + capacity);
+
+        Group &grp = m_groups[g];
+        for (uint32_t i = 0; i < grp.size; i++) {
+            m_values[newBegin + i] = std::move(m_values[grp.begin + i]);
+            m_values[grp.begin + i] = T{};
+        }
+        m_abandoned += grp.capacity;
+        grp.begin = newBegin;
+        grp.capacity = capacity;
+
+        if (m_abandoned > m_values.size() / 2) {
+            compact();
+        }
+    }
+
+    // rebuilds the dense array without the abandoned ranges, keeping the groups in order.
+    void compact() {
+        std::vector<T> values;
+        values.resize(m_values.size() - m_abandoned);
+
+        uint32_t next = 0;
+        for (auto &grp : m_groups) {
+            std::move(m_values.begin() + grp.begin, m_values.begin() + grp.begin + grp.size,
+                      values.begin() + next);
+            grp.begin = next;
+            next += grp.capacity;
+        }
+
+        m_values = std::move(values);
+        m_abandoned = 0;
+    }
+};
+
+#endif // RAINBOWDICE_GROUPED_VECTOR_HPP
@@ -0,0 +1,158 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstdlib>
+#include <new>
+
+#include "metrics.hpp"
+
+namespace metrics {
+    constexpr uint32_t HistogramData::m_nbrBuckets;
+    constexpr int64_t Registry::m_snapshotVersion;
+
+    void HistogramData::pack(std::vector<int64_t> &out) const {
+        out.push_back(static_cast<int64_t>(m_count.load(std::memory_order_relaxed)));
+        out.push_back(static_cast<int64_t>(m_sum.load(std::memory_order_relaxed)));
+        out.push_back(static_cast<int64_t>(m_max.load(std::memory_order_relaxed)));
+        out.push_back(m_nbrBuckets);
+        for (auto const &bucket : m_buckets) {
+            out.push_back(static_cast<int64_t>(bucket.load(std::memory_order_relaxed)));
+        }
+    }
+
+    void Registry::endFrame() {
+        add(framesDrawn);
+
+        std::array<uint64_t, nbrCounters> current{};
+        for (uint32_t i = 0; i < nbrCounters; i++) {
+            current[i] = m_counters[i].load(std::memory_order_relaxed);
+        }
+
+        record(drawCallsPerFrame, current[drawCalls] - m_lastFrameCounters[drawCalls]);
+        record(verticesPerFrame, current[verticesDrawn] - m_lastFrameCounters[verticesDrawn]);
+        record(eventsPerFrame, current[eventsProcessed] - m_lastFrameCounters[eventsProcessed]);
+        record(bouncePairTestsPerFrame, current[bouncePairTests] - m_lastFrameCounters[bouncePairTests]);
+        record(allocationsPerFrame, current[allocations] - m_lastFrameCounters[allocations]);
+
+        m_lastFrameCounters = current;
+    }
+
+    std::vector<int64_t> Registry::snapshot() const {
+        std::vector<int64_t> out;
+        out.reserve(4 + nbrCounters + nbrGauges + nbrHistograms * (4 + HistogramData::m_nbrBuckets));
+
+        out.push_back(m_snapshotVersion);
+        out.push_back(nbrCounters);
+        for (auto const &counter : m_counters) {
+            out.push_back(static_cast<int64_t>(counter.load(std::memory_order_relaxed)));
+        }
+        out.push_back(nbrGauges);
+        for (auto const &gauge : m_gauges) {
+            out.push_back(gauge.load(std::memory_order_relaxed));
+        }
+        out.push_back(nbrHistograms);
+        for (auto const &histogram : m_histograms) {
+            histogram.pack(out);
+        }
+
+        return out;
+    }
+
+    Registry &registry() {
+        static Registry g_registry{};
+        return g_registry;
+    }
+} /* namespace metrics */
+
+#ifdef CQ_COUNT_ALLOCATIONS
+/* Count every allocation made through operator new so that allocations per frame can be reported.
+ * This replaces the global operator new of the whole library, so it is only built into debug
+ * builds and the host benchmarks (see app/CMakeLists.txt).  It costs a relaxed atomic increment per
+ * allocation.
+ */
+static void *countedAllocate(size_t size) {
+    metrics::add(metrics::allocations);
+    if (size == 0) {
+        size = 1;
+    }
+
+    // as the standard operator new does: give the new handler a chance to free memory and only
+    // throw when there is none.
+    while (true) {
+        void *p = malloc(size);
+        if (p != nullptr) {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+static void *countedAllocateNoThrow(size_t size) noexcept {
+    try {
+        return countedAllocate(size);
+    } catch (std::bad_alloc const &) {
+        return nullptr;
+    }
+}
+
+void *operator new(size_t size) {
+    return countedAllocate(size);
+}
+
+void *operator new[](size_t size) {
+    return countedAllocate(size);
+}
+
+void *operator new(size_t size, std::nothrow_t const &) noexcept {
+    return countedAllocateNoThrow(size);
+}
+
+void *operator new[](size_t size, std::nothrow_t const &) noexcept {
+    return countedAllocateNoThrow(size);
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, std::nothrow_t const &) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, std::nothrow_t const &) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    free(p);
+}
+
+#endif // CQ_COUNT_ALLOCATIONS
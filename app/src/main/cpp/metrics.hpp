@@ -0,0 +1,174 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_METRICS_HPP
+#define RAINBOWDICE_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/* Engine metrics: cheap atomic counters and gauges updated from anywhere in the engine, and
+ * histograms of per frame values that are recorded by the drawing thread at the end of each frame.
+ * A packed snapshot of everything can be taken at any time (see snapshot()).
+ */
+namespace metrics {
+    // Counters only ever go up.  Each counter also has a per frame histogram (see endFrame).
+    enum Counter : uint32_t {
+        drawCalls,
+        verticesDrawn,
+        eventsProcessed,
+        bouncePairTests,
+        allocations,            // only counted when built with CQ_COUNT_ALLOCATIONS (metrics.cpp)
+        framesDrawn,
+        rollsCompleted,
+        textureBytesUploaded,
+        eventsDropped,          // gui events lost because the drawing thread's queue was full
+        missedFrameDeadlines,   // frames that ran past their deadline (see FrameScheduler)
+        nbrCounters
+    };
+
+    // Gauges go up and down.
+    enum Gauge : uint32_t {
+        bufferBytesAllocated,
+        diceAlive,
+        nbrGauges
+    };
+
+    enum Histogram : uint32_t {
+        drawCallsPerFrame,
+        verticesPerFrame,
+        eventsPerFrame,
+        bouncePairTestsPerFrame,
+        allocationsPerFrame,
+        timeToResultMs,
+        frameTimeUs,            // from the start of one drawn frame to the start of the next
+        frameBusyTimeUs,        // the part of the frame time not spent sleeping
+        nbrHistograms
+    };
+
+    /* Histogram with power of 2 buckets: bucket 0 holds 0, bucket i holds values in
+     * [2^(i-1), 2^i).  The last bucket also holds everything larger.
+     */
+    class HistogramData {
+    public:
+        static uint32_t constexpr const m_nbrBuckets = 32;
+
+        HistogramData()
+                : m_count{0},
+                  m_sum{0},
+                  m_max{0},
+                  m_buckets{}
+        {
+            for (auto &bucket : m_buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        void record(uint64_t value) {
+            uint32_t bucket = 0;
+            while (bucket < m_nbrBuckets - 1 && value >= (uint64_t{1} << bucket)) {
+                bucket++;
+            }
+            m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum.fetch_add(value, std::memory_order_relaxed);
+
+            uint64_t max = m_max.load(std::memory_order_relaxed);
+            while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+        }
+
+        void pack(std::vector<int64_t> &out) const;
+
+    private:
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_sum;
+        std::atomic<uint64_t> m_max;
+        std::array<std::atomic<uint64_t>, m_nbrBuckets> m_buckets;
+    };
+
+    class Registry {
+    public:
+        Registry()
+                : m_counters{},
+                  m_gauges{},
+                  m_histograms{},
+                  m_lastFrameCounters{}
+        {
+            for (auto &counter : m_counters) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+            for (auto &gauge : m_gauges) {
+                gauge.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        inline void add(Counter counter, uint64_t value = 1) {
+            m_counters[counter].fetch_add(value, std::memory_order_relaxed);
+        }
+
+        inline void add(Gauge gauge, int64_t value) {
+            m_gauges[gauge].fetch_add(value, std::memory_order_relaxed);
+        }
+
+        inline void set(Gauge gauge, int64_t value) {
+            m_gauges[gauge].store(value, std::memory_order_relaxed);
+        }
+
+        inline void record(Histogram histogram, uint64_t value) {
+            m_histograms[histogram].record(value);
+        }
+
+        inline uint64_t value(Counter counter) const {
+            return m_counters[counter].load(std::memory_order_relaxed);
+        }
+
+        inline int64_t value(Gauge gauge) const {
+            return m_gauges[gauge].load(std::memory_order_relaxed);
+        }
+
+        // Records the per frame histograms from how much the counters went up since the last call.
+        // Must only be called from one thread (the drawing thread).
+        void endFrame();
+
+        /* Returns all the metrics packed as:
+         *   version, nbrCounters, counter values..., nbrGauges, gauge values...,
+         *   nbrHistograms, then for each histogram: count, sum, max, nbrBuckets, bucket counts...
+         */
+        std::vector<int64_t> snapshot() const;
+
+    private:
+        static int64_t constexpr const m_snapshotVersion = 1;
+
+        std::array<std::atomic<uint64_t>, nbrCounters> m_counters;
+        std::array<std::atomic<int64_t>, nbrGauges> m_gauges;
+        std::array<HistogramData, nbrHistograms> m_histograms;
+        std::array<uint64_t, nbrCounters> m_lastFrameCounters;
+    };
+
+    Registry &registry();
+
+    inline void add(Counter counter, uint64_t value = 1) { registry().add(counter, value); }
+    inline void add(Gauge gauge, int64_t value) { registry().add(gauge, value); }
+    inline void set(Gauge gauge, int64_t value) { registry().set(gauge, value); }
+    inline void record(Histogram histogram, uint64_t value) { registry().record(histogram, value); }
+} /* namespace metrics */
+
+#endif // RAINBOWDICE_METRICS_HPP
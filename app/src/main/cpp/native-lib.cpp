@@ -28,6 +28,11 @@
 #include "native-lib.hpp"
 #include "drawer.hpp"
 #include "dice.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "diceDistribution.hpp"
+#include "packedDice.hpp"
+#include "atlasCache.hpp"
 
 void handleJNIException(JNIEnv *env) {
     if (env->ExceptionCheck()) {
@@ -36,240 +41,148 @@ void handleJNIException(JNIEnv *env) {
     }
 }
 
-std::pair<std::vector<std::shared_ptr<DiceDescription>>, std::shared_ptr<TextureAtlas>> initDice(
-        JNIEnv *env,
-        jobjectArray jDiceConfigs,
-        jobjectArray jSymbols,
-        jint width,
-        jint height,
-        jfloatArray jArrayTextureCoordsLeft,
-        jfloatArray jArrayTextureCoordsRight,
-        jfloatArray jArrayTextureCoordsTop,
-        jfloatArray jArrayTextureCoordsBottom,
-        jbyteArray jbitmap) {
-
-    // delete all JNI local references that get allocated in a loop to avoid using them up.  We don't
-    // need to be too careful because the references will be freed at the end of the JNI call and
-    // JNI calls calling this function are not long lived.
-    auto deleter = [env](jobject localRefRaw) {
-        env->DeleteLocalRef(localRefRaw);
-    };
+namespace {
+    JNICache g_jniCache = {};
 
-    std::vector<std::string> symbols;
-    size_t nbrSymbols = static_cast<size_t>(env->GetArrayLength(jSymbols));
-    handleJNIException(env);
-    for (int i = 0; i < nbrSymbols; i++) {
-        std::shared_ptr<_jstring> obj((jstring)env->GetObjectArrayElement(jSymbols, i), deleter);
-        handleJNIException(env);
-        char const *csymbol = env->GetStringUTFChars(obj.get(), 0);
-        handleJNIException(env);
-        std::string symbol(csymbol);
-        env->ReleaseStringUTFChars(obj.get(), csymbol);
+    jclass globalClass(JNIEnv *env, char const *name) {
+        jclass localClass = env->FindClass(name);
         handleJNIException(env);
-        symbols.push_back(symbol);
-    }
-
-    // get the texture data
-    jbyte *bytes = env->GetByteArrayElements(jbitmap, nullptr);
-    handleJNIException(env);
-    size_t bitmapSize = static_cast<size_t>(env->GetArrayLength(jbitmap));
-    handleJNIException(env);
-    auto bitmap = std::make_unique<unsigned char[]>(bitmapSize);
-    memcpy(bitmap.get(), bytes, bitmapSize);
-    env->ReleaseByteArrayElements(jbitmap, bytes, JNI_ABORT);
-    handleJNIException(env);
-
-    std::vector<std::pair<float, float>> textureCoordsTopBottom;
-    jfloat *jTextureCoordsBottom = env->GetFloatArrayElements(jArrayTextureCoordsBottom, nullptr);
-    handleJNIException(env);
-    jfloat *jTextureCoordsTop = env->GetFloatArrayElements(jArrayTextureCoordsTop, nullptr);
-    handleJNIException(env);
-    for (int i = 0; i < nbrSymbols; i++) {
-        textureCoordsTopBottom.push_back(std::make_pair(jTextureCoordsTop[i], jTextureCoordsBottom[i]));
-    }
-    env->ReleaseFloatArrayElements(jArrayTextureCoordsTop, jTextureCoordsTop, JNI_ABORT);
-    handleJNIException(env);
-    env->ReleaseFloatArrayElements(jArrayTextureCoordsBottom, jTextureCoordsBottom, JNI_ABORT);
-    handleJNIException(env);
-
-    std::vector<std::pair<float, float>> textureCoordsLeftRight;
-    jfloat *jTextureCoordsLeft = env->GetFloatArrayElements(jArrayTextureCoordsLeft, nullptr);
-    handleJNIException(env);
-    jfloat *jTextureCoordsRight = env->GetFloatArrayElements(jArrayTextureCoordsRight, nullptr);
-    handleJNIException(env);
-    for (int i = 0; i < nbrSymbols; i++) {
-        textureCoordsLeftRight.push_back(std::make_pair(jTextureCoordsLeft[i], jTextureCoordsRight[i]));
-    }
-    env->ReleaseFloatArrayElements(jArrayTextureCoordsLeft, jTextureCoordsLeft, JNI_ABORT);
-    handleJNIException(env);
-    env->ReleaseFloatArrayElements(jArrayTextureCoordsRight, jTextureCoordsRight, JNI_ABORT);
-    handleJNIException(env);
-
-    auto texture = std::make_shared<TextureAtlas>(symbols, width, height, textureCoordsLeftRight,
-            textureCoordsTopBottom, std::move(bitmap), bitmapSize);
-
-    // Load the models.
-    jclass jintegerclass = env->FindClass("java/lang/Integer");
-    handleJNIException(env);
-    jint nbrDiceConfigs = env->GetArrayLength(jDiceConfigs);
-    handleJNIException(env);
-    std::vector<std::shared_ptr<DiceDescription>> dice;
-    for (int i = 0; i < nbrDiceConfigs; i++) {
-        std::shared_ptr<_jobject> obj(env->GetObjectArrayElement(jDiceConfigs, i), deleter);
-        handleJNIException(env);
-        std::shared_ptr<_jclass> diceConfigClass(env->GetObjectClass(obj.get()), deleter);
-        handleJNIException(env);
-
-        // number of symbols and values to expect
-        jmethodID mid = env->GetMethodID(diceConfigClass.get(), "getNumberOfSides", "()I");
-        handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
+        if (localClass == nullptr) {
+            throw std::runtime_error(std::string("Could not find class: ") + name);
         }
-        jint nbrSides = env->CallIntMethod(obj.get(), mid);
-
-        // symbols
-        std::vector<std::string> symbolsDiceVector;
-        mid = env->GetMethodID(diceConfigClass.get(), "getSymbolsString", "(I)Ljava/lang/String;");
-        handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
+        auto globalClass = static_cast<jclass>(env->NewGlobalRef(localClass));
+        env->DeleteLocalRef(localClass);
+        if (globalClass == nullptr) {
+            throw std::runtime_error(std::string("Could not reference class: ") + name);
         }
+        return globalClass;
+    }
 
-        for (int j = 0; j < nbrSides; j++) {
-            std::shared_ptr<_jstring> jSymbolsDice((jstring) env->CallObjectMethod(obj.get(), mid, j), deleter);
-            handleJNIException(env);
-            char const *cSymbolsDice = env->GetStringUTFChars(jSymbolsDice.get(), 0);
-            handleJNIException(env);
-            std::string symbolsDice(cSymbolsDice);
-            env->ReleaseStringUTFChars(jSymbolsDice.get(), cSymbolsDice);
-            handleJNIException(env);
-
-            symbolsDiceVector.push_back(symbolsDice);
-        }
-
-        // Get the values that the symbols correspond to. We will need these to rebuild the dice
-        // config when the roll is done so that the java GUI can display the result, save it to the
-        // log file, etc.
-        std::vector<std::shared_ptr<int32_t>> values;
-        mid = env->GetMethodID(diceConfigClass.get(), "getValues", "([Ljava/lang/Integer;)V");
-        handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
-        }
-
-        std::shared_ptr<_jobjectArray> jvalueArray(env->NewObjectArray(nbrSides, jintegerclass, nullptr), deleter);
-        handleJNIException(env);
-        env->CallVoidMethod(obj.get(), mid, jvalueArray.get());
-        handleJNIException(env);
-
-        mid = env->GetMethodID(jintegerclass, "intValue", "()I");
-        handleJNIException(env);
-        for (int j = 0; j < nbrSides; j++) {
-            std::shared_ptr<_jobject> jvalue(env->GetObjectArrayElement(jvalueArray.get(), j), deleter);
-            handleJNIException(env);
-            if (jvalue != nullptr) {
-                int32_t value = env->CallIntMethod(jvalue.get(), mid);
-                handleJNIException(env);
-                values.push_back(std::make_shared<int32_t>(value));
-            } else {
-                values.push_back(std::shared_ptr<int32_t>());
-            }
-        }
-
-        // get the number of dice
-        mid = env->GetMethodID(diceConfigClass.get(), "getNumberOfDice", "()I");
-        handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
-        }
-        jint nbrDice = env->CallIntMethod(obj.get(), mid);
-
-        // get reroll indices (into symbols vector
-        mid = env->GetMethodID(diceConfigClass.get(), "getNbrIndicesReRollOn", "()I");
+    jmethodID methodID(JNIEnv *env, jclass cls, char const *name, char const *signature) {
+        jmethodID mid = env->GetMethodID(cls, name, signature);
         handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
+        if (mid == nullptr) {
+            throw std::runtime_error(std::string("Could not find method: ") + name);
         }
-        jint nbrIndicesRerollOn = env->CallIntMethod(obj.get(), mid);
-        handleJNIException(env);
-
-        std::vector<uint32_t> indicesRerollOn;
+        return mid;
+    }
 
-        if (nbrIndicesRerollOn > 0) {
-            std::shared_ptr<_jintArray> jarrayindicesRerollOn(env->NewIntArray(nbrIndicesRerollOn), deleter);
-            handleJNIException(env);
+    void initJNICache(JNIEnv *env) {
+        JNICache &ids = g_jniCache;
+
+        ids.diceResultClass = globalClass(env, "com/quasar/cerulean/rainbowdice/DiceResult");
+        ids.diceResultGetNbrResults = methodID(env, ids.diceResultClass, "getNbrResults", "()I");
+        ids.diceResultGetNbrResultsForDie = methodID(env, ids.diceResultClass,
+                "geNbrResultsForDie", "(I)I");
+        ids.diceResultGetResultsForDie = methodID(env, ids.diceResultClass,
+                "getResultsForDie", "(I[I)V");
+        ids.diceResultIsModifiedRoll = methodID(env, ids.diceResultClass, "isModifiedRoll", "()Z");
+
+        ids.returnChannelClass = globalClass(env,
+                "com/quasar/cerulean/rainbowdice/DiceDrawerReturnChannel");
+        ids.returnChannelResultBuffer = methodID(env, ids.returnChannelClass, "resultBuffer",
+                "(I)Ljava/nio/ByteBuffer;");
+        ids.returnChannelSendResults = methodID(env, ids.returnChannelClass, "sendResults",
+                "(Ljava/lang/String;IZ[B)V");
+        ids.returnChannelSendSettledDice = methodID(env, ids.returnChannelClass, "sendSettledDice",
+                "(IZ)V");
+        ids.returnChannelSendError = methodID(env, ids.returnChannelClass, "sendError",
+                "(Ljava/lang/String;)V");
+        ids.returnChannelSendGraphicsDescription = methodID(env, ids.returnChannelClass,
+                "sendGraphicsDescription",
+                "(ZZZZLjava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
+        ids.returnChannelSendSelected = methodID(env, ids.returnChannelClass, "sendSelected", "(Z)V");
+    }
+} /* namespace */
 
-            mid = env->GetMethodID(diceConfigClass.get(), "getReRollOn", "([I)V");
-            handleJNIException(env);
-            if (mid == 0) {
-                throw std::runtime_error("Could not load dice models");
-            }
-            env->CallVoidMethod(obj.get(), mid, jarrayindicesRerollOn.get());
-            handleJNIException(env);
+JNICache const &jniCache() {
+    return g_jniCache;
+}
 
-            jint *jindicesRerollOn = env->GetIntArrayElements(jarrayindicesRerollOn.get(), nullptr);
-            handleJNIException(env);
-            for (int i = 0; i < nbrIndicesRerollOn; i++) {
-                indicesRerollOn.push_back(jindicesRerollOn[i]);
-            }
+/* Looks up the Java classes and methods the native code uses once, when the library is loaded,
+ * instead of on every call.  The class loader of the app is only available here and on threads
+ * that Java called into.
+ */
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
 
-            // we don't want to copy back changes to the array so use JNI_ABORT mode.
-            env->ReleaseIntArrayElements(jarrayindicesRerollOn.get(), jindicesRerollOn, JNI_ABORT);
-            handleJNIException(env);
-        }
+    try {
+        initJNICache(env);
+    } catch (std::runtime_error &e) {
+        return JNI_ERR;
+    }
 
-        // color
-        mid = env->GetMethodID(diceConfigClass.get(), "isRainbow", "()Z");
-        handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
-        }
-        jboolean rainbow = env->CallBooleanMethod(obj.get(), mid);
-        handleJNIException(env);
+    return JNI_VERSION_1_6;
+}
 
-        std::vector<float> color;
-        if (!rainbow) {
-            mid = env->GetMethodID(diceConfigClass.get(), "getColor", "([F)Z");
-            handleJNIException(env);
-            if (mid == 0) {
-                throw std::runtime_error("Could not load dice models");
-            }
+/* Unpacks the dice configurations and texture layout that Java packed into a direct ByteBuffer
+ * (see packedDice.hpp) without any further calls into Java.
+ */
+PackedDiceSet unpackDiceSet(JNIEnv *env, jobject jPackedDice) {
+    auto data = static_cast<uint8_t const *>(env->GetDirectBufferAddress(jPackedDice));
+    jlong size = env->GetDirectBufferCapacity(jPackedDice);
+    handleJNIException(env);
+    if (data == nullptr || size < 0) {
+        throw std::runtime_error("The dice configuration must be in a direct ByteBuffer.");
+    }
 
-            // the color is always 4 floats long
-            std::shared_ptr<_jfloatArray> jarrayColor(env->NewFloatArray(4), deleter);
-            handleJNIException(env);
+    return PackedDiceSet::unpack(data, static_cast<size_t>(size));
+}
 
-            jboolean result = env->CallBooleanMethod(obj.get(), mid, jarrayColor.get());
-            handleJNIException(env);
-            if (result) {
-                jfloat *jcolor = env->GetFloatArrayElements(jarrayColor.get(), nullptr);
-                handleJNIException(env);
-                for (int i = 0; i < 4; i++) {
-                    color.push_back(jcolor[i]);
-                }
-
-                // we don't want to copy back changes to the array so use JNI_ABORT mode.
-                env->ReleaseFloatArrayElements(jarrayColor.get(), jcolor, JNI_ABORT);
-                handleJNIException(env);
-            }
-        }
+/* atlasKey: identifies the texture atlas in the atlas cache (see atlasCache.hpp).
+ * jbitmap: the rasterized atlas, or null if Java found the atlas in the cache (hasCachedAtlas).
+ * In that case the texture layout in jPackedDice is empty.
+ */
+std::pair<std::vector<std::shared_ptr<DiceDescription>>, std::shared_ptr<TextureAtlas>> initDice(
+        JNIEnv *env,
+        jobject jPackedDice,
+        jlong atlasKey,
+        jbyteArray jbitmap) {
+    PackedDiceSet diceSet = unpackDiceSet(env, jPackedDice);
 
-        // Is this dice config being added or subtracted?
-        mid = env->GetMethodID(diceConfigClass.get(), "isAddOperation", "()Z");
-        handleJNIException(env);
-        if (mid == 0) {
-            throw std::runtime_error("Could not load dice models");
+    if (jbitmap == nullptr) {
+        std::shared_ptr<TextureAtlas> texture = atlasCache().find(static_cast<uint64_t>(atlasKey));
+        if (texture == nullptr) {
+            throw std::runtime_error("The texture atlas is no longer cached.");
         }
+        return std::make_pair(std::move(diceSet.m_dice), texture);
+    }
 
-        bool isAddOperation = env->CallBooleanMethod(obj.get(), mid);
-        handleJNIException(env);
+    // get the texture data.  It is RGBA, so it has to hold exactly 4 bytes for each texel of the
+    // texture dimensions in jPackedDice (which unpack already bounded).
+    size_t bitmapSize = static_cast<size_t>(env->GetArrayLength(jbitmap));
+    handleJNIException(env);
+    uint64_t expectedSize = static_cast<uint64_t>(diceSet.m_textureWidth) *
+            static_cast<uint64_t>(diceSet.m_textureHeight) * 4;
+    if (diceSet.m_textureWidth == 0 || diceSet.m_textureHeight == 0 || bitmapSize != expectedSize) {
+        throw std::runtime_error("The texture atlas bitmap does not match its dimensions.");
+    }
+    jbyte *bytes = env->GetByteArrayElements(jbitmap, nullptr);
+    handleJNIException(env);
+    auto bitmap = std::make_unique<unsigned char[]>(bitmapSize);
+    memcpy(bitmap.get(), bytes, bitmapSize);
+    env->ReleaseByteArrayElements(jbitmap, bytes, JNI_ABORT);
+    handleJNIException(env);
 
-        dice.push_back(std::make_shared<DiceDescription>(static_cast<uint32_t>(nbrDice),
-                symbolsDiceVector, values, color, indicesRerollOn, isAddOperation));
+    size_t nbrSymbols = diceSet.m_symbols.size();
+    std::vector<std::pair<float, float>> textureCoordsTopBottom;
+    std::vector<std::pair<float, float>> textureCoordsLeftRight;
+    for (size_t i = 0; i < nbrSymbols; i++) {
+        textureCoordsTopBottom.push_back(std::make_pair(diceSet.m_textureCoordTop[i],
+                diceSet.m_textureCoordBottom[i]));
+        textureCoordsLeftRight.push_back(std::make_pair(diceSet.m_textureCoordLeft[i],
+                diceSet.m_textureCoordRight[i]));
     }
 
-    return std::make_pair(dice, texture);
+    auto texture = std::make_shared<TextureAtlas>(diceSet.m_symbols, diceSet.m_textureWidth,
+            diceSet.m_textureHeight, textureCoordsLeftRight, textureCoordsTopBottom,
+            std::move(bitmap), bitmapSize);
+    atlasCache().add(static_cast<uint64_t>(atlasKey), texture);
+
+    return std::make_pair(std::move(diceSet.m_dice), texture);
 }
 
 std::vector<std::vector<uint32_t>> initResults(JNIEnv *env, jobject jDiceResults,
@@ -284,23 +197,11 @@ std::vector<std::vector<uint32_t>> initResults(JNIEnv *env, jobject jDiceResults
 
     std::vector<std::vector<uint32_t>> diceResults;
 
-    jclass diceResultsClass = env->GetObjectClass(jDiceResults);
-    handleJNIException(env);
-    jmethodID mid = env->GetMethodID(diceResultsClass, "getNbrResults", "()I");
-    handleJNIException(env);
-    if (mid == 0) {
-        throw std::runtime_error("Could not load dice results");
-    }
-    uint32_t nbrResults = env->CallIntMethod(jDiceResults, mid);
-    handleJNIException(env);
-
-    jmethodID midNbrResultsForDie = env->GetMethodID(diceResultsClass,"geNbrResultsForDie", "(I)I");
-    handleJNIException(env);
-    jmethodID midResultsForDie = env->GetMethodID(diceResultsClass, "getResultsForDie", "(I[I)V");
+    JNICache const &ids = jniCache();
+    uint32_t nbrResults = env->CallIntMethod(jDiceResults, ids.diceResultGetNbrResults);
     handleJNIException(env);
-    if (midNbrResultsForDie == 0 || midResultsForDie == 0) {
-        throw std::runtime_error("Could not load dice results");
-    }
+    jmethodID midNbrResultsForDie = ids.diceResultGetNbrResultsForDie;
+    jmethodID midResultsForDie = ids.diceResultGetResultsForDie;
 
     int j = 0;
     int k = 1;
@@ -345,25 +246,48 @@ std::vector<std::vector<uint32_t>> initResults(JNIEnv *env, jobject jDiceResults
 }
 
 
+/* Returns true if the atlas with the key is in the atlas cache.  It is then kept in memory so that
+ * the rollDice or drawStoppedDice call that follows can be made without the bitmap.
+ */
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_quasar_cerulean_rainbowdice_Draw_hasCachedAtlas(
+        JNIEnv *env,
+        jclass jclass1,
+        jlong atlasKey) {
+    try {
+        return atlasCache().find(static_cast<uint64_t>(atlasKey)) != nullptr ? JNI_TRUE : JNI_FALSE;
+    } catch (std::runtime_error &e) {
+        return JNI_FALSE;
+    }
+}
+
 extern "C" JNIEXPORT jstring JNICALL
 Java_com_quasar_cerulean_rainbowdice_Draw_rollDice(
         JNIEnv *env,
         jclass jclass1,
         jstring jdiceName,
-        jobjectArray jDiceConfigs,
-        jobjectArray jSymbols,
-        jint width,
-        jint height,
-        jfloatArray textureCoordLeft,
-        jfloatArray textureCoordRight,
-        jfloatArray textureCoordTop,
-        jfloatArray textureCoordBottom,
-        jbyteArray jbitmap) {
+        jint configurationId,
+        jobject jPackedDice,
+        jlong atlasKey,
+        jbyteArray jbitmap,
+        jbyteArray jseed) {
 
     try {
         std::pair<std::vector<std::shared_ptr<DiceDescription>>, std::shared_ptr<TextureAtlas>> dice =
-                initDice(env, jDiceConfigs, jSymbols, width, height, textureCoordLeft, textureCoordRight,
-                         textureCoordTop, textureCoordBottom, jbitmap);
+                initDice(env, jPackedDice, atlasKey, jbitmap);
+
+        // the seed is optional, a new one is chosen if it is null.
+        std::unique_ptr<RandomSeed> seed;
+        if (jseed != nullptr) {
+            jsize seedLength = env->GetArrayLength(jseed);
+            handleJNIException(env);
+            if (seedLength != static_cast<jsize>(sizeof (RandomSeed))) {
+                throw std::runtime_error("The roll seed must be 32 bytes long.");
+            }
+            seed = std::make_unique<RandomSeed>();
+            env->GetByteArrayRegion(jseed, 0, seedLength, reinterpret_cast<jbyte *>(seed->data()));
+            handleJNIException(env);
+        }
 
         const char *cdiceName = env->GetStringUTFChars(jdiceName, nullptr);
         handleJNIException(env);
@@ -371,7 +295,9 @@ Java_com_quasar_cerulean_rainbowdice_Draw_rollDice(
         env->ReleaseStringUTFChars(jdiceName, cdiceName);
         handleJNIException(env);
 
-        auto event = std::make_shared<DiceChangeEvent>(diceName, std::move(dice.first), dice.second);
+        auto event = std::make_shared<DiceChangeEvent>(diceName, configurationId,
+                                                       std::move(dice.first), dice.second,
+                                                       seed.get());
 
         diceChannel().sendEvent(event);
         jstring str = env->NewStringUTF("");
@@ -400,8 +326,7 @@ Java_com_quasar_cerulean_rainbowdice_Draw_tellDrawerSurfaceChanged(
         jint width,
         jint height) {
     try {
-        auto event = std::make_shared<SurfaceChangedEvent>(width, height);
-        diceChannel().sendEvent(event);
+        diceChannel().sendSurfaceChanged(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
         jstring str = env->NewStringUTF("");
         handleJNIException(env);
         return str;
@@ -419,15 +344,10 @@ Java_com_quasar_cerulean_rainbowdice_Draw_drawStoppedDice(
         JNIEnv *env,
         jclass jclass1,
         jstring jdiceName,
-        jobjectArray jDiceConfigs,
+        jint configurationId,
+        jobject jPackedDice,
         jobject jDiceResults,
-        jobjectArray jSymbols,
-        jint width,
-        jint height,
-        jfloatArray textureCoordLeft,
-        jfloatArray textureCoordRight,
-        jfloatArray textureCoordTop,
-        jfloatArray textureCoordBottom,
+        jlong atlasKey,
         jbyteArray jbitmap)
 {
     try {
@@ -437,25 +357,15 @@ Java_com_quasar_cerulean_rainbowdice_Draw_drawStoppedDice(
         env->ReleaseStringUTFChars(jdiceName, cdiceName);
         handleJNIException(env);
 
-        jclass diceResultsClass = env->GetObjectClass(jDiceResults);
-        handleJNIException(env);
-        jmethodID mid = env->GetMethodID(diceResultsClass, "isModifiedRoll", "()Z");
-        handleJNIException(env);
-        if (mid == 0) {
-            return env->NewStringUTF("Could not load dice results");
-        }
-        bool isModifiedRoll = env->CallBooleanMethod(jDiceResults, mid);
+        bool isModifiedRoll = env->CallBooleanMethod(jDiceResults, jniCache().diceResultIsModifiedRoll);
         handleJNIException(env);
 
         std::pair<std::vector<std::shared_ptr<DiceDescription>>, std::shared_ptr<TextureAtlas>> dice =
-                initDice(env, jDiceConfigs,
-                         jSymbols, width, height, textureCoordLeft,
-                         textureCoordRight, textureCoordTop,
-                         textureCoordBottom, jbitmap);
+                initDice(env, jPackedDice, atlasKey, jbitmap);
         std::vector<std::vector<uint32_t>> upFaceIndices = std::move(initResults(env, jDiceResults,
                 dice.first));
         std::shared_ptr<DrawEvent> event = std::make_shared<DrawStoppedDiceEvent>(std::move(diceName),
-                std::move(dice.first), dice.second, std::move(upFaceIndices), isModifiedRoll);
+                configurationId, std::move(dice.first), dice.second, std::move(upFaceIndices), isModifiedRoll);
         diceChannel().sendEvent(event);
         return env->NewStringUTF("");
     } catch (std::runtime_error &e) {
@@ -469,8 +379,7 @@ Java_com_quasar_cerulean_rainbowdice_Draw_scroll(
         jclass jclass1,
         jfloat distanceX,
         jfloat distanceY) {
-    auto event = std::make_shared<ScrollEvent>(distanceX, distanceY);
-    diceChannel().sendEvent(event);
+    diceChannel().sendScroll(distanceX, distanceY);
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -478,8 +387,7 @@ Java_com_quasar_cerulean_rainbowdice_Draw_scale(
         JNIEnv *env,
         jclass jclass1,
         jfloat scaleFactor) {
-    auto event = std::make_shared<ScaleEvent>(scaleFactor);
-    diceChannel().sendEvent(event);
+    diceChannel().sendScale(scaleFactor);
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -488,36 +396,121 @@ Java_com_quasar_cerulean_rainbowdice_Draw_tapDice(
         jclass jclass1,
         jfloat x,
         jfloat y) {
-    auto event = std::make_shared<TapDiceEvent>(x, y);
-    diceChannel().sendEvent(event);
+    diceChannel().sendTapDice(x, y);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_com_quasar_cerulean_rainbowdice_Draw_rerollSelected(
         JNIEnv *env,
         jclass jclass1) {
-    diceChannel().sendEvent(std::make_shared<RerollSelected>());
+    diceChannel().sendEvent(DrawEvent::rerollSelected);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_com_quasar_cerulean_rainbowdice_Draw_addRerollSelected(
         JNIEnv *env,
         jclass jclass1) {
-    diceChannel().sendEvent(std::make_shared<AddRerollSelected>());
+    diceChannel().sendEvent(DrawEvent::addRerollSelected);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_com_quasar_cerulean_rainbowdice_Draw_deleteSelected(
         JNIEnv *env,
         jclass jclass1) {
-    diceChannel().sendEvent(std::make_shared<DeleteSelected>());
+    diceChannel().sendEvent(DrawEvent::deleteSelected);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_com_quasar_cerulean_rainbowdice_Draw_resetView(
         JNIEnv *env,
         jclass jclass1) {
-    diceChannel().sendEvent(std::make_shared<ResetView>());
+    diceChannel().sendEvent(DrawEvent::resetView);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_quasar_cerulean_rainbowdice_Draw_setTracing(
+        JNIEnv *env,
+        jclass jclass1,
+        jboolean jenable) {
+    trace::setEnabled(jenable == JNI_TRUE);
+}
+
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_quasar_cerulean_rainbowdice_Draw_dumpTrace(
+        JNIEnv *env,
+        jclass jclass1,
+        jstring jpath) {
+#ifdef CQ_ENABLE_TRACING
+    try {
+        const char *cpath = env->GetStringUTFChars(jpath, nullptr);
+        handleJNIException(env);
+        std::string path(cpath);
+        env->ReleaseStringUTFChars(jpath, cpath);
+        handleJNIException(env);
+
+        trace::dumpChromeJson(path);
+        return env->NewStringUTF("");
+    } catch (std::runtime_error &e) {
+        return env->NewStringUTF((std::string("error: ") + e.what()).c_str());
+    }
+#else
+    return env->NewStringUTF("error: tracing is not enabled in this build.");
+#endif
+}
+
+extern "C" JNIEXPORT jlongArray JNICALL
+Java_com_quasar_cerulean_rainbowdice_Draw_getMetrics(
+        JNIEnv *env,
+        jclass jclass1) {
+    std::vector<int64_t> values = metrics::registry().snapshot();
+    jlongArray jvalues = env->NewLongArray(static_cast<jsize>(values.size()));
+    if (jvalues == nullptr) {
+        return nullptr;
+    }
+    static_assert(sizeof (jlong) == sizeof (int64_t), "jlong must be 64 bits");
+    env->SetLongArrayRegion(jvalues, 0, static_cast<jsize>(values.size()),
+                            reinterpret_cast<jlong const *>(values.data()));
+    return jvalues;
+}
+
+extern "C" JNIEXPORT jdoubleArray JNICALL
+Java_com_quasar_cerulean_rainbowdice_Draw_diceDistribution(
+        JNIEnv *env,
+        jclass jclass1,
+        jobject jPackedDice) {
+    try {
+        std::shared_ptr<DiceDistribution const> distribution =
+                DiceDistribution::forDice(unpackDiceSet(env, jPackedDice).m_dice);
+
+        // the pmf and the cdf can each hold up to DiceDistribution::m_maxSize doubles, so they go
+        // straight into the Java array instead of through another copy.
+        jsize nbrTotals = static_cast<jsize>(distribution->pmf().size());
+        auto percentiles = distribution->percentiles();
+        std::vector<double> header{static_cast<double>(distribution->minTotal()),
+                                   static_cast<double>(nbrTotals)};
+        std::vector<double> trailer{static_cast<double>(percentiles.size())};
+        for (auto const &percentile : percentiles) {
+            trailer.push_back(percentile.first);
+            trailer.push_back(static_cast<double>(percentile.second));
+        }
+
+        jsize trailerStart = static_cast<jsize>(header.size()) + 2 * nbrTotals;
+        jdoubleArray jvalues = env->NewDoubleArray(trailerStart + static_cast<jsize>(trailer.size()));
+        handleJNIException(env);
+        env->SetDoubleArrayRegion(jvalues, 0, static_cast<jsize>(header.size()), header.data());
+        env->SetDoubleArrayRegion(jvalues, static_cast<jsize>(header.size()), nbrTotals,
+                                  distribution->pmf().data());
+        env->SetDoubleArrayRegion(jvalues, static_cast<jsize>(header.size()) + nbrTotals, nbrTotals,
+                                  distribution->cdf().data());
+        env->SetDoubleArrayRegion(jvalues, trailerStart, static_cast<jsize>(trailer.size()),
+                                  trailer.data());
+        handleJNIException(env);
+        return jvalues;
+    } catch (std::exception &e) {
+        // std::bad_alloc included: a large enough set of dice can exhaust memory before it
+        // reaches the size limit of the distribution.
+        return nullptr;
+    }
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -526,11 +519,13 @@ Java_com_quasar_cerulean_rainbowdice_DiceWorker_startWorker(
         jobject jthis,
         jobject jsurface,
         jobject jmanager,
+        jstring jcacheDir,
         jobject jnotify,
         jboolean juseGravity,
         jboolean jdrawRollingDice,
         jboolean juseLegacy,
-        jboolean jreverseGravity) {
+        jboolean jreverseGravity,
+        jfloat jrefreshRate) {
 
     std::shared_ptr<Notify> notify;
     try {
@@ -542,6 +537,13 @@ Java_com_quasar_cerulean_rainbowdice_DiceWorker_startWorker(
     try {
         setAssetManager(AAssetManager_fromJava(env, jmanager));
 
+        const char *ccacheDir = env->GetStringUTFChars(jcacheDir, nullptr);
+        handleJNIException(env);
+        setCacheDirectory(std::string(ccacheDir));
+        atlasCache().setDirectory(cacheDirectory());
+        env->ReleaseStringUTFChars(jcacheDir, ccacheDir);
+        handleJNIException(env);
+
         ANativeWindow *window = ANativeWindow_fromSurface(env, jsurface);
         if (window == nullptr) {
             notify->sendError("Unable to acquire window from surface.");
@@ -557,7 +559,8 @@ Java_com_quasar_cerulean_rainbowdice_DiceWorker_startWorker(
         std::shared_ptr<WindowType> surface(window, deleter);
 
         //diceChannel().clearQueue();
-        DiceWorker worker(surface, notify, juseGravity, jdrawRollingDice, juseLegacy, jreverseGravity);
+        DiceWorker worker(surface, notify, juseGravity, jdrawRollingDice, juseLegacy, jreverseGravity,
+                          jrefreshRate);
         surface.reset();
         worker.waitingLoop();
     } catch (std::runtime_error &e) {
@@ -574,8 +577,9 @@ Java_com_quasar_cerulean_rainbowdice_DiceWorker_startWorker(
 void Notify::sendResult(
         std::string const &diceName,
         bool isModified,
+        int32_t configurationId,
         std::vector<std::vector<uint32_t>> const &results,
-        std::vector<std::shared_ptr<DiceDescription>> const &dice) {
+        RandomSeed const &seed) {
     /* all the jobject or derived from jobject (jstring, jclass, jintArray, etc) used in this
      * function must be released with DeleteLocalRef before this function returns.  The JVM/JNI
      * normally frees these, but only when the C++ function returns and exits back to java.  Since
@@ -587,123 +591,78 @@ void Notify::sendResult(
         env->DeleteLocalRef(localRefRaw);
     };
 
-    std::string totalResult;
-    std::shared_ptr<_jclass> notifyClass(m_env->GetObjectClass(m_notify), deleter);
-    handleJNIException(m_env);
+    JNICache const &ids = jniCache();
 
-    jmethodID midAddMultiResult = m_env->GetMethodID(notifyClass.get(), "addResult", "([I)V");
-    handleJNIException(m_env);
-    if (midAddMultiResult == nullptr) {
-        throw std::runtime_error("Could not send message.");
+    /* The results are written into a direct ByteBuffer that Java keeps between rolls as 32 bit
+     * ints in native byte order: the number of dice, then for each die the offset of its faces
+     * in the face array plus one offset past the end, then the faces (the symbol index of the
+     * face each die and its rerolls landed on).
+     */
+    size_t nbrFaces = 0;
+    for (auto const &result : results) {
+        nbrFaces += result.size();
     }
-
-    jmethodID midAddSingleResult = m_env->GetMethodID(notifyClass.get(), "addResult", "(I)V");
+    size_t nbrInts = 1 + results.size() + 1 + nbrFaces;
+    std::shared_ptr<_jobject> jresultBuffer(m_env->CallObjectMethod(m_notify,
+            ids.returnChannelResultBuffer, static_cast<jint>(nbrInts * sizeof (int32_t))), deleter);
     handleJNIException(m_env);
-    if (midAddSingleResult == nullptr) {
-        throw std::runtime_error("Could not send message.");
+    auto resultData = static_cast<int32_t *>(m_env->GetDirectBufferAddress(jresultBuffer.get()));
+    if (resultData == nullptr) {
+        throw std::runtime_error("The result buffer must be a direct ByteBuffer.");
     }
 
-    for (auto const &result : results) {
-        if (result.size() == 1) {
-            m_env->CallVoidMethod(m_notify, midAddSingleResult, result[0]);
-            handleJNIException(m_env);
-        } else {
-            std::shared_ptr<_jintArray> jresultsArray(m_env->NewIntArray(static_cast<jsize>(result.size())), deleter);
-            handleJNIException(m_env);
-            jint *jresults = m_env->GetIntArrayElements(jresultsArray.get(), nullptr);
-            handleJNIException(m_env);
-            int i = 0;
-            for (auto const &dieResult : result) {
-                jresults[i++] = dieResult;
-            }
-            m_env->ReleaseIntArrayElements(jresultsArray.get(), jresults, JNI_COMMIT);
-            handleJNIException(m_env);
-            m_env->CallVoidMethod(m_notify, midAddMultiResult, jresultsArray.get());
-            handleJNIException(m_env);
+    int32_t *offsets = resultData + 1;
+    int32_t *faces = offsets + results.size() + 1;
+    resultData[0] = static_cast<int32_t>(results.size());
+    int32_t offset = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        offsets[i] = offset;
+        for (auto face : results[i]) {
+            faces[offset++] = static_cast<int32_t>(face);
         }
     }
+    offsets[results.size()] = offset;
 
-    jmethodID midAddDice = m_env->GetMethodID(notifyClass.get(), "addDice",
-                                              "(I[Ljava/lang/String;[Ljava/lang/Integer;[I[FZ)V");
-    handleJNIException(m_env);
-    if (midAddDice == nullptr) {
-        throw std::runtime_error("Could not send message.");
-    }
-    std::shared_ptr<_jstring> emptyStr(m_env->NewStringUTF(""), deleter);
+    std::shared_ptr<_jbyteArray> jseed(m_env->NewByteArray(static_cast<jsize>(seed.size())), deleter);
     handleJNIException(m_env);
-    std::shared_ptr<_jclass> stringClass(m_env->FindClass("java/lang/String"), deleter);
+    m_env->SetByteArrayRegion(jseed.get(), 0, static_cast<jsize>(seed.size()),
+                              reinterpret_cast<jbyte const *>(seed.data()));
     handleJNIException(m_env);
-    std::shared_ptr<_jclass> jIntegerClass(m_env->FindClass("java/lang/Integer"), deleter);
+
+    std::shared_ptr<_jstring> jdiceName(m_env->NewStringUTF(diceName.c_str()), deleter);
+    m_env->CallVoidMethod(m_notify, ids.returnChannelSendResults, jdiceName.get(), configurationId,
+                          isModified, jseed.get());
     handleJNIException(m_env);
-    for (auto const &die : dice) {
-        std::shared_ptr<_jobjectArray> jsymbolArray(m_env->NewObjectArray(die->m_symbols.size(),
-                                                          stringClass.get(),
-                                                          emptyStr.get()), deleter);
-        handleJNIException(m_env);
-        int i = 0;
-        for (auto const &symbol : die->m_symbols) {
-            std::shared_ptr<_jstring> str(m_env->NewStringUTF(symbol.c_str()), deleter);
-            handleJNIException(m_env);
-            m_env->SetObjectArrayElement(jsymbolArray.get(), i++, str.get());
-            handleJNIException(m_env);
-        }
+}
 
-        std::shared_ptr<_jintArray> jrerollIndicesArray(m_env->NewIntArray(
-                static_cast<jsize>(die->m_rerollOnIndices.size())), deleter);
-        handleJNIException(m_env);
-        jint *jindices = m_env->GetIntArrayElements(jrerollIndicesArray.get(), nullptr);
-        handleJNIException(m_env);
-        i = 0;
-        for (auto const &rerollIndex : die->m_rerollOnIndices) {
-            jindices[i++] = rerollIndex;
-        }
-        m_env->ReleaseIntArrayElements(jrerollIndicesArray.get(), jindices, JNI_COMMIT);
-        handleJNIException(m_env);
-
-        std::shared_ptr<_jfloatArray> jcolorArray(
-                m_env->NewFloatArray(static_cast<jsize>(die->m_color.size())), deleter);
-        handleJNIException(m_env);
-        jfloat *jcolor = m_env->GetFloatArrayElements(jcolorArray.get(), nullptr);
-        handleJNIException(m_env);
-        i = 0;
-        for (auto const &colorValue : die->m_color) {
-            jcolor[i++] = colorValue;
-        }
-        m_env->ReleaseFloatArrayElements(jcolorArray.get(), jcolor, JNI_COMMIT);
-        handleJNIException(m_env);
-
-        jmethodID midIntegerInit = m_env->GetMethodID(jIntegerClass.get(), "<init>", "(I)V");
-        handleJNIException(m_env);
-        std::shared_ptr<_jobjectArray> jvalueArray(m_env->NewObjectArray(die->m_values.size(),
-                                                         jIntegerClass.get(),
-                                                         nullptr), deleter);
-        handleJNIException(m_env);
-        i = 0;
-        for (auto const &value : die->m_values) {
-            if (value != nullptr) {
-                std::shared_ptr<_jobject> obj(
-                        m_env->NewObject(jIntegerClass.get(), midIntegerInit, *value), deleter);
-                handleJNIException(m_env);
-                m_env->SetObjectArrayElement(jvalueArray.get(), i, obj.get());
-                handleJNIException(m_env);
-            }
-            i++;
-        }
+void Notify::sendSettledDice(int32_t configurationId, std::vector<SettledDie> const &settled,
+        bool isFirst) {
+    auto env = m_env;
+    auto deleter = [env](jobject localRefRaw) {
+        env->DeleteLocalRef(localRefRaw);
+    };
 
-        m_env->CallVoidMethod(m_notify, midAddDice, die->m_nbrDice, jsymbolArray.get(), jvalueArray.get(),
-                              jrerollIndicesArray.get(), jcolorArray.get(), die->m_isAddOperation);
-        handleJNIException(m_env);
-    }
+    JNICache const &ids = jniCache();
 
-    jmethodID midSend = m_env->GetMethodID(notifyClass.get(), "sendResults",
-                                           "(Ljava/lang/String;Z)V");
+    // written to the result buffer as ints: the number of dice, then group, index and result for
+    // each die.
+    size_t nbrInts = 1 + 3 * settled.size();
+    std::shared_ptr<_jobject> jresultBuffer(m_env->CallObjectMethod(m_notify,
+            ids.returnChannelResultBuffer, static_cast<jint>(nbrInts * sizeof (int32_t))), deleter);
     handleJNIException(m_env);
-    if (midSend == nullptr) {
-        throw std::runtime_error("Could not send message.");
+    auto resultData = static_cast<int32_t *>(m_env->GetDirectBufferAddress(jresultBuffer.get()));
+    if (resultData == nullptr) {
+        throw std::runtime_error("The result buffer must be a direct ByteBuffer.");
     }
 
-    std::shared_ptr<_jstring> jdiceName(m_env->NewStringUTF(diceName.c_str()), deleter);
-    m_env->CallVoidMethod(m_notify, midSend, jdiceName.get(), isModified);
+    *resultData++ = static_cast<int32_t>(settled.size());
+    for (auto const &die : settled) {
+        *resultData++ = static_cast<int32_t>(die.m_group);
+        *resultData++ = static_cast<int32_t>(die.m_index);
+        *resultData++ = static_cast<int32_t>(die.m_result);
+    }
+
+    m_env->CallVoidMethod(m_notify, ids.returnChannelSendSettledDice, configurationId, isFirst);
     handleJNIException(m_env);
 }
 
@@ -717,16 +676,8 @@ void Notify::sendError(char const *error) {
         env->DeleteLocalRef(localRefRaw);
     };
 
-    std::shared_ptr<_jclass> notifyClass(m_env->GetObjectClass(m_notify), deleter);
-
-    jmethodID midSend = m_env->GetMethodID(notifyClass.get(), "sendError", "(Ljava/lang/String;)V");
-    if (midSend == nullptr) {
-        // do not throw because we could already be in a section catching exceptions
-        return;
-    }
-
     std::shared_ptr<_jstring> jerror(m_env->NewStringUTF(error), deleter);
-    m_env->CallVoidMethod(m_notify, midSend, jerror.get());
+    m_env->CallVoidMethod(m_notify, jniCache().returnChannelSendError, jerror.get());
 }
 
 void Notify::sendGraphicsDescription(GraphicsDescription const &description,
@@ -737,28 +688,14 @@ void Notify::sendGraphicsDescription(GraphicsDescription const &description,
         env->DeleteLocalRef(localRefRaw);
     };
 
-    std::shared_ptr<_jclass> notifyClass(m_env->GetObjectClass(m_notify), deleter);
-
-    jmethodID midSend = m_env->GetMethodID(notifyClass.get(), "sendGraphicsDescription",
-            "(ZZZZLjava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
-    if (midSend == nullptr) {
-        throw std::runtime_error("Could not send graphics description message.");
-    }
-
     std::shared_ptr<_jstring> jgraphics(m_env->NewStringUTF(description.m_graphicsName.c_str()), deleter);
     std::shared_ptr<_jstring> jversion(m_env->NewStringUTF(description.m_version.c_str()), deleter);
     std::shared_ptr<_jstring> jdeviceName(m_env->NewStringUTF(description.m_deviceName.c_str()), deleter);
-    m_env->CallVoidMethod(m_notify, midSend, hasLinearAcceleration, hasGravity, hasAccelerometer,
+    m_env->CallVoidMethod(m_notify, jniCache().returnChannelSendGraphicsDescription,
+            hasLinearAcceleration, hasGravity, hasAccelerometer,
             description.m_isVulkan, jgraphics.get(), jversion.get(), jdeviceName.get());
 }
 
 void Notify::sendSelected(bool diceSelected) {
-    jclass notifyClass = m_env->GetObjectClass(m_notify);
-
-    jmethodID midSend = m_env->GetMethodID(notifyClass, "sendSelected", "(Z)V");
-    if (midSend == nullptr) {
-        throw std::runtime_error("Could not send dice selected message.");
-    }
-
-    m_env->CallVoidMethod(m_notify, midSend, diceSelected);
+    m_env->CallVoidMethod(m_notify, jniCache().returnChannelSendSelected, diceSelected);
 }
\ No newline at end of file
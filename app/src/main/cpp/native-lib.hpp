@@ -25,6 +25,28 @@
 #include <string>
 #include <jni.h>
 #include "diceDescription.hpp"
+#include "random.hpp"
+
+/* Global references to the Java classes and the method IDs that the native code uses.  Filled in
+ * by JNI_OnLoad and never changed after that, so it can be read from any thread.
+ */
+struct JNICache {
+    jclass diceResultClass;
+    jmethodID diceResultGetNbrResults;
+    jmethodID diceResultGetNbrResultsForDie;
+    jmethodID diceResultGetResultsForDie;
+    jmethodID diceResultIsModifiedRoll;
+
+    jclass returnChannelClass;
+    jmethodID returnChannelResultBuffer;
+    jmethodID returnChannelSendResults;
+    jmethodID returnChannelSendSettledDice;
+    jmethodID returnChannelSendError;
+    jmethodID returnChannelSendGraphicsDescription;
+    jmethodID returnChannelSendSelected;
+};
+
+JNICache const &jniCache();
 
 class Notify {
 private:
@@ -37,8 +59,11 @@ public:
     void sendResult(
             std::string const &diceName,
             bool isModified,
+            int32_t configurationId,
             std::vector<std::vector<uint32_t>> const &results,
-            std::vector<std::shared_ptr<DiceDescription>> const &dice);
+            RandomSeed const &seed);
+    void sendSettledDice(int32_t configurationId, std::vector<SettledDie> const &settled,
+            bool isFirst);
     void sendError(std::string const &error);
     void sendError(char const *error);
     void sendGraphicsDescription(GraphicsDescription const &description,
@@ -0,0 +1,267 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <cstring>
+#include <stdexcept>
+
+#include "packedDice.hpp"
+
+constexpr uint32_t PackedDiceSet::m_version;
+constexpr uint32_t PackedDiceSet::m_maxNbrDice;
+constexpr int32_t PackedDiceSet::m_maxTextureSize;
+
+namespace {
+    // Reads little endian values from a buffer, checking that each one is inside it.
+    class PackedReader {
+    public:
+        PackedReader(uint8_t const *data, size_t size)
+                : m_data{data},
+                  m_size{size},
+                  m_position{0}
+        {
+        }
+
+        uint8_t getUInt8() {
+            need(1);
+            return m_data[m_position++];
+        }
+
+        uint32_t getUInt32() {
+            need(4);
+            uint32_t value = static_cast<uint32_t>(m_data[m_position]) |
+                    static_cast<uint32_t>(m_data[m_position + 1]) << 8 |
+                    static_cast<uint32_t>(m_data[m_position + 2]) << 16 |
+                    static_cast<uint32_t>(m_data[m_position + 3]) << 24;
+            m_position += 4;
+            return value;
+        }
+
+        int32_t getInt32() {
+            uint32_t value = getUInt32();
+            int32_t result;
+            std::memcpy(&result, &value, sizeof (result));
+            return result;
+        }
+
+        float getFloat() {
+            uint32_t value = getUInt32();
+            float result;
+            std::memcpy(&result, &value, sizeof (result));
+            return result;
+        }
+
+        std::string getString() {
+            uint32_t length = getUInt32();
+            need(length);
+            std::string value(reinterpret_cast<char const *>(m_data + m_position), length);
+            m_position += length;
+            return value;
+        }
+
+        /* Reads a count of items that each take at least itemSize bytes, so that a corrupt count
+         * can not make the caller reserve more memory than the buffer could describe.
+         */
+        uint32_t getCount(size_t itemSize) {
+            uint32_t count = getUInt32();
+            if (itemSize > 0 && count > (m_size - m_position) / itemSize) {
+                throw std::runtime_error("Invalid dice configuration: count exceeds the data.");
+            }
+            return count;
+        }
+
+        std::vector<float> getFloats(uint32_t count) {
+            std::vector<float> values;
+            values.reserve(count);
+            for (uint32_t i = 0; i < count; i++) {
+                values.push_back(getFloat());
+            }
+            return values;
+        }
+
+        bool atEnd() { return m_position == m_size; }
+
+    private:
+        uint8_t const *m_data;
+        size_t m_size;
+        size_t m_position;
+
+        void need(size_t length) {
+            if (length > m_size - m_position) {
+                throw std::runtime_error("Invalid dice configuration: data ends early.");
+            }
+        }
+    };
+
+    class PackedWriter {
+    public:
+        PackedWriter() : m_data{} {}
+
+        void putUInt8(uint8_t value) { m_data.push_back(value); }
+
+        void putUInt32(uint32_t value) {
+            for (int i = 0; i < 4; i++) {
+                m_data.push_back(static_cast<uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        void putInt32(int32_t value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof (bits));
+            putUInt32(bits);
+        }
+
+        void putFloat(float value) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof (bits));
+            putUInt32(bits);
+        }
+
+        void putString(std::string const &value) {
+            putUInt32(static_cast<uint32_t>(value.size()));
+            m_data.insert(m_data.end(), value.begin(), value.end());
+        }
+
+        std::vector<uint8_t> &data() { return m_data; }
+
+    private:
+        std::vector<uint8_t> m_data;
+    };
+
+    // the smallest number of bytes a dice configuration or a side can be packed in.
+    size_t constexpr const minDiceConfigurationSize = 4 + 1 + 1 + 4 + 4;
+    size_t constexpr const minSideSize = 4 + 1 + 4;
+} /* namespace */
+
+PackedDiceSet PackedDiceSet::unpack(uint8_t const *data, size_t size) {
+    PackedReader reader(data, size);
+    if (reader.getUInt32() != m_version) {
+        throw std::runtime_error("Invalid dice configuration: unsupported version.");
+    }
+
+    PackedDiceSet set;
+    uint32_t nbrDiceConfigurations = reader.getCount(minDiceConfigurationSize);
+    for (uint32_t i = 0; i < nbrDiceConfigurations; i++) {
+        uint32_t nbrDice = reader.getUInt32();
+        if (nbrDice > m_maxNbrDice) {
+            throw std::runtime_error("Invalid dice configuration: too many dice.");
+        }
+        bool isAddOperation = reader.getUInt8() != 0;
+        bool hasColor = reader.getUInt8() != 0;
+        std::vector<float> color;
+        if (hasColor) {
+            color = reader.getFloats(4);
+        }
+
+        uint32_t nbrSides = reader.getCount(minSideSize);
+        if (nbrSides == 0) {
+            throw std::runtime_error("Invalid dice configuration: a die has no sides.");
+        }
+        std::vector<std::string> symbols;
+        std::vector<std::shared_ptr<int32_t>> values;
+        symbols.reserve(nbrSides);
+        values.reserve(nbrSides);
+        for (uint32_t j = 0; j < nbrSides; j++) {
+            symbols.push_back(reader.getString());
+            bool hasValue = reader.getUInt8() != 0;
+            int32_t value = reader.getInt32();
+            values.push_back(hasValue ? std::make_shared<int32_t>(value) : std::shared_ptr<int32_t>());
+        }
+
+        uint32_t nbrRerollOn = reader.getCount(4);
+        std::vector<uint32_t> rerollOnIndices;
+        rerollOnIndices.reserve(nbrRerollOn);
+        for (uint32_t j = 0; j < nbrRerollOn; j++) {
+            uint32_t index = reader.getUInt32();
+            if (index >= nbrSides) {
+                throw std::runtime_error("Invalid dice configuration: reroll index out of range.");
+            }
+            rerollOnIndices.push_back(index);
+        }
+
+        set.m_dice.push_back(std::make_shared<DiceDescription>(nbrDice, std::move(symbols),
+                std::move(values), std::move(color), std::move(rerollOnIndices), isAddOperation));
+    }
+
+    uint32_t nbrSymbols = reader.getCount(4);
+    set.m_symbols.reserve(nbrSymbols);
+    for (uint32_t i = 0; i < nbrSymbols; i++) {
+        set.m_symbols.push_back(reader.getString());
+    }
+    set.m_textureWidth = reader.getInt32();
+    set.m_textureHeight = reader.getInt32();
+    if (set.m_textureWidth < 0 || set.m_textureWidth > m_maxTextureSize ||
+        set.m_textureHeight < 0 || set.m_textureHeight > m_maxTextureSize) {
+        throw std::runtime_error("Invalid dice configuration: texture dimensions out of range.");
+    }
+    set.m_textureCoordLeft = reader.getFloats(nbrSymbols);
+    set.m_textureCoordRight = reader.getFloats(nbrSymbols);
+    set.m_textureCoordTop = reader.getFloats(nbrSymbols);
+    set.m_textureCoordBottom = reader.getFloats(nbrSymbols);
+
+    if (!reader.atEnd()) {
+        throw std::runtime_error("Invalid dice configuration: extra data at the end.");
+    }
+
+    return set;
+}
+
+std::vector<uint8_t> PackedDiceSet::pack() const {
+    PackedWriter writer;
+    writer.putUInt32(m_version);
+
+    writer.putUInt32(static_cast<uint32_t>(m_dice.size()));
+    for (auto const &die : m_dice) {
+        writer.putUInt32(die->m_nbrDice);
+        writer.putUInt8(die->m_isAddOperation ? 1 : 0);
+        writer.putUInt8(die->m_color.size() == 4 ? 1 : 0);
+        if (die->m_color.size() == 4) {
+            for (float component : die->m_color) {
+                writer.putFloat(component);
+            }
+        }
+
+        writer.putUInt32(static_cast<uint32_t>(die->m_symbols.size()));
+        for (size_t i = 0; i < die->m_symbols.size(); i++) {
+            writer.putString(die->m_symbols[i]);
+            bool hasValue = i < die->m_values.size() && die->m_values[i] != nullptr;
+            writer.putUInt8(hasValue ? 1 : 0);
+            writer.putInt32(hasValue ? *die->m_values[i] : 0);
+        }
+
+        writer.putUInt32(static_cast<uint32_t>(die->m_rerollOnIndices.size()));
+        for (uint32_t index : die->m_rerollOnIndices) {
+            writer.putUInt32(index);
+        }
+    }
+
+    writer.putUInt32(static_cast<uint32_t>(m_symbols.size()));
+    for (auto const &symbol : m_symbols) {
+        writer.putString(symbol);
+    }
+    writer.putInt32(m_textureWidth);
+    writer.putInt32(m_textureHeight);
+    for (auto const *coords : {&m_textureCoordLeft, &m_textureCoordRight, &m_textureCoordTop,
+                               &m_textureCoordBottom}) {
+        for (size_t i = 0; i < m_symbols.size(); i++) {
+            writer.putFloat(i < coords->size() ? (*coords)[i] : 0.0f);
+        }
+    }
+
+    return std::move(writer.data());
+}
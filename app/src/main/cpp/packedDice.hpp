@@ -0,0 +1,81 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_PACKED_DICE_HPP
+#define RAINBOWDICE_PACKED_DICE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "diceDescription.hpp"
+
+/* The dice configurations and texture layout of a roll as Java packs them into a direct
+ * ByteBuffer (PackedDiceConfiguration.java), so that they can be read without any JNI calls.
+ * Everything is little endian.  A string is a uint32 byte length followed by that many UTF-8
+ * bytes.
+ *
+ *   uint32 version (m_version)
+ *   uint32 nbrDiceConfigurations, then for each:
+ *       uint32 nbrDice, uint8 isAddOperation, uint8 hasColor, float32[4] color (if hasColor),
+ *       uint32 nbrSides, then for each side: string symbol, uint8 hasValue, int32 value,
+ *       uint32 nbrRerollOn, uint32[nbrRerollOn] rerollOnIndices
+ *   uint32 nbrSymbols, then for each: string symbol
+ *   int32 textureWidth, int32 textureHeight,
+ *   float32[nbrSymbols] left, float32[nbrSymbols] right, float32[nbrSymbols] top,
+ *   float32[nbrSymbols] bottom (the texture coordinates of each symbol)
+ */
+struct PackedDiceSet {
+    static uint32_t constexpr m_version = 1;
+
+    // the limits unpack enforces: a die count is used to size the roll results, and the texture
+    // dimensions to check the size of the atlas bitmap.
+    static uint32_t constexpr m_maxNbrDice = 1024;
+    static int32_t constexpr m_maxTextureSize = 16384;
+
+    std::vector<std::shared_ptr<DiceDescription>> m_dice;
+
+    std::vector<std::string> m_symbols;
+    int32_t m_textureWidth;
+    int32_t m_textureHeight;
+    std::vector<float> m_textureCoordLeft;
+    std::vector<float> m_textureCoordRight;
+    std::vector<float> m_textureCoordTop;
+    std::vector<float> m_textureCoordBottom;
+
+    PackedDiceSet()
+            : m_dice{},
+              m_symbols{},
+              m_textureWidth{0},
+              m_textureHeight{0},
+              m_textureCoordLeft{},
+              m_textureCoordRight{},
+              m_textureCoordTop{},
+              m_textureCoordBottom{}
+    {
+    }
+
+    // throws std::runtime_error if data is not a complete, valid dice set.
+    static PackedDiceSet unpack(uint8_t const *data, size_t size);
+
+    std::vector<uint8_t> pack() const;
+};
+
+#endif // RAINBOWDICE_PACKED_DICE_HPP
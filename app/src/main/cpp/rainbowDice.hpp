@@ -19,7 +19,11 @@
  */
 #ifndef RAINBOWDICE_HPP
 #define RAINBOWDICE_HPP
+#include <algorithm>
+#include <cmath>
+#include <iterator>
 #include <list>
+#include <map>
 #include <set>
 #include <vector>
 #include <chrono>
@@ -35,8 +39,15 @@
 
 #include "rainbowDiceGlobal.hpp"
 #include "diceDescription.hpp"
+#include "diceRoller.hpp"
 #include "dice.hpp"
 #include "text.hpp"
+#include "textureAtlasManager.hpp"
+#include "tripleBuffer.hpp"
+#include "groupedVector.hpp"
+#include "random.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 struct VertexSquareOutline {
     glm::vec3 pos;
@@ -69,6 +80,28 @@ public:
     glm::vec3 acceleration(glm::vec3 const &sensorInputs);
 };
 
+/* The state of the dice published by the simulation thread for the render thread.  The dice are
+ * in the same order as they are iterated over in RainbowDiceGraphics::m_dice.
+ */
+struct DiceSnapshot {
+    struct DieState {
+        glm::mat4 model;
+        bool isStopped;
+        bool hasResult;
+        uint32_t result;
+    };
+
+    std::vector<DieState> dice;
+    bool allStopped;
+    bool anyRolling;
+
+    DiceSnapshot()
+            : dice{},
+              allStopped{true},
+              anyRolling{false}
+    {}
+};
+
 template <typename GraphicsType>
 class DiceGraphics {
 public:
@@ -94,29 +127,74 @@ public:
 
     inline std::shared_ptr<DicePhysicsModel> const &die() { return m_die; }
     inline std::vector<uint32_t> const &rerollIndices() { return m_rerollIndices; }
+
+    // The state to draw the die with.  This is the latest snapshot published by the simulation
+    // thread if there is one, otherwise the state is read directly from the physics model.
+    inline glm::mat4 renderModel() {
+        return m_snapshotState != nullptr ? m_snapshotState->model : m_die->model();
+    }
+    inline bool renderIsStopped() {
+        return m_snapshotState != nullptr ? m_snapshotState->isStopped : m_die->isStopped();
+    }
+    inline bool renderHasResult() {
+        return m_snapshotState != nullptr ? m_snapshotState->hasResult : m_die->hasResult();
+    }
+    inline uint32_t renderResult() {
+        return m_snapshotState != nullptr ? m_snapshotState->result : m_die->getResult();
+    }
+    // the edge width goes with renderIsStopped so that it matches the state being drawn.
+    inline float renderEdgeWidth() {
+        return renderIsStopped() ? m_stoppedEdgeWidth : m_rollingEdgeWidth;
+    }
+    inline void setSnapshotState(DiceSnapshot::DieState const *state) { m_snapshotState = state; }
+
+    // whether the result the die settled on has been sent to java (see takeSettledDice).
+    inline bool isResultSent() { return m_resultSent; }
+    inline void setResultSent(bool resultSent) { m_resultSent = resultSent; }
+
     inline bool isSelected() { return m_isSelected; }
     inline size_t nbrIndices() { return m_die->getIndices().size(); }
+
+    // whether the texture coordinates of the model came from atlas.
+    inline bool usesTextureAtlas(std::shared_ptr<TextureAtlas> const &atlas) {
+        return m_textureAtlas.lock() == atlas;
+    }
     inline bool isGL() { return false; }
 
-    DiceGraphics(std::vector<std::string> const &symbols, std::vector<uint32_t> inRerollIndices,
+    DiceGraphics(SymbolIds const &symbols, std::vector<uint32_t> inRerollIndices,
                  std::vector<float> const &color,
                  std::shared_ptr<TextureAtlas> const &textureAtlas)
             : m_die{std::move(DicePhysicsModel::createDice(symbols, color))},
               m_rerollIndices{std::move(inRerollIndices)},
               m_isSelected{false},
+              m_snapshotState{nullptr},
+              m_resultSent{false},
+              m_textureAtlas{textureAtlas},
+              m_rollingEdgeWidth{m_die->rollingEdgeWidth()},
+              m_stoppedEdgeWidth{m_die->stoppedEdgeWidth()},
               m_vertexBuffer{},
               m_indexBuffer{}
 
     {
+        TRACE_SPAN("loadModel");
         m_die->loadModel(textureAtlas);
         //m_die->resetPosition();
+        metrics::add(metrics::diceAlive, 1);
     }
 
-    virtual ~DiceGraphics() = default;
+    virtual ~DiceGraphics() {
+        metrics::add(metrics::diceAlive, -1);
+    }
 protected:
     std::shared_ptr<DicePhysicsModel> m_die;
     std::vector<uint32_t> m_rerollIndices;
     bool m_isSelected;
+    DiceSnapshot::DieState const *m_snapshotState;
+    bool m_resultSent;
+    std::weak_ptr<TextureAtlas> m_textureAtlas;
+    // the edge widths of the model, copied so that drawing does not read the physics model.
+    float m_rollingEdgeWidth;
+    float m_stoppedEdgeWidth;
 
     /* vertex buffer and index buffer. the index buffer indicates which vertices to draw and in
      * the specified order.  Note, vertices can be listed twice if they should be part of more
@@ -290,15 +368,37 @@ public:
 
     virtual bool updateUniformBuffer()=0;
 
+    /* For running the physics on a separate thread from the rendering.  While the simulation is
+     * threaded, the simulation thread calls simulate (and updateAcceleration) and nothing else.
+     * simulate runs one physics step and publishes the new dice state.  The render thread calls
+     * applySimulationSnapshot to pick up the latest published state (returns true if there was a
+     * new one) and draws with it.  Anything that adds, removes or moves dice must only be done while
+     * the simulation is not threaded.
+     */
+    virtual bool simulate()=0;
+    virtual bool applySimulationSnapshot()=0;
+    virtual DiceSnapshot const &simulationSnapshot()=0;
+    virtual void setSimulationThreaded(bool threaded)=0;
+
     virtual bool allStopped()=0;
 
+    // returns true if any dice are still rolling (as opposed to stopped or moving into place).
+    virtual bool anyRolling()=0;
+
     virtual std::vector<std::vector<uint32_t>> getDiceResults()=0;
 
+    /* Returns the dice that landed on a result since the last call, as the render thread sees
+     * them.  restartSettledDice makes the next call return all the dice that have a result, for
+     * when a new roll starts.
+     */
+    virtual std::vector<SettledDie> takeSettledDice()=0;
+    virtual void restartSettledDice()=0;
+
     virtual bool needsReroll()=0;
 
     virtual void animateMoveStoppedDice()=0;
 
-    virtual void loadObject(std::vector<std::string> const &symbols,
+    virtual void loadObject(SymbolIds const &symbols,
                             std::vector<uint32_t> const &rerollSymbol,
                             std::vector<float> const &color)=0;
 
@@ -308,6 +408,13 @@ public:
 
     virtual void resetToStoppedPositions(std::vector<std::vector<uint32_t>> const &inUpFaceIndices)=0;
 
+    /* Sets the dice and displays them stopped, showing upFaceIndices (in the shape returned by
+     * getDiceResults).  Only the dice that can be seen get models.
+     */
+    virtual void showStoppedDice(std::string const &inDiceName,
+            std::vector<std::shared_ptr<DiceDescription>> const &inDiceDescriptions,
+            bool inIsModifiedRoll, std::vector<std::vector<uint32_t>> upFaceIndices)=0;
+
     virtual void addRollingDice() = 0;
 
     virtual void cleanupThread() = 0;
@@ -408,6 +515,22 @@ public:
 
     bool isModifiedRoll() { return m_isModifiedRoll; }
 
+    /* Every random draw for a roll (start positions, velocities, up faces and the rerolls) comes
+     * from the roll seed on the drawing thread, so a roll can be replayed from its seed.
+     */
+    void setRollSeed(RandomSeed const &seed) {
+        m_rollSeed = seed;
+        Random::seedThread(seed);
+    }
+
+    RandomSeed const &rollSeed() { return m_rollSeed; }
+
+    // The ID Java gave the dice configuration.  It is sent back with the results instead of the
+    // configuration itself since Java already has it.
+    void setConfigurationId(int32_t configurationId) { m_configurationId = configurationId; }
+
+    int32_t configurationId() { return m_configurationId; }
+
     RainbowDice(bool reverseGravity)
             : m_screenWidth{2.0f},
               m_screenHeight{2.0f},
@@ -415,6 +538,8 @@ public:
               m_viewPoint{startViewPoint()},
               m_viewPointCenterPosition{startViewPointCenterPosition()},
               m_isModifiedRoll{false},
+              m_rollSeed{},
+              m_configurationId{0},
               m_linearAcceleration{},
               m_gravity{0.0f, 0.0f, 9.8f},
               m_filter{}
@@ -444,6 +569,8 @@ protected:
     glm::vec3 m_viewPointCenterPosition;
 
     bool m_isModifiedRoll;
+    RandomSeed m_rollSeed;
+    int32_t m_configurationId;
 
     static constexpr float M_maxViewPointZ = 10.0f;
     static constexpr float M_minViewPointZ = 1.5f;
@@ -512,7 +639,12 @@ public:
     bool tapDice(float x, float y, uint32_t width, uint32_t height);
     bool updateUniformBuffer() override;
     std::vector<std::vector<uint32_t >> getDiceResults() override;
+    std::vector<SettledDie> takeSettledDice() override;
+    void restartSettledDice() override;
     void resetToStoppedPositions(std::vector<std::vector<uint32_t>> const &upFaceIndices) override;
+    void showStoppedDice(std::string const &inDiceName,
+            std::vector<std::shared_ptr<DiceDescription>> const &inDiceDescriptions,
+            bool inIsModifiedRoll, std::vector<std::vector<uint32_t>> upFaceIndices) override;
     void setDice(std::string const &inDiceName,
             std::vector<std::shared_ptr<DiceDescription>> const &inDiceDescriptions,
             bool inIsModifiedRoll) override;
@@ -523,6 +655,13 @@ public:
     bool addRerollSelected() override;
     bool deleteSelected() override;
     void animateMoveStoppedDice() override;
+    bool simulate() override;
+    bool applySimulationSnapshot() override;
+    void setSimulationThreaded(bool threaded) override;
+
+    DiceSnapshot const &simulationSnapshot() override {
+        return m_snapshots.front();
+    }
 
     bool diceSelected() override {
         for (auto const &dice : m_dice) {
@@ -535,12 +674,10 @@ public:
 
         return false;
     }
-    void loadObject(std::vector<std::string> const &symbols,
+    void loadObject(SymbolIds const &symbols,
                                        std::vector<uint32_t> const &rerollIndices,
                                        std::vector<float> const &color) override {
-        std::list<std::shared_ptr<DiceType>> dice;
-        dice.push_back(createDie(symbols, rerollIndices, color));
-        m_dice.push_back(std::move(dice));
+        m_dice.append(m_dice.addGroup(), createDie(symbols, rerollIndices, color));
     }
 
     void resetPositions() override {
@@ -558,7 +695,7 @@ public:
             if (dice.empty()) {
                 continue;
             }
-            auto const &die = *(dice.rbegin());
+            auto const &die = dice.back();
             if (die->needsReroll()) {
                 return true;
             }
@@ -578,7 +715,7 @@ public:
         return true;
     }
 
-    bool anyRolling() {
+    bool anyRolling() override {
         for (auto const &dice : m_dice) {
             for (auto const &die : dice) {
                 if (!die->die()->isStopped()) {
@@ -594,19 +731,44 @@ public:
       : RainbowDice{reverseGravity},
         m_drawRollingDice{inDrawRollingDice},
         m_dice{},
-        m_diceBox{}
+        m_diceBox{},
+        m_simulationThreaded{false},
+        m_snapshots{},
+        m_offscreenResults{},
+        m_atlasManager{}
     {
     }
 
     ~RainbowDiceGraphics() override = default;
 protected:
     bool m_drawRollingDice;
-    using DiceList = std::list<std::list<std::shared_ptr<DiceType>>>;
+    // one group per die in the dice descriptions, holding that die followed by its rerolls.
+    using DiceList = GroupedVector<std::shared_ptr<DiceType>>;
     DiceList m_dice;
 
     std::shared_ptr<DiceBoxType> m_diceBox;
 
-    virtual std::shared_ptr<DiceType> createDie(std::vector<std::string> const &symbols,
+    bool m_simulationThreaded;
+    TripleBuffer<DiceSnapshot> m_snapshots;
+
+    // the results of the groups of dice after the ones in m_dice, for the dice that were not
+    // rolled with animation and do not fit in the stopped dice grid.  No models are built for them.
+    std::vector<std::vector<uint32_t>> m_offscreenResults;
+
+    // the atlas the textures are uploaded from and the dice models are built with.
+    TextureAtlasManager m_atlasManager;
+
+    // whether any dice are rolling or all dice are stopped according to the state the render
+    // thread is drawing.
+    bool renderAnyRolling() {
+        return m_simulationThreaded ? m_snapshots.front().anyRolling : anyRolling();
+    }
+
+    bool renderAllStopped() {
+        return m_simulationThreaded ? m_snapshots.front().allStopped : allStopped();
+    }
+
+    virtual std::shared_ptr<DiceType> createDie(SymbolIds const &symbols,
                                                 std::vector<uint32_t> const &inRerollIndices,
                                                 std::vector<float> const &color) = 0;
     virtual std::shared_ptr<DiceType> createDie(std::shared_ptr<DiceType> const &inDice) = 0;
@@ -614,7 +776,21 @@ protected:
     void moveDiceToStoppedPositions();
 private:
     void addRerollDice(bool resetPosition);
-    void moveDiceToStoppedRandomUpface();
+    void addRerollChains();
+    void publishSnapshot();
+    void loadStoppedDice(std::vector<std::vector<uint32_t>> &results);
+
+    // the number of stopped dice that can be seen, zooming out and scrolling as far as the view
+    // goes.
+    uint32_t stoppedDiceCapacity() {
+        float diameter = 2 * DicePhysicsModel::stoppedRadius;
+        float zoomOut = (M_maxViewPointZ - DicePhysicsModel::stoppedMoveToZ) /
+                (startViewPoint().z - DicePhysicsModel::stoppedMoveToZ);
+        auto nbrX = static_cast<uint32_t>(m_screenWidthStoppedDicePlane / diameter);
+        auto nbrY = static_cast<uint32_t>(std::ceil((m_screenHeightStoppedDicePlane / 2 + m_maxScroll +
+                m_screenHeightStoppedDicePlane * zoomOut / 2) / diameter));
+        return std::max(nbrX, 1u) * nbrY;
+    }
 
     std::pair<float, float> findStoppedDiceXY(int diceNbr) {
         auto nbrX = static_cast<uint32_t>(m_screenWidthStoppedDicePlane / (2 * DicePhysicsModel::stoppedRadius));
@@ -634,26 +810,70 @@ template <typename DiceType, typename DiceBoxType>
 bool RainbowDiceGraphics<DiceType, DiceBoxType>::changeDice(std::string const &inDiceName,
                 std::vector<std::shared_ptr<DiceDescription>> const &inDiceDescriptions,
                 std::shared_ptr<TextureAtlas> inTexture) {
+    TRACE_SPAN("changeDice");
     setTexture(std::move(inTexture));
-    setDice(inDiceName, inDiceDescriptions, false);
-    initModels();
     if (m_drawRollingDice) {
         // display rolling dice
+        setDice(inDiceName, inDiceDescriptions, false);
+        initModels();
         resetPositions();
         updateUniformBuffer();
         return false;
     } else {
-        // Do not animate the roll, just display the result.
-        resetPositions();
-        moveDiceToStoppedPositions();
-        while (needsReroll()) {
-            addRerollDice(true);
-            moveDiceToStoppedPositions();
-        }
+        // Do not animate the roll, just display the result.  The results come straight from the
+        // random number generator and only the dice that can be seen are built.
+        showStoppedDice(inDiceName, inDiceDescriptions, false, DiceRoller::roll(inDiceDescriptions));
         return true;
     }
 }
 
+template <typename DiceType, typename DiceBoxType>
+void RainbowDiceGraphics<DiceType, DiceBoxType>::showStoppedDice(std::string const &inDiceName,
+        std::vector<std::shared_ptr<DiceDescription>> const &inDiceDescriptions,
+        bool inIsModifiedRoll, std::vector<std::vector<uint32_t>> upFaceIndices) {
+    RainbowDice::setDice(inDiceName, inDiceDescriptions, inIsModifiedRoll);
+    loadStoppedDice(upFaceIndices);
+    initModels();
+    resetToStoppedPositions(upFaceIndices);
+}
+
+/* Creates the first die of each group of results that fits in the stopped dice grid
+ * (resetToStoppedPositions adds the rerolls).  The groups that do not fit are moved out of results
+ * into m_offscreenResults.
+ */
+template <typename DiceType, typename DiceBoxType>
+void RainbowDiceGraphics<DiceType, DiceBoxType>::loadStoppedDice(
+        std::vector<std::vector<uint32_t>> &results) {
+    TRACE_SPAN("loadStoppedDice");
+    m_dice.clear();
+    m_offscreenResults.clear();
+
+    uint32_t capacity = stoppedDiceCapacity();
+    uint32_t nbrDice = 0;
+    size_t i = 0;
+    for (auto const &diceDescription : m_diceDescriptions) {
+        if (diceDescription->m_symbols.size() == 1) {
+            // Die is a constant... just ignore.
+            continue;
+        }
+        SymbolIds symbols = m_atlasManager.atlas()->symbolIds(diceDescription->m_symbols);
+        for (uint32_t j = 0; j < diceDescription->m_nbrDice && i < results.size(); j++, i++) {
+            nbrDice += results[i].size();
+            if (nbrDice > capacity) {
+                break;
+            }
+            loadObject(symbols, diceDescription->m_rerollOnIndices, diceDescription->m_color);
+        }
+        if (nbrDice > capacity) {
+            break;
+        }
+    }
+
+    m_offscreenResults.assign(std::make_move_iterator(results.begin() + m_dice.nbrGroups()),
+                              std::make_move_iterator(results.end()));
+    results.resize(m_dice.nbrGroups());
+}
+
 template <typename DiceType, typename DiceBoxType>
 bool RainbowDiceGraphics<DiceType, DiceBoxType>::tapDice(float x, float y, uint32_t width, uint32_t height) {
     float swidth = 2.0;
@@ -691,36 +911,39 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::tapDice(float x, float y, uint3
 
 template <typename DiceType, typename DiceBoxType>
 bool RainbowDiceGraphics<DiceType, DiceBoxType>::updateUniformBuffer() {
-    for (auto iti = m_dice.begin(); iti != m_dice.end(); iti++) {
-        for (auto itdi = iti->begin(); itdi != iti->end(); itdi++) {
-            auto const &die1 = *itdi;
-            if (!die1->die()->isStopped()) {
-                // first calculate bounce for the rest of the current list of dice
-                auto itdj = itdi;
-                itdj++;
-                while (itdj != iti->end()) {
-                    auto const &die2 = *(itdj);
-                    if (!die2->die()->isStopped()) {
-                        die1->die()->calculateBounce(die2->die().get());
-                    }
-                    itdj++;
-                }
-
-                // next, calculate the bounce for the next lists of dice.
-                auto itj = iti;
-                itj++;
-                while (itj != m_dice.end()) {
-                    for (auto const &die2 : *itj) {
+    {
+        TRACE_SPAN("calculateBounce");
+        uint64_t pairTests = 0;
+        for (uint32_t gi = 0; gi < m_dice.nbrGroups(); gi++) {
+            auto dice = m_dice.group(gi);
+            for (uint32_t di = 0; di < dice.size(); di++) {
+                auto const &die1 = dice[di];
+                if (!die1->die()->isStopped()) {
+                    // first calculate bounce for the rest of the current group of dice
+                    for (uint32_t dj = di + 1; dj < dice.size(); dj++) {
+                        auto const &die2 = dice[dj];
                         if (!die2->die()->isStopped()) {
                             die1->die()->calculateBounce(die2->die().get());
+                            pairTests++;
+                        }
+                    }
+
+                    // next, calculate the bounce for the next groups of dice.
+                    for (uint32_t gj = gi + 1; gj < m_dice.nbrGroups(); gj++) {
+                        for (auto const &die2 : m_dice.group(gj)) {
+                            if (!die2->die()->isStopped()) {
+                                die1->die()->calculateBounce(die2->die().get());
+                                pairTests++;
+                            }
                         }
                     }
-                    itj++;
                 }
             }
         }
+        metrics::add(metrics::bouncePairTests, pairTests);
     }
 
+    TRACE_SPAN("updateModelMatrix");
     bool needsRedraw = false;
     uint32_t i = 0;
     for (auto const &dice : m_dice) {
@@ -733,6 +956,7 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::updateUniformBuffer() {
             // positioned, then the stopped animation is done, but never started.
             if (die->die()->isStopped() && !die->die()->isStoppedAnimationDone() &&
                 !die->die()->isStoppedAnimationStarted()) {
+                TRACE_SPAN("animateMove");
                 auto xy = findStoppedDiceXY(i);
                 die->die()->animateMove(xy.first, xy.second);
             }
@@ -743,6 +967,102 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::updateUniformBuffer() {
     return needsRedraw;
 }
 
+template <typename DiceType, typename DiceBoxType>
+void RainbowDiceGraphics<DiceType, DiceBoxType>::publishSnapshot() {
+    DiceSnapshot &snapshot = m_snapshots.back();
+    snapshot.dice.clear();
+    for (auto const &dice : m_dice) {
+        for (auto const &die : dice) {
+            snapshot.dice.push_back(DiceSnapshot::DieState{die->die()->model(), die->die()->isStopped(),
+                    die->die()->hasResult(), die->die()->getResult()});
+        }
+    }
+    snapshot.allStopped = allStopped();
+    snapshot.anyRolling = anyRolling();
+    m_snapshots.publish();
+}
+
+template <typename DiceType, typename DiceBoxType>
+bool RainbowDiceGraphics<DiceType, DiceBoxType>::simulate() {
+    // only the physics, not any graphics API work done in overrides of updateUniformBuffer.
+    bool needsRedraw = RainbowDiceGraphics::updateUniformBuffer();
+
+    // the render thread stops the simulation once it sees a snapshot with all the dice stopped, so
+    // always publish that one.
+    if (needsRedraw || allStopped()) {
+        publishSnapshot();
+    }
+
+    return needsRedraw;
+}
+
+template <typename DiceType, typename DiceBoxType>
+bool RainbowDiceGraphics<DiceType, DiceBoxType>::applySimulationSnapshot() {
+    if (!m_snapshots.acquire()) {
+        return false;
+    }
+
+    DiceSnapshot const &snapshot = m_snapshots.front();
+    size_t i = 0;
+    for (auto const &dice : m_dice) {
+        for (auto const &die : dice) {
+            die->setSnapshotState(i < snapshot.dice.size() ? &snapshot.dice[i] : nullptr);
+            i++;
+        }
+    }
+
+    return true;
+}
+
+template <typename DiceType, typename DiceBoxType>
+void RainbowDiceGraphics<DiceType, DiceBoxType>::setSimulationThreaded(bool threaded) {
+    if (threaded) {
+        // the simulation thread is not running yet, so publish the current state from here so
+        // that the render thread has something to draw until the first simulation step is done.
+        publishSnapshot();
+        m_simulationThreaded = true;
+        applySimulationSnapshot();
+    } else {
+        m_simulationThreaded = false;
+        for (auto const &dice : m_dice) {
+            for (auto const &die : dice) {
+                die->setSnapshotState(nullptr);
+            }
+        }
+    }
+}
+
+template <typename DiceType, typename DiceBoxType>
+std::vector<SettledDie> RainbowDiceGraphics<DiceType, DiceBoxType>::takeSettledDice() {
+    std::vector<SettledDie> settled;
+    uint32_t group = 0;
+    for (auto const &dice : m_dice) {
+        uint32_t index = 0;
+        for (auto const &die : dice) {
+            if (!die->renderHasResult()) {
+                // the die is rolling (again), send its result when it lands.
+                die->setResultSent(false);
+            } else if (!die->isResultSent()) {
+                settled.push_back(SettledDie{group, index, die->renderResult()});
+                die->setResultSent(true);
+            }
+            index++;
+        }
+        group++;
+    }
+
+    return settled;
+}
+
+template <typename DiceType, typename DiceBoxType>
+void RainbowDiceGraphics<DiceType, DiceBoxType>::restartSettledDice() {
+    for (auto const &dice : m_dice) {
+        for (auto const &die : dice) {
+            die->setResultSent(false);
+        }
+    }
+}
+
 template <typename DiceType, typename DiceBoxType>
 std::vector<std::vector<uint32_t >> RainbowDiceGraphics<DiceType, DiceBoxType>::getDiceResults() {
     std::vector<std::vector<uint32_t>> results;
@@ -757,41 +1077,35 @@ std::vector<std::vector<uint32_t >> RainbowDiceGraphics<DiceType, DiceBoxType>::
         }
         results.push_back(dieResults);
     }
+    results.insert(results.end(), m_offscreenResults.begin(), m_offscreenResults.end());
 
     return std::move(results);
 }
 
 template <typename DiceType, typename DiceBoxType>
 void RainbowDiceGraphics<DiceType, DiceBoxType>::resetToStoppedPositions(std::vector<std::vector<uint32_t>> const &upFaceIndices) {
-    uint32_t i = 0;
     uint32_t k = 0;
-
-    for (auto diceIt = m_dice.begin(); diceIt != m_dice.end(); diceIt++) {
-        size_t size = diceIt->size();
-        while (diceIt != m_dice.end() && upFaceIndices[i].empty()) {
-            diceIt->clear();
-            i++;
-            diceIt++;
+    uint32_t nbrGroups = std::min(m_dice.nbrGroups(), static_cast<uint32_t>(upFaceIndices.size()));
+    for (uint32_t i = 0; i < nbrGroups; i++) {
+        if (upFaceIndices[i].empty()) {
+            m_dice.clearGroup(i);
+            continue;
         }
-        if (diceIt == m_dice.end()) {
-            break;
+        if (m_dice.group(i).empty()) {
+            continue;
         }
+        uint32_t size = m_dice.group(i).size();
         for (uint32_t j = 0; j < upFaceIndices[i].size(); j++) {
             auto xy = findStoppedDiceXY(k);
             if (j < size) {
-                auto diceItj = diceIt->begin();
-                for (int l = 0; l < j; l++) {
-                    diceItj++;
-                }
-                diceItj->get()->die()->positionDice(upFaceIndices[i][j], xy.first, xy.second);
+                m_dice.group(i)[j]->die()->positionDice(upFaceIndices[i][j], xy.first, xy.second);
             } else {
-                auto die = createDie(*(diceIt->begin()));
+                auto die = createDie(m_dice.group(i).front());
                 die->die()->positionDice(upFaceIndices[i][j], xy.first, xy.second);
-                diceIt->push_back(die);
+                m_dice.append(i, std::move(die));
             }
             k++;
         }
-        i++;
     }
 }
 
@@ -801,28 +1115,67 @@ void RainbowDiceGraphics<DiceType, DiceBoxType>::setDice(std::string const &inDi
                                             bool inIsModifiedRoll) {
     RainbowDice::setDice(inDiceName, inDiceDescriptions, inIsModifiedRoll);
 
+    // The dice whose models were built with the resident atlas still have the right texture
+    // coordinates: the ones that are the same as a new die are kept with their vertex buffers.
+    std::map<SymbolIds, std::vector<std::shared_ptr<DiceType>>> previousDice;
+    for (auto const &dice : m_dice) {
+        for (auto const &die : dice) {
+            if (die->usesTextureAtlas(m_atlasManager.atlas())) {
+                previousDice[die->die()->getSymbols()].push_back(die);
+            }
+        }
+    }
+
     m_dice.clear();
+    m_offscreenResults.clear();
     for (auto const &diceDescription : m_diceDescriptions) {
         if (diceDescription->m_symbols.size() == 1) {
             // Die is a constant... just ignore.
             continue;
         }
+        SymbolIds symbols = m_atlasManager.atlas()->symbolIds(diceDescription->m_symbols);
+        auto previous = previousDice.find(symbols);
         for (int i = 0; i < diceDescription->m_nbrDice; i++) {
-            loadObject(diceDescription->m_symbols, diceDescription->m_rerollOnIndices,
-                       diceDescription->m_color);
+            std::shared_ptr<DiceType> die;
+            if (previous != previousDice.end()) {
+                auto &candidates = previous->second;
+                auto it = std::find_if(candidates.begin(), candidates.end(),
+                        [&diceDescription](std::shared_ptr<DiceType> const &candidate) {
+                            return candidate->rerollIndices() == diceDescription->m_rerollOnIndices &&
+                                   candidate->die()->dieColor() == diceDescription->m_color;
+                        });
+                if (it != candidates.end()) {
+                    die = std::move(*it);
+                    candidates.erase(it);
+                }
+            }
+
+            if (die == nullptr) {
+                loadObject(symbols, diceDescription->m_rerollOnIndices, diceDescription->m_color);
+                continue;
+            }
+
+            // the caller resets the positions.
+            if (die->isSelected()) {
+                die->toggleSelected();
+            }
+            die->setResultSent(false);
+            die->setSnapshotState(nullptr);
+            m_dice.append(m_dice.addGroup(), std::move(die));
         }
     }
 }
 
 template <typename DiceType, typename DiceBoxType>
 void RainbowDiceGraphics<DiceType, DiceBoxType>::addRerollDice(bool resetPosition) {
-    for (auto &dice : m_dice) {
+    for (uint32_t i = 0; i < m_dice.nbrGroups(); i++) {
+        auto dice = m_dice.group(i);
         if (dice.empty()) {
             continue;
         }
-        // only check the last dice in the list to see if it needs to be rerolled.  The other dice
-        // in the list already got rerolled.  That is why there is a die after it.
-        auto const &die = *(dice.rbegin());
+        // only check the last dice in the group to see if it needs to be rerolled.  The other dice
+        // in the group already got rerolled.  That is why there is a die after it.
+        auto const &die = dice.back();
 
         uint32_t result = die->die()->getResult() % die->die()->getNumberOfSymbols();
         bool shouldReroll = false;
@@ -842,26 +1195,40 @@ void RainbowDiceGraphics<DiceType, DiceBoxType>::addRerollDice(bool resetPositio
             dieNew->die()->resetPosition();
         }
 
-        dice.push_back(dieNew);
+        m_dice.append(i, std::move(dieNew));
     }
 }
 
+/* For the stopped dice: samples all the rerolls of each group whose last die landed on a reroll
+ * face at once (DiceRoller::rollChain), then lays the dice out once.
+ */
 template <typename DiceType, typename DiceBoxType>
-void RainbowDiceGraphics<DiceType, DiceBoxType>::addRollingDice() {
-    addRerollDice(true);
-    animateMoveStoppedDice();
-}
-
-template <typename DiceType, typename DiceBoxType>
-void RainbowDiceGraphics<DiceType, DiceBoxType>::moveDiceToStoppedRandomUpface() {
-    int i=0;
+void RainbowDiceGraphics<DiceType, DiceBoxType>::addRerollChains() {
+    std::vector<std::vector<uint32_t>> results;
+    bool rerolled = false;
     for (auto const &dice : m_dice) {
+        std::vector<uint32_t> dieResults;
         for (auto const &die : dice) {
-            auto xy = findStoppedDiceXY(i);
-            die->die()->positionDice(xy.first, xy.second, true);
-            i++;
+            dieResults.push_back(die->die()->getResult());
+        }
+        if (!dice.empty() && dice.back()->needsReroll()) {
+            auto const &die = dice.back();
+            DiceRoller::rollChain(die->die()->getNumberOfSymbols(), die->rerollIndices(),
+                                  dieResults);
+            rerolled = true;
         }
+        results.push_back(std::move(dieResults));
     }
+
+    if (rerolled) {
+        resetToStoppedPositions(results);
+    }
+}
+
+template <typename DiceType, typename DiceBoxType>
+void RainbowDiceGraphics<DiceType, DiceBoxType>::addRollingDice() {
+    addRerollDice(true);
+    animateMoveStoppedDice();
 }
 
 template <typename DiceType, typename DiceBoxType>
@@ -907,10 +1274,7 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::rerollSelected() {
         return false;
     } else {
         moveDiceToStoppedPositions();
-        while (needsReroll()) {
-            addRerollDice(true);
-            moveDiceToStoppedPositions();
-        }
+        addRerollChains();
         return true;
     }
 }
@@ -918,18 +1282,19 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::rerollSelected() {
 // returns true if a result is ready, false otherwise
 template <typename DiceType, typename DiceBoxType>
 bool RainbowDiceGraphics<DiceType, DiceBoxType>::addRerollSelected() {
-    for (auto &dice : m_dice) {
-        for (auto diceIt = dice.begin(); diceIt != dice.end(); diceIt++) {
-            if (diceIt->get()->isSelected()) {
+    for (uint32_t i = 0; i < m_dice.nbrGroups(); i++) {
+        for (uint32_t j = 0; j < m_dice.group(i).size(); j++) {
+            auto const &selected = m_dice.group(i)[j];
+            if (selected->isSelected()) {
                 m_isModifiedRoll = true;
 
-                auto die = createDie(*diceIt);
+                auto die = createDie(selected);
                 die->die()->resetPosition();
-                diceIt->get()->toggleSelected();
+                selected->toggleSelected();
 
-                diceIt++;
-                dice.insert(diceIt, die);
-                diceIt--;
+                // the new die goes right after the selected one, skip over it.
+                m_dice.insert(i, j + 1, std::move(die));
+                j++;
             }
         }
     }
@@ -943,10 +1308,7 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::addRerollSelected() {
         moveDiceToStoppedPositions();
 
         // auto reroll if a die lands on a face that was configured for re-roll.
-        while (needsReroll()) {
-            addRerollDice(true);
-            moveDiceToStoppedPositions();
-        }
+        addRerollChains();
         return true;
     }
 }
@@ -954,17 +1316,11 @@ bool RainbowDiceGraphics<DiceType, DiceBoxType>::addRerollSelected() {
 // returns true if a redraw is needed, and false otherwise.
 template <typename DiceType, typename DiceBoxType>
 bool RainbowDiceGraphics<DiceType, DiceBoxType>::deleteSelected() {
-    bool diceDeleted = false;
-    for (auto &dice : m_dice) {
-        for (auto diceIt = dice.begin(); diceIt != dice.end();) {
-            if (diceIt->get()->isSelected()) {
-                m_isModifiedRoll = true;
-                diceDeleted = true;
-                diceIt = dice.erase(diceIt);
-            } else {
-                diceIt++;
-            }
-        }
+    bool diceDeleted = m_dice.eraseIf([](std::shared_ptr<DiceType> const &die) {
+        return die->isSelected();
+    }) > 0;
+    if (diceDeleted) {
+        m_isModifiedRoll = true;
     }
 
     if (diceDeleted) {
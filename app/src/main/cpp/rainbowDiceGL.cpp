@@ -23,11 +23,14 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <android/native_window.h>
+#include <cstdio>
 #include <cstring>
+#include <fstream>
 #include <jni.h>
 #include "rainbowDiceGL.hpp"
 #include "rainbowDiceGlobal.hpp"
 #include "android.hpp"
+#include "trace.hpp"
 
 namespace graphicsGL {
     void Surface::createSurface() {
@@ -155,6 +158,139 @@ namespace graphicsGL {
         }
     }
 
+    // 64 bit FNV-1a hash.
+    static uint64_t hashBytes(uint64_t hash, char const *bytes, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<unsigned char>(bytes[i]);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    static uint64_t hashGLString(uint64_t hash, GLenum name) {
+        char const *str = reinterpret_cast<char const *>(glGetString(name));
+        if (str == nullptr) {
+            return hash;
+        }
+        return hashBytes(hash, str, strlen(str) + 1);
+    }
+
+    ProgramBinaryCache::ProgramBinaryCache(std::string const &name,
+            AssetView const &vertexShader, AssetView const &fragmentShader)
+            : m_getProgramBinary{nullptr},
+              m_programBinary{nullptr},
+              m_cacheFile{},
+              m_key{0xcbf29ce484222325ULL}
+    {
+        char const *extensions = reinterpret_cast<char const *>(glGetString(GL_EXTENSIONS));
+        if (extensions == nullptr || strstr(extensions, "GL_OES_get_program_binary") == nullptr) {
+            return;
+        }
+
+        GLint nbrFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &nbrFormats);
+        if (nbrFormats <= 0 || cacheDirectory().empty()) {
+            return;
+        }
+
+        m_getProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYOESPROC>(
+                eglGetProcAddress("glGetProgramBinaryOES"));
+        m_programBinary = reinterpret_cast<PFNGLPROGRAMBINARYOESPROC>(
+                eglGetProcAddress("glProgramBinaryOES"));
+
+        m_key = hashBytes(m_key, vertexShader.data(), vertexShader.size());
+        m_key = hashBytes(m_key, fragmentShader.data(), fragmentShader.size());
+        m_key = hashGLString(m_key, GL_VENDOR);
+        m_key = hashGLString(m_key, GL_RENDERER);
+        m_key = hashGLString(m_key, GL_VERSION);
+
+        m_cacheFile = cacheDirectory() + "/" + name + ".glbin";
+    }
+
+    GLuint ProgramBinaryCache::load() {
+        if (!enabled()) {
+            return 0;
+        }
+
+        std::ifstream file(m_cacheFile, std::ios::in | std::ios::binary);
+        if (!file) {
+            return 0;
+        }
+
+        Header header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof (header));
+        if (!file || header.magic != m_magic || header.key != m_key || header.length == 0) {
+            return 0;
+        }
+
+        std::vector<char> binary(header.length);
+        file.read(binary.data(), binary.size());
+        if (!file) {
+            return 0;
+        }
+
+        // clear any stale errors so that they are not mistaken for a rejected binary.
+        while (glGetError() != GL_NO_ERROR);
+
+        GLuint programID = glCreateProgram();
+        m_programBinary(programID, header.binaryFormat, binary.data(), header.length);
+
+        // The driver may reject the binary (e.g. after a driver update that did not change the
+        // version string).  In that case, the caller recompiles from source.
+        GLint result = GL_FALSE;
+        glGetProgramiv(programID, GL_LINK_STATUS, &result);
+        if (glGetError() != GL_NO_ERROR || result == GL_FALSE) {
+            glDeleteProgram(programID);
+            return 0;
+        }
+
+        return programID;
+    }
+
+    void ProgramBinaryCache::save(GLuint programID) {
+        if (!enabled()) {
+            return;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        Header header{};
+        std::vector<char> binary(static_cast<size_t>(length));
+        GLsizei actualLength = 0;
+        while (glGetError() != GL_NO_ERROR);
+        m_getProgramBinary(programID, length, &actualLength, &header.binaryFormat, binary.data());
+        if (glGetError() != GL_NO_ERROR || actualLength <= 0) {
+            return;
+        }
+
+        header.magic = m_magic;
+        header.key = m_key;
+        header.length = static_cast<uint32_t>(actualLength);
+
+        // write to a temporary file and rename so that a partially written cache file is never
+        // read.
+        std::string tmpFile = m_cacheFile + ".tmp";
+        {
+            std::ofstream file(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return;
+            }
+            file.write(reinterpret_cast<char const *>(&header), sizeof (header));
+            file.write(binary.data(), header.length);
+            if (!file) {
+                file.close();
+                remove(tmpFile.c_str());
+                return;
+            }
+        }
+        if (rename(tmpFile.c_str(), m_cacheFile.c_str()) != 0) {
+            remove(tmpFile.c_str());
+        }
+    }
 } /* namespace graphicsGL */
 
 char constexpr const *SHADER_VERT_FILE = "shaderGL.vert";
@@ -179,6 +315,7 @@ void RainbowDiceGL::initModels() {
 }
 
 void RainbowDiceGL::drawFrame() {
+    TRACE_SPAN("drawFrame");
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Use the dice shader.
@@ -192,6 +329,10 @@ void RainbowDiceGL::drawFrame() {
     GLint viewPos = glGetUniformLocation(m_programID, "viewPosition");
     glUniform3fv(viewPos, 1, &m_viewPoint[0]);
 
+    GLint isDistanceField = glGetUniformLocation(m_programID, "isDistanceField");
+    glUniform1i(isDistanceField,
+                m_texture->textureAtlas()->format() == TextureFormat::distanceField8 ? 1 : 0);
+
     for (auto const &dice : m_dice) {
         for (auto const &die : dice) {
             // Send our transformation to the currently bound shader, in the "MVP"
@@ -208,7 +349,7 @@ void RainbowDiceGL::drawFrame() {
 
             // model matrix
             MatrixID = glGetUniformLocation(m_programID, "model");
-            glm::mat4 model = die->die()->model();
+            glm::mat4 model = die->renderModel();
             glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &model[0][0]);
 
             // the model matrix for the normal vector
@@ -222,7 +363,7 @@ void RainbowDiceGL::drawFrame() {
 
             // the width of the edges of the die
             var = glGetUniformLocation(m_programID, "edgeWidth");
-            glUniform1f(var, die->die()->edgeWidth());
+            glUniform1f(var, die->renderEdgeWidth());
 
             // 1st attribute buffer : colors
             GLint colorID = glGetAttribLocation(m_programID, "inColor");
@@ -361,6 +502,8 @@ void RainbowDiceGL::drawFrame() {
             // Draw the triangles !
             //glDrawArrays(GL_TRIANGLES, 0, dice[0].die->vertices.size() /* total number of vertices*/);
             glDrawElements(GL_TRIANGLES, die->die()->getIndices().size(), GL_UNSIGNED_INT, 0);
+            metrics::add(metrics::drawCalls);
+            metrics::add(metrics::verticesDrawn, die->die()->getIndices().size());
 
             glDisableVertexAttribArray(position);
             glDisableVertexAttribArray(colorID);
@@ -376,7 +519,7 @@ void RainbowDiceGL::drawFrame() {
         }
     }
 
-    if (m_diceBox != nullptr && anyRolling()) {
+    if (m_diceBox != nullptr && renderAnyRolling()) {
         // Use the dice box shader.
         glUseProgram(m_programIDDiceBox);
         viewPos = glGetUniformLocation(m_programIDDiceBox, "viewPosition");
@@ -488,6 +631,8 @@ void RainbowDiceGL::drawFrame() {
 
         // Draw the triangles !
         glDrawElements(GL_TRIANGLES, m_diceBox->nbrIndices(), GL_UNSIGNED_INT, 0);
+        metrics::add(metrics::drawCalls);
+        metrics::add(metrics::verticesDrawn, m_diceBox->nbrIndices());
 
         glDisableVertexAttribArray(position);
         glDisableVertexAttribArray(colorID);
@@ -498,15 +643,26 @@ void RainbowDiceGL::drawFrame() {
         glDisableVertexAttribArray(corner4ID);
     }
 
-    eglSwapBuffers(m_surface->display(), m_surface->surface());
+    {
+        TRACE_SPAN("swapBuffers");
+        eglSwapBuffers(m_surface->display(), m_surface->surface());
+    }
 }
 
 GLuint RainbowDiceGL::loadShaders(std::string const &vertexShaderFile, std::string const &fragmentShaderFile) {
+    TRACE_SPAN("loadShaders");
     GLint Result = GL_TRUE;
     GLint InfoLogLength = 0;
 
-    std::vector<char> vertexShader = readFile(vertexShaderFile);
-    std::vector<char> fragmentShader = readFile(fragmentShaderFile);
+    AssetView vertexShader = readAsset(vertexShaderFile);
+    AssetView fragmentShader = readAsset(fragmentShaderFile);
+
+    graphicsGL::ProgramBinaryCache cache(vertexShaderFile + "_" + fragmentShaderFile,
+            vertexShader, fragmentShader);
+    GLuint CachedProgramID = cache.load();
+    if (CachedProgramID != 0) {
+        return CachedProgramID;
+    }
 
     // Create the shaders
     GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
@@ -514,7 +670,8 @@ GLuint RainbowDiceGL::loadShaders(std::string const &vertexShaderFile, std::stri
 
     // Compile Vertex Shader
     char const * VertexSourcePointer = vertexShader.data();
-    glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+    GLint VertexSourceLength = static_cast<GLint>(vertexShader.size());
+    glShaderSource(VertexShaderID, 1, &VertexSourcePointer , &VertexSourceLength);
     glCompileShader(VertexShaderID);
 
     // Check Vertex Shader
@@ -537,7 +694,8 @@ GLuint RainbowDiceGL::loadShaders(std::string const &vertexShaderFile, std::stri
 
     // Compile Fragment Shader
     char const * FragmentSourcePointer = fragmentShader.data();
-    glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+    GLint FragmentSourceLength = static_cast<GLint>(fragmentShader.size());
+    glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , &FragmentSourceLength);
     glCompileShader(FragmentShaderID);
 
     // Check Fragment Shader
@@ -583,6 +741,8 @@ GLuint RainbowDiceGL::loadShaders(std::string const &vertexShaderFile, std::stri
     glDeleteShader(VertexShaderID);
     glDeleteShader(FragmentShaderID);
 
+    cache.save(ProgramID);
+
     return ProgramID;
 }
 
@@ -642,7 +802,7 @@ void RainbowDiceGL::recreateSwapChain(uint32_t width, uint32_t height) {
     }
 }
 
-std::shared_ptr<DiceGL> RainbowDiceGL::createDie(std::vector<std::string> const &symbols,
+std::shared_ptr<DiceGL> RainbowDiceGL::createDie(SymbolIds const &symbols,
                                   std::vector<uint32_t> const &inRerollIndices,
                                   std::vector<float> const &color) {
     return std::make_shared<DiceGL>(symbols, inRerollIndices, color, m_texture->textureAtlas());
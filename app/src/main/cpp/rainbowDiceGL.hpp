@@ -21,11 +21,14 @@
 #define RAINBOWDICE_GL_HPP
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
 #include <list>
 #include "rainbowDice.hpp"
 #include "dice.hpp"
 #include "rainbowDiceGlobal.hpp"
 #include "TextureAtlasGL.hpp"
+#include "assetView.hpp"
+#include "metrics.hpp"
 
 namespace graphicsGL {
     class Surface {
@@ -68,6 +71,45 @@ namespace graphicsGL {
         void createSurface();
         void destroySurface();
     };
+
+    /* Caches linked shader program binaries in the app cache directory using the
+     * GL_OES_get_program_binary extension so that the shaders do not need to be compiled and linked
+     * every time the surface is (re)created.  The cache entry is keyed on a hash of the shader
+     * sources and the GL vendor, renderer, and version strings.  If the extension is not available,
+     * the cache file does not exist, or the cached binary is rejected by the driver, the caller
+     * compiles the shaders from source as usual.
+     */
+    class ProgramBinaryCache {
+    public:
+        ProgramBinaryCache(std::string const &name, AssetView const &vertexShader,
+                AssetView const &fragmentShader);
+
+        // returns a linked program loaded from the cache or 0 if no valid cache entry exists.
+        GLuint load();
+
+        // saves the binary of a linked program to the cache.  Errors are ignored since the cache is
+        // only an optimization.
+        void save(GLuint programID);
+
+    private:
+        static uint32_t constexpr const m_magic = 0x52444247; // "RDBG"
+
+        struct Header {
+            uint32_t magic;
+            uint32_t binaryFormat;
+            uint64_t key;
+            uint32_t length;
+        };
+
+        PFNGLGETPROGRAMBINARYOESPROC m_getProgramBinary;
+        PFNGLPROGRAMBINARYOESPROC m_programBinary;
+        std::string m_cacheFile;
+        uint64_t m_key;
+
+        bool enabled() {
+            return m_getProgramBinary != nullptr && m_programBinary != nullptr && !m_cacheFile.empty();
+        }
+    };
 } /* namespace graphicsGL */
 
 struct GLGraphics {
@@ -77,7 +119,8 @@ struct GLGraphics {
 class DiceBoxGL : public DiceBox<GLGraphics> {
 public:
     DiceBoxGL(float maxX, float maxY, float maxZ)
-            : DiceBox{maxX, maxY, maxZ}
+            : DiceBox{maxX, maxY, maxZ},
+              m_bufferBytes{0}
     {
         createGLResources();
     }
@@ -90,6 +133,8 @@ public:
     void destroyGLResources() {
         glDeleteBuffers(1, &m_vertexBuffer);
         glDeleteBuffers(1, &m_indexBuffer);
+        metrics::add(metrics::bufferBytesAllocated, -m_bufferBytes);
+        m_bufferBytes = 0;
     }
 
     void createGLResources() {
@@ -107,6 +152,8 @@ public:
     }
 
 private:
+    int64_t m_bufferBytes;
+
     void copyVertexIndices() {
         glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
         glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_verticesDiceBox.size(),
@@ -115,6 +162,12 @@ private:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_indicesDiceBox.size(),
                      m_indicesDiceBox.data(), GL_STATIC_DRAW);
+
+        // glBufferData replaces the previous contents, so replace the old size in the gauge.
+        int64_t bufferBytes = static_cast<int64_t>(sizeof(Vertex) * m_verticesDiceBox.size() +
+                                                   sizeof(uint32_t) * m_indicesDiceBox.size());
+        metrics::add(metrics::bufferBytesAllocated, bufferBytes - m_bufferBytes);
+        m_bufferBytes = bufferBytes;
     }
 };
 
@@ -123,9 +176,10 @@ bool DiceGraphics<GLGraphics>::isGL();
 
 class DiceGL : public DiceGraphics<GLGraphics> {
 public:
-    DiceGL(std::vector<std::string> const &symbols, std::vector<uint32_t> inRerollIndices,
+    DiceGL(SymbolIds const &symbols, std::vector<uint32_t> inRerollIndices,
            std::vector<float> const &color, std::shared_ptr<TextureAtlas> const &inTextureAtlas)
-            : DiceGraphics{symbols, std::move(inRerollIndices), color, inTextureAtlas}
+            : DiceGraphics{symbols, std::move(inRerollIndices), color, inTextureAtlas},
+              m_bufferBytes{0}
     {
         createGLResources();
     }
@@ -137,6 +191,8 @@ public:
     void destroyGLResources() {
         glDeleteBuffers(1, &m_vertexBuffer);
         glDeleteBuffers(1, &m_indexBuffer);
+        metrics::add(metrics::bufferBytesAllocated, -m_bufferBytes);
+        m_bufferBytes = 0;
     }
 
     void createGLResources() {
@@ -151,11 +207,18 @@ public:
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * m_die->getIndices().size(),
                      m_die->getIndices().data(), GL_STATIC_DRAW);
+
+        m_bufferBytes = static_cast<int64_t>(sizeof(Vertex) * m_die->getVertices().size() +
+                                             sizeof(uint32_t) * m_die->getIndices().size());
+        metrics::add(metrics::bufferBytesAllocated, m_bufferBytes);
     }
 
     ~DiceGL() override {
         destroyGLResources();
     }
+
+private:
+    int64_t m_bufferBytes;
 };
 
 class RainbowDiceGL : public RainbowDiceGraphics<DiceGL, DiceBoxGL> {
@@ -210,7 +273,13 @@ public:
     }
 
     void setTexture(std::shared_ptr<TextureAtlas> inTexture) override {
-        m_texture = std::make_shared<TextureGL>(std::move(inTexture));
+        // only the symbols that are not in the resident atlas yet are uploaded.
+        auto update = m_atlasManager.merge(inTexture);
+        if (m_texture != nullptr && !update.m_rebuilt) {
+            m_texture->updateRegions(update.m_regions);
+            return;
+        }
+        m_texture = std::make_shared<TextureGL>(m_atlasManager.atlas());
     }
 
     void destroyModelGLResources();
@@ -232,7 +301,7 @@ public:
 protected:
     bool invertY() override { return true; }
 
-    std::shared_ptr<DiceGL> createDie(std::vector<std::string> const &symbols,
+    std::shared_ptr<DiceGL> createDie(SymbolIds const &symbols,
                                       std::vector<uint32_t> const &inRerollIndices,
                                       std::vector<float> const &color) override;
     std::shared_ptr<DiceGL> createDie(std::shared_ptr<DiceGL> const &inDice) override;
@@ -21,7 +21,12 @@
 #define RAINBOWDICE_GLOBAL_HPP
 
 #include <string>
+#ifdef __ANDROID__
 #include <android/native_window.h>
+#else
+// host builds (benchmarks) only need the engine core, which does not draw to a window.
+struct ANativeWindow;
+#endif
 
 typedef ANativeWindow WindowType;
 
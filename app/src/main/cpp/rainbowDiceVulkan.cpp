@@ -23,6 +23,8 @@
 #include "rainbowDiceVulkan.hpp"
 #include "TextureAtlasVulkan.h"
 #include "android.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 VkVertexInputBindingDescription getBindingDescriptionOutlineSquare() {
     VkVertexInputBindingDescription bindingDescription = {};
@@ -482,6 +484,22 @@ void RainbowDiceVulkan::cleanupSwapChain() {
 
 /* Allocate and record commands for each swap chain immage */
 void RainbowDiceVulkan::initializeCommandBuffers() {
+    /* every command buffer records the same draws, so count them once for the metrics reported
+     * each time a frame is submitted.
+     */
+    m_drawCallsPerFrame = 0;
+    m_verticesPerFrame = 0;
+    for (auto const &dice : m_dice) {
+        for (auto const &die : dice) {
+            m_drawCallsPerFrame++;
+            m_verticesPerFrame += die->nbrIndices();
+        }
+    }
+    if (m_diceBox != nullptr && !renderAllStopped()) {
+        m_drawCallsPerFrame++;
+        m_verticesPerFrame += m_diceBox->nbrIndices();
+    }
+
     /* begin recording commands into each comand buffer */
     for (size_t i = 0; i < m_swapChainCommands->size(); i++) {
         VkCommandBuffer commandBuffer = m_swapChainCommands->commandBuffer(i);
@@ -564,7 +582,7 @@ void RainbowDiceVulkan::initializeCommandBuffers() {
             }
         }
 
-        if (m_diceBox != nullptr && !allStopped()) {
+        if (m_diceBox != nullptr && !renderAllStopped()) {
             /* bind the pipeline for the dice box */
             vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                               m_graphicsPipelineDiceBox->pipeline().get());
@@ -600,6 +618,8 @@ void RainbowDiceVulkan::initializeCommandBuffers() {
 }
 
 void RainbowDiceVulkan::drawFrame() {
+    TRACE_SPAN("drawFrame");
+
     /* update the app state here */
 
     /* wait for presentation to finish before drawing the next frame.  Avoids a memory leak */
@@ -655,6 +675,8 @@ void RainbowDiceVulkan::drawFrame() {
     if (vkQueueSubmit(m_device->graphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    metrics::add(metrics::drawCalls, m_drawCallsPerFrame);
+    metrics::add(metrics::verticesDrawn, m_verticesPerFrame);
 
     /* submit the image back to the swap chain to have it eventually show up on the screen */
     VkPresentInfoKHR presentInfo = {};
@@ -677,7 +699,10 @@ void RainbowDiceVulkan::drawFrame() {
      */
     presentInfo.pResults = nullptr; // Optional
 
-    result = vkQueuePresentKHR(m_device->presentQueue(), &presentInfo);
+    {
+        TRACE_SPAN("present");
+        result = vkQueuePresentKHR(m_device->presentQueue(), &presentInfo);
+    }
 
     /* If the window surface is no longer compatible with the swap chain
      * (VK_ERROR_OUT_OF_DATE_KHR), then we need to recreate the swap chain and let the next
@@ -700,8 +725,7 @@ void RainbowDiceVulkan::updateDepthResources() {
 }
 
 std::shared_ptr<vulkan::Image> RainbowDiceVulkan::createTextureImage(uint32_t texWidth, uint32_t texHeight,
-        std::unique_ptr<unsigned char[]> const &bitmap, size_t bitmapSize) {
-    unsigned char const *buffer = bitmap.get();
+        VkFormat format, unsigned char const *buffer, size_t bitmapSize) {
     VkDeviceSize imageSize = bitmapSize;
 
     /* copy the image to CPU accessable memory in the graphics card.  Make sure that it has the
@@ -713,7 +737,6 @@ std::shared_ptr<vulkan::Image> RainbowDiceVulkan::createTextureImage(uint32_t te
 
     stagingBuffer.copyRawTo(buffer, static_cast<size_t>(imageSize));
 
-    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
     std::shared_ptr<vulkan::Image> textureImage{new vulkan::Image{m_device, texWidth, texHeight, format,
         VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT}};
@@ -732,9 +755,80 @@ std::shared_ptr<vulkan::Image> RainbowDiceVulkan::createTextureImage(uint32_t te
     textureImage->transitionImageLayout(format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                         VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_commandPool);
 
+    metrics::add(metrics::textureBytesUploaded, bitmapSize);
+
     return textureImage;
 }
 
+void RainbowDiceVulkan::updateTextureRegions(std::vector<AtlasRegion> const &regions) {
+    if (regions.empty()) {
+        return;
+    }
+
+    TRACE_SPAN("textureUpload");
+    auto const &atlas = m_texture->textureAtlas();
+    VkDeviceSize texelSize = bytesPerTexel(atlas->format());
+
+    /* the regions go one after the other in the staging buffer, each at an offset that is a
+     * multiple of 4 as vkCmdCopyBufferToImage requires.
+     */
+    std::vector<VkBufferImageCopy> copies;
+    VkDeviceSize size = 0;
+    for (auto const &region : regions) {
+        VkBufferImageCopy copy = {};
+        copy.bufferOffset = size;
+        copy.bufferRowLength = 0;
+        copy.bufferImageHeight = 0;
+        copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.imageSubresource.mipLevel = 0;
+        copy.imageSubresource.baseArrayLayer = 0;
+        copy.imageSubresource.layerCount = 1;
+        copy.imageOffset = {static_cast<int32_t>(region.x), static_cast<int32_t>(region.y), 0};
+        copy.imageExtent = {region.width, region.height, 1};
+        copies.push_back(copy);
+
+        size += (region.width * region.height * texelSize + 3) / 4 * 4;
+    }
+
+    std::vector<unsigned char> staged(size);
+    std::vector<unsigned char> texels;
+    for (size_t i = 0; i < regions.size(); i++) {
+        copyAtlasRegion(*atlas, regions[i], texels);
+        memcpy(staged.data() + copies[i].bufferOffset, texels.data(), texels.size());
+        metrics::add(metrics::textureBytesUploaded, texels.size());
+    }
+
+    vulkan::Buffer stagingBuffer{m_device, size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+    stagingBuffer.copyRawTo(staged.data(), staged.size());
+
+    /* the dice keep their descriptor sets since the image stays the same.  The image goes back
+     * to being a transfer destination for the copy.
+     */
+    VkComponentMapping components{};
+    VkFormat format = textureFormat(atlas->format(), components);
+    auto const &image = m_texture->sampler()->image();
+    image->transitionImageLayout(format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_commandPool);
+    image->copyBufferToImage(stagingBuffer, copies, m_commandPool);
+    image->transitionImageLayout(format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_commandPool);
+}
+
+VkFormat RainbowDiceVulkan::textureFormat(TextureFormat format, VkComponentMapping &components) {
+    if (format != TextureFormat::rgba8) {
+        // sample the single channel as (0, 0, 0, a) like the RGBA version of the atlas.
+        components = {VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_ZERO,
+                VK_COMPONENT_SWIZZLE_ZERO, VK_COMPONENT_SWIZZLE_R};
+        return VK_FORMAT_R8_UNORM;
+    }
+
+    components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+            VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY};
+    return VK_FORMAT_R8G8B8A8_UNORM;
+}
+
 bool RainbowDiceVulkan::updateUniformBuffer() {
     bool needsRedraw = RainbowDiceGraphics::updateUniformBuffer();
     if (needsRedraw) {
@@ -753,6 +847,24 @@ bool RainbowDiceVulkan::updateUniformBuffer() {
     return needsRedraw;
 }
 
+bool RainbowDiceVulkan::applySimulationSnapshot() {
+    bool hasNewSnapshot = RainbowDiceGraphics::applySimulationSnapshot();
+    if (hasNewSnapshot) {
+        for (auto const &dice : m_dice) {
+            for (auto const &die : dice) {
+                die->updateUniformBuffer(m_projWithPreTransform, m_view);
+            }
+        }
+
+        // get rid of the dice box while dice are stopped.
+        if (m_diceBox != nullptr && simulationSnapshot().allStopped) {
+            initializeCommandBuffers();
+        }
+    }
+
+    return hasNewSnapshot;
+}
+
 void RainbowDiceVulkan::resetToStoppedPositions(std::vector<std::vector<uint32_t>> const &upFaceIndices) {
     RainbowDiceGraphics::resetToStoppedPositions(upFaceIndices);
     for (auto const &dice : m_dice) {
@@ -765,7 +877,7 @@ void RainbowDiceVulkan::resetToStoppedPositions(std::vector<std::vector<uint32_t
     initializeCommandBuffers();
 }
 
-std::shared_ptr<DiceVulkan> RainbowDiceVulkan::createDie(std::vector<std::string> const &symbols,
+std::shared_ptr<DiceVulkan> RainbowDiceVulkan::createDie(SymbolIds const &symbols,
                                   std::vector<uint32_t> const &inRerollIndices,
                                   std::vector<float> const &color) {
     return std::make_shared<DiceVulkan>(m_device, m_texture, m_descriptorSetLayout,
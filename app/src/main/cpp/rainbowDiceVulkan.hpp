@@ -47,10 +47,12 @@
 #include "dice.hpp"
 #include "graphicsVulkan.hpp"
 #include "TextureAtlasVulkan.h"
+#include "textureAtlasManager.hpp"
 
 struct PerObjectFragmentVariables {
     int isSelected;
     float edgeWidth;
+    int isDistanceField;
 };
 
 VkVertexInputBindingDescription getBindingDescription();
@@ -229,13 +231,13 @@ public:
         UniformBufferObject ubo;
         ubo.proj = proj;
         ubo.view = view;
-        ubo.model = m_die->model();
+        ubo.model = renderModel();
         m_uniformBuffer->copyRawTo(&ubo, sizeof(ubo));
     }
 
     void updateUniformBuffer(glm::mat4 const &proj, glm::mat4 const &view) {
         updateUniformBufferVertexVariables(proj, view);
-        if (m_die->isStopped()) {
+        if (renderIsStopped()) {
             updateUniformBufferFragmentVariables();
         }
     }
@@ -243,7 +245,8 @@ public:
     void updateUniformBufferFragmentVariables() {
         PerObjectFragmentVariables fragmentVariables = {};
         fragmentVariables.isSelected = m_isSelected ? 1 : 0;
-        fragmentVariables.edgeWidth = m_die->edgeWidth();
+        fragmentVariables.edgeWidth = renderEdgeWidth();
+        fragmentVariables.isDistanceField = m_isDistanceField ? 1 : 0;
         m_uniformBufferFrag->copyRawTo(&fragmentVariables, sizeof (fragmentVariables));
     }
 
@@ -260,7 +263,7 @@ public:
                std::shared_ptr<vulkan::Buffer> const &viewPointBuffer,
                glm::mat4 const &proj,
                glm::mat4 const &view,
-               std::vector<std::string> const &symbols,
+               SymbolIds const &symbols,
                std::vector<uint32_t> const &inRerollIndices,
                std::vector<float> const &color)
             : DiceGraphics{symbols, inRerollIndices, color, texture->textureAtlas()},
@@ -269,7 +272,8 @@ public:
               m_uniformBuffer{vulkan::Buffer::createUniformBuffer(
                       m_device, sizeof (UniformBufferObject))},
               m_uniformBufferFrag{vulkan::Buffer::createUniformBuffer(
-                      m_device, sizeof (PerObjectFragmentVariables))}
+                      m_device, sizeof (PerObjectFragmentVariables))},
+              m_isDistanceField{texture->textureAtlas()->format() == TextureFormat::distanceField8}
     {
         descriptorSetLayout->updateDescriptorSet(m_uniformBuffer, viewPointBuffer,
                                                  m_uniformBufferFrag, m_descriptorSet,
@@ -288,6 +292,7 @@ private:
     std::shared_ptr<vulkan::DescriptorSet> m_descriptorSet;
     std::shared_ptr<vulkan::Buffer> m_uniformBuffer;
     std::shared_ptr<vulkan::Buffer> m_uniformBufferFrag;
+    bool m_isDistanceField;
 
     std::shared_ptr<vulkan::Buffer> createVertexBuffer(
             std::shared_ptr<vulkan::CommandPool> const &commandPool,
@@ -331,7 +336,9 @@ public:
                                                                 m_renderPass, m_depthImageView}},
               m_projWithPreTransform{},
               m_width{m_swapChain->extent().width},
-              m_height{m_swapChain->extent().height}
+              m_height{m_swapChain->extent().height},
+              m_drawCallsPerFrame{0},
+              m_verticesPerFrame{0}
     {
         setView();
         updatePerspectiveMatrix(m_swapChain->extent().width, m_swapChain->extent().height);
@@ -368,6 +375,8 @@ public:
 
     bool updateUniformBuffer() override;
 
+    bool applySimulationSnapshot() override;
+
     void recreateSwapChain(uint32_t width, uint32_t height) override;
 
     void resetToStoppedPositions(std::vector<std::vector<uint32_t>> const &symbols) override;
@@ -479,18 +488,29 @@ public:
     }
 
     void setTexture(std::shared_ptr<TextureAtlas> texture) override {
+        // only the symbols that are not in the resident atlas yet are uploaded.
+        auto update = m_atlasManager.merge(texture);
+        if (m_texture != nullptr && !update.m_rebuilt) {
+            updateTextureRegions(update.m_regions);
+            return;
+        }
+
+        TRACE_SPAN("textureUpload");
+        auto const &atlas = m_atlasManager.atlas();
+        VkComponentMapping components{};
+        VkFormat format = textureFormat(atlas->format(), components);
         std::shared_ptr<vulkan::ImageView> imgView = std::make_shared<vulkan::ImageView>(
-                createTextureImage(texture->getImageWidth(), texture->getImageHeight(),
-                                   texture->bitmap(), texture->bitmapLength()),
-                VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
+                createTextureImage(atlas->getImageWidth(), atlas->getImageHeight(), format,
+                                   atlas->bitmap(), atlas->bitmapLength()),
+                format, VK_IMAGE_ASPECT_COLOR_BIT, components);
         std::shared_ptr<vulkan::ImageSampler> imgSampler = std::make_shared<vulkan::ImageSampler>(
                 m_device, m_commandPool, imgView);
-        m_texture = std::make_shared<TextureVulkan>(std::move(texture), imgSampler);
+        m_texture = std::make_shared<TextureVulkan>(atlas, imgSampler);
     }
 
     ~RainbowDiceVulkan() override = default;
 protected:
-    std::shared_ptr<DiceVulkan> createDie(std::vector<std::string> const &symbols,
+    std::shared_ptr<DiceVulkan> createDie(SymbolIds const &symbols,
                                       std::vector<uint32_t> const &inRerollIndices,
                                       std::vector<float> const &color) override;
     std::shared_ptr<DiceVulkan> createDie(std::shared_ptr<DiceVulkan> const &inDice) override;
@@ -534,6 +554,8 @@ private:
     glm::mat4 m_projWithPreTransform;
     uint32_t m_width;
     uint32_t m_height;
+    uint64_t m_drawCallsPerFrame;
+    uint64_t m_verticesPerFrame;
 
     /* return the preTransform matrix.  Perform this transform after all other matrices have been applied.
      * It matches what we would promise the hardware we would do.
@@ -594,7 +616,10 @@ private:
     void initializeCommandBuffers();
     void updateDepthResources();
     std::shared_ptr<vulkan::Image> createTextureImage(uint32_t texWidth, uint32_t texHeight,
-                                                      std::unique_ptr<unsigned char[]> const &bitmap,
+                                                      VkFormat format,
+                                                      unsigned char const *bitmap,
                                                       size_t bitmapSize);
+    void updateTextureRegions(std::vector<AtlasRegion> const &regions);
+    static VkFormat textureFormat(TextureFormat format, VkComponentMapping &components);
 };
 #endif
@@ -17,60 +17,287 @@
  *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include <algorithm>
 #include <stdexcept>
-#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cerrno>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/syscall.h>
 
 #include "random.hpp"
 
-Random::~Random() {
-    if (fd != -1) {
+constexpr size_t ChaCha20Random::m_blockSize;
+constexpr size_t ChaCha20Random::m_blocksPerRefill;
+constexpr size_t ChaCha20Random::m_keySize;
+constexpr uint64_t ChaCha20Random::m_reseedInterval;
+
+namespace {
+    inline uint32_t rotateLeft(uint32_t value, int bits) {
+        return (value << bits) | (value >> (32 - bits));
+    }
+
+    inline void quarterRound(std::array<uint32_t, 16> &x, int a, int b, int c, int d) {
+        x[a] += x[b]; x[d] = rotateLeft(x[d] ^ x[a], 16);
+        x[c] += x[d]; x[b] = rotateLeft(x[b] ^ x[c], 12);
+        x[a] += x[b]; x[d] = rotateLeft(x[d] ^ x[a], 8);
+        x[c] += x[d]; x[b] = rotateLeft(x[b] ^ x[c], 7);
+    }
+
+    // fills out with random bytes from the OS.
+    void osRandomBytes(void *out, size_t length) {
+        auto bytes = static_cast<uint8_t *>(out);
+#ifdef SYS_getrandom
+        while (length > 0) {
+            long readlen = syscall(SYS_getrandom, bytes, length, 0);
+            if (readlen < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                // getrandom is not supported by this kernel, fall back to /dev/urandom.
+                break;
+            }
+            bytes += readlen;
+            length -= static_cast<size_t>(readlen);
+        }
+        if (length == 0) {
+            return;
+        }
+#endif
+        int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            throw std::runtime_error("Could not open /dev/urandom");
+        }
+        while (length > 0) {
+            ssize_t readlen = read(fd, bytes, length);
+            if (readlen <= 0) {
+                if (readlen < 0 && errno == EINTR) {
+                    continue;
+                }
+                close(fd);
+                throw std::runtime_error("Could not read enough random data");
+            }
+            bytes += readlen;
+            length -= static_cast<size_t>(readlen);
+        }
         close(fd);
     }
+
+    /* Lemire's nearly divisionless method: the high 32 bits of random * range are uniform in
+     * [0, range) once the products whose low 32 bits are below 2^32 % range are rejected.  The
+     * low bits are only below range (so the modulo needs to be computed at all) about range/2^32
+     * of the time.  next draws a new random word after a rejection.  range == 0 means the full 32
+     * bit range.
+     */
+    template<typename NextWord>
+    inline uint32_t lemire(uint32_t random, uint32_t range, NextWord const &next) {
+        if (range == 0) {
+            return random;
+        }
+
+        uint64_t product = static_cast<uint64_t>(random) * range;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < range) {
+            uint32_t threshold = (0u - range) % range;
+            while (low < threshold) {
+                product = static_cast<uint64_t>(next()) * range;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    /* The top 24 bits of random as a float in [0, 1).  Every value is exactly representable, so
+     * all 2^24 of them are equally likely and 1 can never be returned.
+     */
+    inline float unitFloat(uint32_t random) {
+        return static_cast<float>(random >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // the largest float below upperBound: lowerBound + u * range can round up to upperBound.
+    inline float floatBelow(float lowerBound, float upperBound) {
+        float range = upperBound - lowerBound;
+        if (!(range > 0) || !std::isfinite(range)) {
+            throw std::runtime_error("Invalid range for a random float.");
+        }
+        return std::nextafter(upperBound, lowerBound);
+    }
+
+    // how many random words the batch functions take from the generator at a time.
+    size_t constexpr const batchWords = 64;
+
+    ChaCha20Random &threadGenerator() {
+        static thread_local ChaCha20Random generator;
+        return generator;
+    }
+} /* namespace */
+
+ChaCha20Random::ChaCha20Random()
+        : m_key{},
+          m_counter{0},
+          m_buffer{},
+          m_position{m_buffer.size()},
+          m_bytesSinceSeed{0},
+          m_seeded{false},
+          m_deterministic{false}
+{
 }
 
-template<typename T> T Random::get() {
-    if (fd == -1) {
-        fd = open("/dev/urandom", O_RDONLY);
+void ChaCha20Random::block(std::array<uint32_t, 16> const &input, uint8_t *out) {
+    std::array<uint32_t, 16> x = input;
+    for (int i = 0; i < 10; i++) {
+        // column rounds
+        quarterRound(x, 0, 4, 8, 12);
+        quarterRound(x, 1, 5, 9, 13);
+        quarterRound(x, 2, 6, 10, 14);
+        quarterRound(x, 3, 7, 11, 15);
+        // diagonal rounds
+        quarterRound(x, 0, 5, 10, 15);
+        quarterRound(x, 1, 6, 11, 12);
+        quarterRound(x, 2, 7, 8, 13);
+        quarterRound(x, 3, 4, 9, 14);
     }
 
-    if (fd == -1) {
-        throw std::runtime_error("Could not open /dev/urandom");
+    for (size_t i = 0; i < x.size(); i++) {
+        uint32_t word = x[i] + input[i];
+        out[4 * i] = static_cast<uint8_t>(word);
+        out[4 * i + 1] = static_cast<uint8_t>(word >> 8);
+        out[4 * i + 2] = static_cast<uint8_t>(word >> 16);
+        out[4 * i + 3] = static_cast<uint8_t>(word >> 24);
     }
+}
 
-    T random;
+void ChaCha20Random::seedFromOS() {
+    osRandomBytes(m_key.data(), m_keySize);
+    m_counter = 0;
+    m_bytesSinceSeed = 0;
+    m_seeded = true;
+}
+
+void ChaCha20Random::seed(RandomSeed const &seed) {
+    static_assert(sizeof (RandomSeed) == m_keySize, "a seed is a ChaCha20 key");
+    std::memcpy(m_key.data(), seed.data(), m_keySize);
+    m_counter = 0;
+    m_bytesSinceSeed = 0;
+    m_seeded = true;
+    m_deterministic = true;
+
+    // drop whatever is left of the old key stream.
+    std::memset(m_buffer.data(), 0, m_buffer.size());
+    m_position = m_buffer.size();
+}
 
-    ssize_t readlen = read(fd, &random, sizeof (random));
+void ChaCha20Random::reseedFromOS() {
+    m_deterministic = false;
+    std::memset(m_buffer.data(), 0, m_buffer.size());
+    m_position = m_buffer.size();
+    seedFromOS();
+}
 
-    if (readlen != sizeof (random)) {
-        throw std::runtime_error("Could not read enough random data");
+void ChaCha20Random::refill() {
+    if (!m_seeded || (!m_deterministic && m_bytesSinceSeed >= m_reseedInterval)) {
+        seedFromOS();
     }
 
-    return random;
+    // "expand 32-byte k", the key, a 64 bit block counter and a 64 bit nonce (always 0, the key
+    // is never reused with the same counter).
+    std::array<uint32_t, 16> input = {
+            0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+            m_key[0], m_key[1], m_key[2], m_key[3], m_key[4], m_key[5], m_key[6], m_key[7],
+            0, 0, 0, 0};
+    for (size_t i = 0; i < m_blocksPerRefill; i++) {
+        input[12] = static_cast<uint32_t>(m_counter);
+        input[13] = static_cast<uint32_t>(m_counter >> 32);
+        block(input, m_buffer.data() + i * m_blockSize);
+        m_counter++;
+    }
+
+    // fast key erasure: the start of the new key stream becomes the key and is never handed out.
+    std::memcpy(m_key.data(), m_buffer.data(), m_keySize);
+    std::memset(m_buffer.data(), 0, m_keySize);
+    m_counter = 0;
+    m_position = m_keySize;
+    m_bytesSinceSeed += m_buffer.size();
 }
 
-unsigned int Random::getUInt(unsigned int lowerBound, unsigned int upperBound) {
-    unsigned int range = upperBound - lowerBound + 1;
-    unsigned int too_big = std::numeric_limits<unsigned int>::max() / range * range;
+void ChaCha20Random::getBytes(void *out, size_t length) {
+    auto bytes = static_cast<uint8_t *>(out);
+    while (length > 0) {
+        if (m_position == m_buffer.size()) {
+            refill();
+        }
+        size_t n = std::min(length, m_buffer.size() - m_position);
+        std::memcpy(bytes, m_buffer.data() + m_position, n);
+        // do not leave handed out random data behind in the buffer.
+        std::memset(m_buffer.data() + m_position, 0, n);
+        m_position += n;
+        bytes += n;
+        length -= n;
+    }
+}
+
+RandomSeed Random::newSeed() {
+    RandomSeed seed;
+    osRandomBytes(seed.data(), seed.size());
+    return seed;
+}
+
+void Random::seedThread(RandomSeed const &seed) {
+    threadGenerator().seed(seed);
+}
 
-    unsigned int random;
+template<typename T> T Random::get() {
+    T random;
+    threadGenerator().getBytes(&random, sizeof (random));
+    return random;
+}
 
-    do {
-        random = get<unsigned int>();
-    } while (random >= too_big);
+unsigned int Random::getUInt(unsigned int lowerBound, unsigned int upperBound) {
+    static_assert(sizeof (unsigned int) == sizeof (uint32_t), "unsigned int must be 32 bits");
+    if (upperBound < lowerBound) {
+        throw std::runtime_error("Invalid range for a random integer.");
+    }
 
-    return random % range + lowerBound;
+    uint32_t range = upperBound - lowerBound + 1;
+    return lemire(get<uint32_t>(), range, [this]() { return get<uint32_t>(); }) + lowerBound;
 }
 
 float Random::getFloat(float lowerBound, float upperBound) {
+    float below = floatBelow(lowerBound, upperBound);
     float range = upperBound - lowerBound;
-    if (range <= 0) {
-        throw std::runtime_error("Could not read enough random data.");
+    return std::min(lowerBound + unitFloat(get<uint32_t>()) * range, below);
+}
+
+void Random::getUInts(uint32_t *out, size_t count, uint32_t lowerBound, uint32_t upperBound) {
+    if (upperBound < lowerBound) {
+        throw std::runtime_error("Invalid range for a random integer.");
+    }
+
+    // the output array doubles as the buffer for the random words.
+    threadGenerator().getBytes(out, count * sizeof (uint32_t));
+
+    uint32_t range = upperBound - lowerBound + 1;
+    auto next = [this]() { return get<uint32_t>(); };
+    for (size_t i = 0; i < count; i++) {
+        out[i] = lemire(out[i], range, next) + lowerBound;
     }
+}
 
-    unsigned int random = get<unsigned int>();
-    float rc = random;
-    rc = rc / static_cast<float>(std::numeric_limits<unsigned int>::max()) * range + lowerBound;
-    return rc;
+void Random::getFloats(float *out, size_t count, float lowerBound, float upperBound) {
+    float below = floatBelow(lowerBound, upperBound);
+    float range = upperBound - lowerBound;
+
+    // The conversion loop has no branches or calls so that it gets vectorized (NEON on ARM).
+    std::array<uint32_t, batchWords> words;
+    while (count > 0) {
+        size_t n = std::min(count, words.size());
+        threadGenerator().getBytes(words.data(), n * sizeof (uint32_t));
+        for (size_t i = 0; i < n; i++) {
+            out[i] = std::min(lowerBound + unitFloat(words[i]) * range, below);
+        }
+        out += n;
+        count -= n;
+    }
+    std::memset(words.data(), 0, sizeof (words));
 }
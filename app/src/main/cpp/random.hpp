@@ -19,14 +19,82 @@
  */
 #ifndef RAINBOW_DICE_RANDOM_HPP
 #define RAINBOW_DICE_RANDOM_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// seed for a replayable stream of random numbers (a ChaCha20 key).
+using RandomSeed = std::array<uint8_t, 32>;
+
+/* ChaCha20 based cryptographically secure random number generator.  The key comes from the OS
+ * (getrandom or /dev/urandom) and the key stream is generated a large block at a time, so drawing
+ * random numbers does not need a system call.  After each refill, the key is replaced with the
+ * first 32 bytes of the new key stream so that output already handed out cannot be recovered from
+ * the state, and the key is replaced with a new one from the OS every m_reseedInterval bytes.
+ */
+class ChaCha20Random {
+public:
+    ChaCha20Random();
+
+    void getBytes(void *out, size_t length);
+
+    /* Makes the output a deterministic function of seed: the same seed always gives the same
+     * stream.  The key is not replaced from the OS while seeded.
+     */
+    void seed(RandomSeed const &seed);
+
+    // goes back to keying (and periodically rekeying) from the OS.
+    void reseedFromOS();
+
+    // the ChaCha20 block function: one 64 byte block of key stream.
+    static void block(std::array<uint32_t, 16> const &input, uint8_t *out);
+
+private:
+    static size_t constexpr const m_blockSize = 64;
+    static size_t constexpr const m_blocksPerRefill = 64;
+    static size_t constexpr const m_keySize = 32;
+    static uint64_t constexpr const m_reseedInterval = 1024 * 1024;
+
+    std::array<uint32_t, 8> m_key;
+    uint64_t m_counter;
+    std::array<uint8_t, m_blockSize * m_blocksPerRefill> m_buffer;
+    size_t m_position;
+    uint64_t m_bytesSinceSeed;
+    bool m_seeded;
+    bool m_deterministic;
+
+    void seedFromOS();
+    void refill();
+};
+
+/* Random numbers drawn from a thread local ChaCha20Random.  Creating a Random is free, there is no
+ * per object state.
+ */
 class Random {
 private:
-    int fd;
     template<typename T> T get();
 public:
-    Random() : fd(-1) { }
+    Random() = default;
+
+    // uniformly distributed in [lowerBound, upperBound].
     unsigned int getUInt(unsigned int lowerBound, unsigned int upperBound);
+
+    // uniformly distributed in [lowerBound, upperBound).
     float getFloat(float lowerBound, float upperBound);
-    ~Random();
+
+    /* Fills out with count integers uniformly distributed in [lowerBound, upperBound].  The
+     * random words for the whole batch are taken from the generator at once.
+     */
+    void getUInts(uint32_t *out, size_t count, uint32_t lowerBound, uint32_t upperBound);
+
+    // Fills out with count floats uniformly distributed in [lowerBound, upperBound).
+    void getFloats(float *out, size_t count, float lowerBound, float upperBound);
+
+    // a new seed straight from the OS.
+    static RandomSeed newSeed();
+
+    // all the random numbers drawn on this thread from now on come from seed.
+    static void seedThread(RandomSeed const &seed);
 };
-#endif
\ No newline at end of file
+#endif
@@ -20,9 +20,27 @@
 #ifndef RAINBOWDICE_TEXT_HPP
 #define RAINBOWDICE_TEXT_HPP
 #include <string>
-#include <map>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
 #include <vector>
 
+#include "distanceField.hpp"
+
+// rgba8: 4 bytes per texel.  alpha8: only the alpha channel, 1 byte per texel, for atlases where
+// every texel is transparent or black.  distanceField8: 1 byte per texel signed distance field
+// of an alpha8 atlas at a fraction of its resolution (see distanceField.hpp), sampled with linear
+// filtering.
+enum class TextureFormat {
+    rgba8,
+    alpha8,
+    distanceField8
+};
+
+inline uint32_t bytesPerTexel(TextureFormat format) {
+    return format == TextureFormat::rgba8 ? 4 : 1;
+}
+
 struct TextureImage {
     float left;
     float right;
@@ -30,28 +48,161 @@ struct TextureImage {
     float bottom;
 };
 
+/* The symbols of a die as the IDs its atlas gave them (see TextureAtlas::symbolIds).  All the dice
+ * made from one dice description share the same IDs: copying them does not copy anything.
+ */
+class SymbolIds {
+public:
+    SymbolIds()
+            : m_ids{std::make_shared<std::vector<uint32_t> const>()}
+    {
+    }
+
+    explicit SymbolIds(std::vector<uint32_t> ids)
+            : m_ids{std::make_shared<std::vector<uint32_t> const>(std::move(ids))}
+    {
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(m_ids->size()); }
+    uint32_t operator[](size_t i) const { return (*m_ids)[i]; }
+    std::vector<uint32_t>::const_iterator begin() const { return m_ids->begin(); }
+    std::vector<uint32_t>::const_iterator end() const { return m_ids->end(); }
+
+    bool operator==(SymbolIds const &other) const {
+        return m_ids == other.m_ids || *m_ids == *other.m_ids;
+    }
+    bool operator<(SymbolIds const &other) const { return *m_ids < *other.m_ids; }
+    bool operator>(SymbolIds const &other) const { return *m_ids > *other.m_ids; }
+
+private:
+    std::shared_ptr<std::vector<uint32_t> const> m_ids;
+};
+
 class TextureAtlas {
 protected:
+    // the symbols are drawn about 128 texels wide, so a quarter of that still keeps their shape.
+    static uint32_t constexpr distanceFieldDownscale = 4;
+    // in texels of the original bitmap: the field covers 2 texels of itself on each side of an edge.
+    static float constexpr distanceFieldSpread = 8.0f;
+
+
     uint32_t m_width;
     uint32_t m_height;
-    std::map<std::string, TextureImage> m_textureImages;
-    std::unique_ptr<unsigned char[]> m_bitmap;
+    // m_symbols and m_textureImages are indexed by symbol ID.  The IDs are given out in the order
+    // the symbols are added, starting at 0.
+    std::vector<std::string> m_symbols;
+    std::vector<TextureImage> m_textureImages;
+    std::unordered_map<std::string, uint32_t> m_symbolIds;
+    // owns the bitmap or, for an atlas read from the cache, the file mapping it lies in.
+    std::shared_ptr<unsigned char const> m_bitmap;
     uint32_t m_bitmapLength;
+    TextureFormat m_format;
+
+    /* The shaders only tell apart transparent texels, black texels and coloured texels.  When
+     * there are no coloured texels (the symbols are drawn in black), the alpha channel holds
+     * everything the shaders need, so the RGBA bitmap is packed down to it.
+     */
+    void packIfMonochrome() {
+        size_t nbrTexels = static_cast<size_t>(m_width) * m_height;
+        if (m_bitmap == nullptr || m_bitmapLength != 4 * nbrTexels) {
+            return;
+        }
+
+        unsigned char const *rgba = m_bitmap.get();
+        for (size_t i = 0; i < nbrTexels; i++) {
+            unsigned char const *texel = rgba + 4 * i;
+            if (texel[3] != 0 && (texel[0] | texel[1] | texel[2]) != 0) {
+                return;
+            }
+        }
+
+        auto alpha = std::make_unique<unsigned char[]>(nbrTexels);
+        for (size_t i = 0; i < nbrTexels; i++) {
+            alpha[i] = rgba[4 * i + 3];
+        }
+        m_bitmap = std::shared_ptr<unsigned char const>(alpha.release(),
+                std::default_delete<unsigned char[]>());
+        m_bitmapLength = static_cast<uint32_t>(nbrTexels);
+        m_format = TextureFormat::alpha8;
+    }
+
+    /* Replaces an alpha8 atlas with its distance field.  The field is smaller than the
+     * original by distanceFieldDownscale in each direction, rounded up, so the texture
+     * coordinates are scaled to keep pointing at the same part of the image.
+     */
+    void convertToDistanceField() {
+        if (m_format != TextureFormat::alpha8) {
+            return;
+        }
+
+        DistanceField field = signedDistanceField(m_bitmap.get(), m_width, m_height,
+                distanceFieldDownscale, distanceFieldSpread);
+        float scaleX = static_cast<float>(m_width) / (field.m_width * distanceFieldDownscale);
+        float scaleY = static_cast<float>(m_height) / (field.m_height * distanceFieldDownscale);
+        for (auto &image : m_textureImages) {
+            image.left *= scaleX;
+            image.right *= scaleX;
+            image.top *= scaleY;
+            image.bottom *= scaleY;
+        }
+
+        m_width = field.m_width;
+        m_height = field.m_height;
+        m_bitmap = std::shared_ptr<unsigned char const>(field.m_bitmap.release(),
+                std::default_delete<unsigned char[]>());
+        m_bitmapLength = m_width * m_height;
+        m_format = TextureFormat::distanceField8;
+    }
+
+    // returns the ID of symbol, giving it the next one if it does not have one yet.
+    uint32_t intern(std::string const &symbol) {
+        auto inserted = m_symbolIds.emplace(symbol, static_cast<uint32_t>(m_symbols.size()));
+        if (inserted.second) {
+            m_symbols.push_back(symbol);
+            m_textureImages.push_back(TextureImage{});
+        }
+        return inserted.first->second;
+    }
 
 public:
     TextureAtlas(std::vector<std::string> const &symbols, uint32_t inWidth, uint32_t inHeightTexture,
                  std::vector<std::pair<float, float>> const &inLeftRightTextureCoordinate,
                  std::vector<std::pair<float, float>> const &inTopBottomTextureCoordinate,
                  std::unique_ptr<unsigned char[]> &&inBitmap, uint32_t inBitmapLength)
-            : m_width(inWidth), m_height(inHeightTexture), m_textureImages(),
-              m_bitmap{std::move(inBitmap)}, m_bitmapLength{inBitmapLength}
+            : m_width(inWidth), m_height(inHeightTexture), m_symbols{}, m_textureImages{},
+              m_symbolIds{},
+              m_bitmap{inBitmap.release(), std::default_delete<unsigned char[]>()},
+              m_bitmapLength{inBitmapLength},
+              m_format{TextureFormat::rgba8}
     {
+        packIfMonochrome();
+
         for (uint32_t i=0; i < symbols.size(); i++) {
             TextureImage tex = { inLeftRightTextureCoordinate[i].first,
                                  inLeftRightTextureCoordinate[i].second,
                                  inTopBottomTextureCoordinate[i].first,
                                  inTopBottomTextureCoordinate[i].second };
-            m_textureImages.insert(std::make_pair(symbols[i], tex));
+            // the first one wins if a symbol is there twice.
+            if (m_symbolIds.count(symbols[i]) == 0) {
+                m_textureImages[intern(symbols[i])] = tex;
+            }
+        }
+
+        convertToDistanceField();
+    }
+
+    // An atlas that was already converted, e.g. one read back from the atlas cache.
+    TextureAtlas(uint32_t inWidth, uint32_t inHeight, TextureFormat inFormat,
+                 std::vector<std::string> const &symbols,
+                 std::vector<TextureImage> const &textureImages,
+                 std::shared_ptr<unsigned char const> inBitmap, uint32_t inBitmapLength)
+            : m_width(inWidth), m_height(inHeight), m_symbols{}, m_textureImages{},
+              m_symbolIds{},
+              m_bitmap{std::move(inBitmap)}, m_bitmapLength{inBitmapLength},
+              m_format{inFormat}
+    {
+        for (uint32_t i = 0; i < symbols.size(); i++) {
+            m_textureImages[intern(symbols[i])] = textureImages[i];
         }
     }
 
@@ -61,9 +212,9 @@ public:
         return (uint32_t)m_textureImages.size();
     }
 
-    TextureImage getTextureCoordinates(std::string const &symbol) {
-        auto it = m_textureImages.find(symbol);
-        if (it == m_textureImages.end()) {
+    uint32_t symbolId(std::string const &symbol) {
+        auto it = m_symbolIds.find(symbol);
+        if (it == m_symbolIds.end()) {
             // shouldn't happen
             throw std::runtime_error(std::string("Texture not found for symbol: ") + symbol);
         }
@@ -71,14 +222,40 @@ public:
         return it->second;
     }
 
-    std::unique_ptr<unsigned char[]> const &bitmap() {
-        return m_bitmap;
+    // the IDs of the symbols of a die.  Done once per dice description, the dice models only
+    // use the IDs.
+    SymbolIds symbolIds(std::vector<std::string> const &symbols) {
+        std::vector<uint32_t> ids;
+        ids.reserve(symbols.size());
+        for (auto const &symbol : symbols) {
+            ids.push_back(symbolId(symbol));
+        }
+        return SymbolIds{std::move(ids)};
+    }
+
+    TextureImage const &getTextureCoordinates(uint32_t symbolId) {
+        return m_textureImages[symbolId];
+    }
+
+    unsigned char const *bitmap() {
+        return m_bitmap.get();
     }
 
     uint32_t bitmapLength() {
         return m_bitmapLength;
     }
 
+    TextureFormat format() { return m_format; }
+
+    // the symbols by ID.
+    std::vector<std::string> const &symbols() { return m_symbols; }
+
+    // for TextureAtlasManager, which adds symbols to an atlas in place.  The IDs of the symbols
+    // already in the atlas do not change.
+    void addTextureImage(std::string const &symbol, TextureImage const &image) {
+        m_textureImages[intern(symbol)] = image;
+    }
+
     ~TextureAtlas() = default;
 };
 #endif
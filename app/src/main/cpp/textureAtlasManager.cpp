@@ -0,0 +1,266 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "textureAtlasManager.hpp"
+
+constexpr uint32_t TextureAtlasManager::m_padding;
+constexpr uint32_t TextureAtlasManager::m_maxDimension;
+
+bool ShelfPacker::allocate(uint32_t width, uint32_t height, AtlasRegion &region) {
+    if (width > m_width || height > m_height) {
+        return false;
+    }
+
+    Shelf *best = nullptr;
+    for (auto &shelf : m_shelves) {
+        if (shelf.m_height >= height && m_width - shelf.m_used >= width &&
+            (best == nullptr || shelf.m_height < best->m_height)) {
+            best = &shelf;
+        }
+    }
+
+    if (best == nullptr) {
+        if (m_height - m_top < height) {
+            return false;
+        }
+        m_shelves.push_back(Shelf{m_top, height, 0});
+        m_top += height;
+        best = &m_shelves.back();
+    }
+
+    region = AtlasRegion{best->m_used, best->m_y, width, height};
+    best->m_used += width;
+    return true;
+}
+
+void copyAtlasRegion(TextureAtlas &atlas, AtlasRegion const &region, std::vector<unsigned char> &out) {
+    size_t texelSize = bytesPerTexel(atlas.format());
+    size_t rowLength = region.width * texelSize;
+    size_t stride = atlas.getImageWidth() * texelSize;
+    out.resize(rowLength * region.height);
+    unsigned char const *src = atlas.bitmap() + region.y * stride + region.x * texelSize;
+    for (uint32_t row = 0; row < region.height; row++) {
+        memcpy(out.data() + row * rowLength, src + row * stride, rowLength);
+    }
+}
+
+TextureAtlasManager::Update TextureAtlasManager::merge(std::shared_ptr<TextureAtlas> const &atlas) {
+    Update update{false, {}};
+    if (m_lastMerged.lock() == atlas) {
+        return update;
+    }
+    m_lastMerged = atlas;
+
+    update.m_rebuilt = true;
+    if (!m_isPacked || m_atlas == nullptr || atlas->format() != m_atlas->format()) {
+        rebuild(atlas, 0);
+        return update;
+    }
+
+    std::vector<std::pair<std::string const *, SymbolImage>> added;
+    for (uint32_t id = 0; id < atlas->getNbrImages(); id++) {
+        std::string const &symbol = atlas->symbols()[id];
+        SymbolImage image = symbolImage(*atlas, atlas->getTextureCoordinates(id));
+        auto it = m_images.find(symbol);
+        if (it == m_images.end()) {
+            added.emplace_back(&symbol, image);
+        } else if (!isResident(*atlas, image, it->second)) {
+            // the symbol is drawn differently now: its old slot may not be big enough.
+            rebuild(atlas, 0);
+            return update;
+        }
+    }
+
+    // allocate in a copy so that the packer is left as it was if the symbols do not all fit.
+    ShelfPacker packer = m_packer;
+    std::vector<AtlasRegion> slots;
+    slots.reserve(added.size());
+    for (auto const &symbol : added) {
+        AtlasRegion slot{};
+        if (!packer.allocate(symbol.second.m_texels.width + 2 * m_padding,
+                             symbol.second.m_texels.height + 2 * m_padding, slot)) {
+            // grow by more than the new symbols need so that it does not fill up again soon.
+            rebuild(atlas, m_atlas->getImageWidth() * 3 / 2);
+            return update;
+        }
+        slots.push_back(slot);
+    }
+    m_packer = packer;
+
+    update.m_rebuilt = false;
+    for (size_t i = 0; i < added.size(); i++) {
+        update.m_regions.push_back(place(*atlas, *added[i].first, added[i].second, slots[i]));
+    }
+    return update;
+}
+
+TextureAtlasManager::SymbolImage TextureAtlasManager::symbolImage(
+        TextureAtlas &atlas, TextureImage const &image)
+{
+    float width = atlas.getImageWidth();
+    float height = atlas.getImageHeight();
+    float left = image.left * width;
+    float right = image.right * width;
+    float top = image.top * height;
+    float bottom = image.bottom * height;
+
+    auto x0 = static_cast<uint32_t>(std::max(0.0f, std::floor(std::min(left, right))));
+    auto x1 = static_cast<uint32_t>(std::min(width, std::ceil(std::max(left, right))));
+    auto y0 = static_cast<uint32_t>(std::max(0.0f, std::floor(std::min(top, bottom))));
+    auto y1 = static_cast<uint32_t>(std::min(height, std::ceil(std::max(top, bottom))));
+
+    return SymbolImage{AtlasRegion{x0, y0, std::max(x0, x1) - x0, std::max(y0, y1) - y0},
+                       left - x0, right - x0, top - y0, bottom - y0};
+}
+
+bool TextureAtlasManager::isResident(TextureAtlas &atlas, SymbolImage const &image,
+                                     SymbolImage const &resident)
+{
+    float constexpr tolerance = 0.01f;
+    if (image.m_texels.width != resident.m_texels.width ||
+        image.m_texels.height != resident.m_texels.height ||
+        std::fabs(image.m_left - resident.m_left) > tolerance ||
+        std::fabs(image.m_right - resident.m_right) > tolerance ||
+        std::fabs(image.m_top - resident.m_top) > tolerance ||
+        std::fabs(image.m_bottom - resident.m_bottom) > tolerance) {
+        return false;
+    }
+
+    size_t texelSize = bytesPerTexel(atlas.format());
+    size_t rowLength = image.m_texels.width * texelSize;
+    size_t stride = atlas.getImageWidth() * texelSize;
+    size_t residentStride = m_atlas->getImageWidth() * texelSize;
+    unsigned char const *src = atlas.bitmap() + image.m_texels.y * stride +
+            image.m_texels.x * texelSize;
+    unsigned char const *dst = m_pixels.get() + resident.m_texels.y * residentStride +
+            resident.m_texels.x * texelSize;
+    for (uint32_t row = 0; row < image.m_texels.height; row++) {
+        if (memcmp(src + row * stride, dst + row * residentStride, rowLength) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TextureAtlasManager::rebuild(std::shared_ptr<TextureAtlas> const &atlas, uint32_t minWidth) {
+    m_generation++;
+
+    std::vector<std::pair<std::string const *, SymbolImage>> symbols;
+    uint64_t area = 0;
+    uint32_t widest = 0;
+    for (uint32_t id = 0; id < atlas->getNbrImages(); id++) {
+        SymbolImage image = symbolImage(*atlas, atlas->getTextureCoordinates(id));
+        uint32_t width = image.m_texels.width + 2 * m_padding;
+        uint32_t height = image.m_texels.height + 2 * m_padding;
+        area += static_cast<uint64_t>(width) * height;
+        widest = std::max(widest, width);
+        symbols.emplace_back(&atlas->symbols()[id], image);
+    }
+
+    // tallest first packs the shelves tighter.
+    std::stable_sort(symbols.begin(), symbols.end(),
+            [](std::pair<std::string const *, SymbolImage> const &a,
+               std::pair<std::string const *, SymbolImage> const &b) {
+                return a.second.m_texels.height > b.second.m_texels.height;
+            });
+
+    // leave about as much room again for symbols added later.
+    auto side = static_cast<uint32_t>(std::ceil(std::sqrt(2.0 * area)));
+    side = std::max(side, minWidth);
+    uint32_t width = std::max<uint32_t>({64, widest, (side + 63) / 64 * 64});
+    if (width > m_maxDimension) {
+        useAsIs(atlas);
+        return;
+    }
+
+    for (uint32_t height = width; height <= m_maxDimension; height *= 2) {
+        ShelfPacker packer{width, height};
+        std::vector<AtlasRegion> slots;
+        slots.reserve(symbols.size());
+        for (auto const &symbol : symbols) {
+            AtlasRegion slot{};
+            if (!packer.allocate(symbol.second.m_texels.width + 2 * m_padding,
+                                 symbol.second.m_texels.height + 2 * m_padding, slot)) {
+                break;
+            }
+            slots.push_back(slot);
+        }
+        if (slots.size() != symbols.size()) {
+            continue;
+        }
+
+        size_t length = static_cast<size_t>(width) * height * bytesPerTexel(atlas->format());
+        m_pixels = std::shared_ptr<unsigned char>(new unsigned char[length](),
+                std::default_delete<unsigned char[]>());
+        m_atlas = std::make_shared<TextureAtlas>(width, height, atlas->format(),
+                std::vector<std::string>{}, std::vector<TextureImage>{}, m_pixels,
+                static_cast<uint32_t>(length));
+        m_packer = packer;
+        m_images.clear();
+        m_isPacked = true;
+        for (size_t i = 0; i < symbols.size(); i++) {
+            place(*atlas, *symbols[i].first, symbols[i].second, slots[i]);
+        }
+        return;
+    }
+
+    useAsIs(atlas);
+}
+
+void TextureAtlasManager::useAsIs(std::shared_ptr<TextureAtlas> const &atlas) {
+    // too big to pack with room to spare.  The next merge packs from scratch again.
+    m_atlas = atlas;
+    m_pixels.reset();
+    m_packer = ShelfPacker{0, 0};
+    m_images.clear();
+    m_isPacked = false;
+}
+
+AtlasRegion TextureAtlasManager::place(TextureAtlas &atlas, std::string const &symbol,
+                                       SymbolImage const &image, AtlasRegion const &slot)
+{
+    AtlasRegion region{slot.x + m_padding, slot.y + m_padding, image.m_texels.width,
+                       image.m_texels.height};
+
+    size_t texelSize = bytesPerTexel(atlas.format());
+    size_t rowLength = region.width * texelSize;
+    size_t stride = atlas.getImageWidth() * texelSize;
+    size_t residentStride = m_atlas->getImageWidth() * texelSize;
+    unsigned char const *src = atlas.bitmap() + image.m_texels.y * stride +
+            image.m_texels.x * texelSize;
+    unsigned char *dst = m_pixels.get() + region.y * residentStride + region.x * texelSize;
+    for (uint32_t row = 0; row < region.height; row++) {
+        memcpy(dst + row * residentStride, src + row * stride, rowLength);
+    }
+
+    float width = m_atlas->getImageWidth();
+    float height = m_atlas->getImageHeight();
+    m_atlas->addTextureImage(symbol, TextureImage{(region.x + image.m_left) / width,
+                                                  (region.x + image.m_right) / width,
+                                                  (region.y + image.m_top) / height,
+                                                  (region.y + image.m_bottom) / height});
+    m_images[symbol] = SymbolImage{region, image.m_left, image.m_right, image.m_top,
+                                   image.m_bottom};
+    return region;
+}
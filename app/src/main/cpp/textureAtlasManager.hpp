@@ -0,0 +1,145 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_TEXTURE_ATLAS_MANAGER_HPP
+#define RAINBOWDICE_TEXTURE_ATLAS_MANAGER_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "text.hpp"
+
+// A rectangle of texels in an atlas.
+struct AtlasRegion {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+/* Packs rectangles into horizontal shelves.  A rectangle goes on the lowest shelf it fits on
+ * (the one that wastes the least height), or on a new shelf at the bottom.  Rectangles are never
+ * freed: the space is only reclaimed by packing again from scratch.
+ */
+class ShelfPacker {
+public:
+    ShelfPacker(uint32_t width, uint32_t height)
+            : m_width{width},
+              m_height{height},
+              m_top{0},
+              m_shelves{}
+    {
+    }
+
+    // Finds room for a width by height rectangle.  Returns false if there is none.
+    bool allocate(uint32_t width, uint32_t height, AtlasRegion &region);
+
+private:
+    struct Shelf {
+        uint32_t m_y;
+        uint32_t m_height;
+        uint32_t m_used;
+    };
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_top;
+    std::vector<Shelf> m_shelves;
+};
+
+/* Keeps one resident atlas for the renderer that only grows while it can.  Each symbol's image is
+ * copied out of the atlas Java sent into its own slot in the resident atlas, where it stays: the
+ * texture coordinates of a symbol do not change until the resident atlas is rebuilt.  So when
+ * the symbols change, only the slots of the new symbols have to be uploaded, and the dice whose
+ * symbols were already there keep their models and vertex buffers.
+ *
+ * The resident atlas is rebuilt (packed from scratch with only the symbols of the new atlas)
+ * when the format changes, when a symbol's image changes (e.g. the aspect ratio did) or when
+ * there is no room left for the new symbols.  The renderer only calls it on its own thread.
+ */
+class TextureAtlasManager {
+public:
+    struct Update {
+        // the resident atlas is new: upload all of it.  Its texture coordinates are new too.
+        bool m_rebuilt;
+        // otherwise, the regions of the resident atlas to upload.
+        std::vector<AtlasRegion> m_regions;
+    };
+
+    TextureAtlasManager()
+            : m_lastMerged{},
+              m_atlas{},
+              m_pixels{},
+              m_packer{0, 0},
+              m_isPacked{false},
+              m_images{},
+              m_generation{0}
+    {
+    }
+
+    // Adds the symbols of atlas to the resident atlas.
+    Update merge(std::shared_ptr<TextureAtlas> const &atlas);
+
+    // The resident atlas: the one to upload and build dice models with.
+    std::shared_ptr<TextureAtlas> const &atlas() { return m_atlas; }
+
+    // Changes every time the resident atlas is rebuilt.
+    uint64_t generation() { return m_generation; }
+
+private:
+    // the empty texels around each slot, so that linear filtering does not pick up a neighbour.
+    static uint32_t constexpr m_padding = 1;
+    // the largest resident atlas.  Larger atlases are used as Java sent them.
+    static uint32_t constexpr m_maxDimension = 4096;
+
+    // The texels covering a symbol in an atlas and where its edges lie in them, in texels from
+    // the top left corner of m_texels.
+    struct SymbolImage {
+        AtlasRegion m_texels;
+        float m_left;
+        float m_right;
+        float m_top;
+        float m_bottom;
+    };
+
+    std::weak_ptr<TextureAtlas> m_lastMerged;
+    std::shared_ptr<TextureAtlas> m_atlas;
+    // the bitmap of m_atlas, writable.
+    std::shared_ptr<unsigned char> m_pixels;
+    ShelfPacker m_packer;
+    // false if m_atlas is an atlas from Java used as it is.
+    bool m_isPacked;
+    std::map<std::string, SymbolImage> m_images;
+    uint64_t m_generation;
+
+    static SymbolImage symbolImage(TextureAtlas &atlas, TextureImage const &image);
+    bool isResident(TextureAtlas &atlas, SymbolImage const &image, SymbolImage const &resident);
+    void rebuild(std::shared_ptr<TextureAtlas> const &atlas, uint32_t minWidth);
+    void useAsIs(std::shared_ptr<TextureAtlas> const &atlas);
+    AtlasRegion place(TextureAtlas &atlas, std::string const &symbol, SymbolImage const &image,
+                      AtlasRegion const &slot);
+};
+
+// Copies the texels of region out of atlas with the rows packed together.
+void copyAtlasRegion(TextureAtlas &atlas, AtlasRegion const &region, std::vector<unsigned char> &out);
+
+#endif // RAINBOWDICE_TEXTURE_ATLAS_MANAGER_HPP
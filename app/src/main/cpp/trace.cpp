@@ -0,0 +1,104 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace trace {
+    std::atomic<bool> g_enabled{false};
+
+    // The buffers of all threads that have ever recorded a span.  The buffers are kept after the
+    // thread exits so that its spans can still be dumped.  The lock is only taken when a thread
+    // records its first span and when dumping.
+    static std::mutex g_registryLock;
+    static std::vector<std::shared_ptr<ThreadBuffer>> g_registry;
+
+    void setEnabled(bool enable) {
+        g_enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    ThreadBuffer &threadBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (buffer == nullptr) {
+            std::unique_lock<std::mutex> lock(g_registryLock);
+            buffer = std::make_shared<ThreadBuffer>(static_cast<uint32_t>(g_registry.size() + 1));
+            g_registry.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    static void writeJsonString(std::ofstream &out, char const *str) {
+        out << '"';
+        for (char const *c = str; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << '"';
+    }
+
+    void dumpChromeJson(std::string const &path) {
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::unique_lock<std::mutex> lock(g_registryLock);
+            buffers = g_registry;
+        }
+
+        std::ofstream out(path, std::ios::out | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error(std::string("Could not open trace file: ") + path);
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (auto const &buffer : buffers) {
+            uint64_t end = buffer->next();
+            uint64_t begin = end > ThreadBuffer::m_size ? end - ThreadBuffer::m_size : 0;
+            for (uint64_t i = begin; i < end; i++) {
+                Span span{};
+                if (!buffer->read(i, span)) {
+                    continue;
+                }
+                if (!first) {
+                    out << ",";
+                }
+                first = false;
+
+                // Chrome trace timestamps are in microseconds.
+                out << "\n{\"name\":";
+                writeJsonString(out, span.name);
+                out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId()
+                    << ",\"ts\":" << span.startNs / 1000 << "." << (span.startNs % 1000) / 100
+                    << ",\"dur\":" << span.durationNs / 1000 << "." << (span.durationNs % 1000) / 100
+                    << "}";
+            }
+        }
+        out << "\n]}\n";
+
+        if (!out) {
+            throw std::runtime_error(std::string("Could not write trace file: ") + path);
+        }
+    }
+} /* namespace trace */
@@ -0,0 +1,152 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_TRACE_HPP
+#define RAINBOWDICE_TRACE_HPP
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* A lightweight scoped span tracer for seeing where frame time goes.
+ *
+ * Usage: put TRACE_SPAN("name") at the top of a scope.  The span covers the rest of the scope.  The
+ * name must be a string literal (only the pointer is stored).
+ *
+ * Each thread writes its spans into its own fixed size ring buffer without taking any locks (the
+ * oldest spans are overwritten).  Spans are only recorded while tracing is enabled at run time
+ * (trace::setEnabled), and the whole tracer compiles away unless CQ_ENABLE_TRACING is defined.
+ * trace::dumpChromeJson writes the recorded spans in the Chrome trace event JSON format, which can be
+ * opened in chrome://tracing or the Perfetto UI.
+ */
+namespace trace {
+    struct Span {
+        char const *name;
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    class ThreadBuffer {
+    public:
+        static size_t constexpr const m_size = 4096; // must be a power of 2
+
+        explicit ThreadBuffer(uint32_t inThreadId)
+                : m_threadId{inThreadId},
+                  m_spans{},
+                  m_next{0}
+        {
+            for (auto &slot : m_spans) {
+                slot.sequence.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // only called from the owning thread.
+        void record(char const *name, uint64_t startNs, uint64_t durationNs) {
+            uint64_t index = m_next.load(std::memory_order_relaxed);
+            Slot &slot = m_spans[index & (m_size - 1)];
+
+            // mark the slot as being written so that a concurrent reader skips it.
+            slot.sequence.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot.name = name;
+            slot.startNs = startNs;
+            slot.durationNs = durationNs;
+            slot.sequence.store(index + 1, std::memory_order_release);
+            m_next.store(index + 1, std::memory_order_release);
+        }
+
+        // may be called from any thread.  Returns false if the slot was being overwritten.
+        bool read(uint64_t index, Span &span) const {
+            Slot const &slot = m_spans[index & (m_size - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+                return false;
+            }
+            span.name = slot.name;
+            span.startNs = slot.startNs;
+            span.durationNs = slot.durationNs;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return slot.sequence.load(std::memory_order_relaxed) == index + 1;
+        }
+
+        uint64_t next() const { return m_next.load(std::memory_order_acquire); }
+        uint32_t threadId() const { return m_threadId; }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> sequence;
+            char const *name;
+            uint64_t startNs;
+            uint64_t durationNs;
+        };
+
+        uint32_t m_threadId;
+        std::array<Slot, m_size> m_spans;
+        std::atomic<uint64_t> m_next;
+    };
+
+    extern std::atomic<bool> g_enabled;
+
+    inline bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enable);
+
+    inline uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // returns the calling thread's buffer, creating and registering it on first use.
+    ThreadBuffer &threadBuffer();
+
+    // Writes all the recorded spans to the file in the Chrome trace event JSON format.  Throws on
+    // failure.
+    void dumpChromeJson(std::string const &path);
+
+    class ScopedSpan {
+    public:
+        explicit ScopedSpan(char const *name)
+                : m_name{name},
+                  m_start{enabled() ? nowNs() : 0}
+        {}
+
+        ~ScopedSpan() {
+            if (m_start != 0 && enabled()) {
+                threadBuffer().record(m_name, m_start, nowNs() - m_start);
+            }
+        }
+
+        ScopedSpan(ScopedSpan const &) = delete;
+        ScopedSpan &operator=(ScopedSpan const &) = delete;
+    private:
+        char const *m_name;
+        uint64_t m_start;
+    };
+} /* namespace trace */
+
+#define TRACE_CONCAT_INNER(a, b) a ## b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef CQ_ENABLE_TRACING
+#define TRACE_SPAN(name) trace::ScopedSpan TRACE_CONCAT(traceSpan, __LINE__){name}
+#else
+#define TRACE_SPAN(name) do {} while (0)
+#endif
+
+#endif // RAINBOWDICE_TRACE_HPP
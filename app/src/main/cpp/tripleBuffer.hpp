@@ -0,0 +1,73 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef RAINBOWDICE_TRIPLE_BUFFER_HPP
+#define RAINBOWDICE_TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/* Lock-free triple buffer for passing the latest value from one writer thread to one reader thread.
+ * The writer fills in back() and calls publish().  The reader calls acquire() and, if it returns
+ * true, reads the newly published value from front().  The writer never waits for the reader and
+ * the reader always gets the most recently published value; values published in between are
+ * skipped.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+            : m_buffers{},
+              m_back{0},
+              m_shared{1},
+              m_front{2}
+    {}
+
+    // writer thread only
+    T &back() { return m_buffers[m_back]; }
+
+    // writer thread only: makes the back buffer available to the reader.
+    void publish() {
+        m_back = m_shared.exchange(m_back | m_dirty, std::memory_order_acq_rel) & m_indexMask;
+    }
+
+    // reader thread only: returns true if a new value was published since the last acquire.
+    bool acquire() {
+        if ((m_shared.load(std::memory_order_relaxed) & m_dirty) == 0) {
+            return false;
+        }
+        m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & m_indexMask;
+        return true;
+    }
+
+    // reader thread only
+    T const &front() const { return m_buffers[m_front]; }
+
+private:
+    static uint32_t constexpr const m_dirty = 0x4;
+    static uint32_t constexpr const m_indexMask = 0x3;
+
+    std::array<T, 3> m_buffers;
+    uint32_t m_back;
+    std::atomic<uint32_t> m_shared;
+    uint32_t m_front;
+};
+
+#endif // RAINBOWDICE_TRIPLE_BUFFER_HPP
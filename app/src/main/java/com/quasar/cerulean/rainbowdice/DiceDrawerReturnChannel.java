@@ -25,7 +25,11 @@ import android.os.Handler;
 import android.os.Message;
 import android.view.ScaleGestureDetector;
 
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.IntBuffer;
 import java.util.ArrayList;
+import java.util.HashMap;
 
 public class DiceDrawerReturnChannel {
     public static final String errorMsg = "drawerError";
@@ -34,6 +38,8 @@ public class DiceDrawerReturnChannel {
     public static final String diceConfigMsg = "diceConfig";
     public static final String fileNameMsg = "diceFileName";
     public static final String isModifiedRollMsg = "isModifiedRoll";
+    public static final String rollSeedMsg = "rollSeed";
+    public static final String runningTotalMsg = "runningTotal";
 
     public static final String hasLinearAccelerationType = "hasLinearAcceleration";
     public static final String hasGravityType = "hasGravity";
@@ -45,80 +51,144 @@ public class DiceDrawerReturnChannel {
 
     public static final String diceSelected = "diceSelected";
 
-    private DiceDrawerMessage m_msgBeingBuilt;
-    private ArrayList<DieConfiguration> m_dice;
+    // the native code writes the results of each roll here, it is reused for every roll.
+    private ByteBuffer m_resultBuffer;
     private Handler m_notify;
-    private String m_diceName;
-    private boolean m_isModifiedRoll;
+
+    // the running total of the dice that have landed so far in the roll being drawn.
+    private int m_settledConfigurationId;
+    private DieConfiguration[] m_settledGroups;
+    private int m_constantsTotal;
+    private HashMap<Long, Integer> m_settledValues;
+    private int m_runningTotal;
 
     public DiceDrawerReturnChannel(Handler inNotify) {
         m_notify = inNotify;
-        m_msgBeingBuilt = null;
-        m_dice = null;
-        m_diceName = null;
-        m_isModifiedRoll = false;
+        m_resultBuffer = null;
+        m_settledConfigurationId = -1;
+        m_settledGroups = null;
+        m_constantsTotal = 0;
+        m_settledValues = new HashMap<>();
+        m_runningTotal = 0;
     }
 
-    public void addResult(int[] indices) {
-        if (m_msgBeingBuilt == null) {
-            m_msgBeingBuilt = new DiceDrawerMessage();
+    // Returns a direct buffer of at least size bytes for the native code to write results into.
+    public ByteBuffer resultBuffer(int size) {
+        if (m_resultBuffer == null || m_resultBuffer.capacity() < size) {
+            int capacity = m_resultBuffer == null ? size :
+                    Math.max(size, 2 * m_resultBuffer.capacity());
+            m_resultBuffer = ByteBuffer.allocateDirect(capacity).order(ByteOrder.nativeOrder());
         }
-
-        m_msgBeingBuilt.addResult(indices);
+        return m_resultBuffer;
     }
 
-    public void addResult(int index) {
-        if (m_msgBeingBuilt == null) {
-            m_msgBeingBuilt = new DiceDrawerMessage();
+    // The results are in the result buffer as ints: the number of dice, an offset into the faces
+    // for each die and one past the last die, then the faces each die and its rerolls landed on.
+    // configurationId: the ID Draw gave the dice configuration that was rolled.
+    // rollSeed: the seed the roll was made with.  Passing it to Draw.startDrawingRoll replays it.
+    public void sendResults(String diceName, int configurationId, boolean isModifiedRoll,
+                            byte[] rollSeed) {
+        IntBuffer results = m_resultBuffer.asIntBuffer();
+        int nbrDice = results.get(0);
+        DieConfiguration[] dice = Draw.configurationForId(configurationId);
+        if (nbrDice == 0 || dice == null) {
+            // no dice or the configuration was replaced by newer rolls before these results came
+            // back.
+            return;
         }
 
-        m_msgBeingBuilt.addResult(index);
-    }
-
-    public void addDice(int nbrDice, String[] symbols, Integer[] values, int[] rerollIndices,
-                        float[] color, boolean isAddOperation) {
-        if (m_dice == null) {
-            m_dice = new ArrayList<>();
+        int facesStart = 1 + nbrDice + 1;
+        DiceDrawerMessage diceResults = new DiceDrawerMessage();
+        for (int i = 0; i < nbrDice; i++) {
+            int begin = results.get(1 + i);
+            int end = results.get(2 + i);
+            int[] faces = new int[end - begin];
+            results.position(facesStart + begin);
+            results.get(faces);
+            diceResults.addResult(faces);
         }
 
-        if (color.length == 4) {
-            m_dice.add(new DieConfiguration(nbrDice, symbols, values, rerollIndices, color, isAddOperation));
-        } else {
-            m_dice.add(new DieConfiguration(nbrDice, symbols, values, rerollIndices, isAddOperation));
+        // tell the main thread, a result has occurred.
+        Bundle bundle = new Bundle();
+        bundle.putParcelable(resultsMsg, diceResults);
+        bundle.putParcelableArray(diceConfigMsg, dice);
+        if (diceName != null) {
+            bundle.putString(fileNameMsg, diceName);
         }
+        bundle.putBoolean(isModifiedRollMsg, isModifiedRoll);
+        if (rollSeed != null) {
+            bundle.putByteArray(rollSeedMsg, rollSeed);
+        }
+        Message msg = Message.obtain();
+        msg.setData(bundle);
+        m_notify.sendMessage(msg);
     }
 
-    public void sendResults(String diceName, boolean inIsModifiedRoll) {
-        m_diceName = diceName;
-        m_isModifiedRoll = inIsModifiedRoll;
-        sendResults();
-    }
-
-    public void sendResults() {
-        if (m_msgBeingBuilt == null || m_dice == null) {
+    // The dice that landed since the last call are in the result buffer as ints: the number of
+    // dice, then for each die: the die (an index into the results), its place in the rerolls of
+    // the die and the face it landed on.  isFirst: the first dice to land in a new roll.
+    public void sendSettledDice(int configurationId, boolean isFirst) {
+        if (isFirst || configurationId != m_settledConfigurationId) {
+            startRunningTotal(configurationId);
+        }
+        if (m_settledGroups == null) {
             return;
         }
 
-        // tell the main thread, a result has occurred.
-        Bundle bundle = new Bundle();
-        bundle.putParcelable(resultsMsg, m_msgBeingBuilt);
-        DieConfiguration[] dice = new DieConfiguration[m_dice.size()];
-        int i = 0;
-        for (DieConfiguration die : m_dice) {
-            dice[i++] = die;
+        IntBuffer settled = m_resultBuffer.asIntBuffer();
+        int nbrSettled = settled.get(0);
+        for (int i = 0; i < nbrSettled; i++) {
+            int group = settled.get(1 + 3 * i);
+            int index = settled.get(2 + 3 * i);
+            int face = settled.get(3 + 3 * i);
+            if (group < 0 || group >= m_settledGroups.length) {
+                continue;
+            }
+
+            DieConfiguration die = m_settledGroups[group];
+            Integer sideValue = die.getSide(face % die.getNumberOfSides()).value();
+            int value = sideValue == null ? 0 : (die.isAddOperation() ? sideValue : -sideValue);
+            Integer previous = m_settledValues.put(((long) group << 32) | index, value);
+            m_runningTotal += value - (previous == null ? 0 : previous);
         }
-        bundle.putParcelableArray(diceConfigMsg, dice);
-        if (m_diceName != null) {
-            bundle.putString(fileNameMsg, m_diceName);
-        }
-        bundle.putBoolean(isModifiedRollMsg, m_isModifiedRoll);
+
+        // tell the main thread the new total.
+        Bundle bundle = new Bundle();
+        bundle.putInt(runningTotalMsg, m_constantsTotal + m_runningTotal);
         Message msg = Message.obtain();
         msg.setData(bundle);
         m_notify.sendMessage(msg);
+    }
+
+    // The native code only sends results for dice with more than one side, so the results are
+    // matched up with those and the dice with one side are added in as a constant.
+    private void startRunningTotal(int configurationId) {
+        m_settledConfigurationId = configurationId;
+        m_settledValues.clear();
+        m_runningTotal = 0;
+        m_constantsTotal = 0;
+
+        DieConfiguration[] dice = Draw.configurationForId(configurationId);
+        if (dice == null) {
+            m_settledGroups = null;
+            return;
+        }
 
-        m_msgBeingBuilt = null;
-        m_dice = null;
-        m_diceName = null;
+        ArrayList<DieConfiguration> groups = new ArrayList<>();
+        for (DieConfiguration die : dice) {
+            if (die.getNumberOfSides() == 1) {
+                Integer value = die.getSide(0).value();
+                if (value != null) {
+                    int total = die.getNumberOfDice() * value;
+                    m_constantsTotal += die.isAddOperation() ? total : -total;
+                }
+            } else {
+                for (int i = 0; i < die.getNumberOfDice(); i++) {
+                    groups.add(die);
+                }
+            }
+        }
+        m_settledGroups = groups.toArray(new DieConfiguration[groups.size()]);
     }
 
     public void sendError(String error) {
@@ -128,8 +198,6 @@ public class DiceDrawerReturnChannel {
         Message msg = Message.obtain();
         msg.setData(bundle);
         m_notify.sendMessage(msg);
-
-        m_msgBeingBuilt = null;
     }
 
     public void sendGraphicsDescription(boolean hasLinearAcceleration, boolean hasGravity,
@@ -29,30 +29,35 @@ public class DiceWorker implements Runnable {
     private DiceDrawerReturnChannel m_notify;
     private SurfaceHolder m_surfaceHolder;
     private AssetManager m_assetManager;
+    private String m_cacheDir;
     private boolean m_useGravity;
     private boolean m_drawRollingDice;
     private boolean m_useLegacy;
     private boolean m_reverseGravity;
+    private float m_refreshRate;
 
+    // refreshRate: the display's refresh rate, so that the frames can be paced by vsync.
     public DiceWorker(Handler inNotify, SurfaceHolder inSurfaceHolder, AssetManager inAssetManager,
-                      boolean useGravity, boolean drawRollingDice, boolean useLegacy,
-                      boolean reverseGravity) {
+                      String cacheDir, boolean useGravity, boolean drawRollingDice, boolean useLegacy,
+                      boolean reverseGravity, float refreshRate) {
         m_notify = new DiceDrawerReturnChannel(inNotify);
         m_surfaceHolder = inSurfaceHolder;
         m_assetManager = inAssetManager;
+        m_cacheDir = cacheDir;
         m_useGravity = useGravity;
         m_drawRollingDice = drawRollingDice;
         m_useLegacy = useLegacy;
         m_reverseGravity = reverseGravity;
+        m_refreshRate = refreshRate;
     }
 
     public void run() {
-        startWorker(m_surfaceHolder.getSurface(), m_assetManager, m_notify, m_useGravity,
-                    m_drawRollingDice, m_useLegacy, m_reverseGravity);
+        startWorker(m_surfaceHolder.getSurface(), m_assetManager, m_cacheDir, m_notify, m_useGravity,
+                    m_drawRollingDice, m_useLegacy, m_reverseGravity, m_refreshRate);
     }
 
-    private native void startWorker(Surface jsurface, AssetManager jmanager,
+    private native void startWorker(Surface jsurface, AssetManager jmanager, String cacheDir,
                                     DiceDrawerReturnChannel jnotify, boolean useGravity,
                                     boolean drawRollingDice, boolean useLegacy,
-                                    boolean reverseGravity);
+                                    boolean reverseGravity, float refreshRate);
 }
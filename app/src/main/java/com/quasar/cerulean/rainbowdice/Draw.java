@@ -22,10 +22,14 @@ package com.quasar.cerulean.rainbowdice;
 import android.graphics.Bitmap;
 import android.graphics.Canvas;
 import android.graphics.Paint;
+import android.os.Build;
 import android.view.Surface;
 
 import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
 import java.util.Collection;
+import java.util.LinkedHashMap;
+import java.util.Map;
 import java.util.TreeSet;
 
 import static android.graphics.Bitmap.Config.ALPHA_8;
@@ -37,6 +41,20 @@ public class Draw {
     private static final int TEXWIDTH = 128;
     private static final int TEX_PADDING = 30;
     private static final int TEX_BLANK_HEIGHT = 128;
+    public static final int ROLL_SEED_LENGTH = 32;
+
+    // The native code sends the ID of the dice configuration back with the results instead of
+    // the configuration.  Only the most recent configurations are kept, results for older ones
+    // are dropped.
+    private static final int MAX_CONFIGURATIONS = 8;
+    private static int s_nextConfigurationId = 0;
+    private static final LinkedHashMap<Integer, DieConfiguration[]> s_configurations =
+            new LinkedHashMap<Integer, DieConfiguration[]>() {
+                @Override
+                protected boolean removeEldestEntry(Map.Entry<Integer, DieConfiguration[]> eldest) {
+                    return size() > MAX_CONFIGURATIONS;
+                }
+            };
 
     static final private class DiceTexture {
         public int width;
@@ -60,27 +78,47 @@ public class Draw {
         }
     }
 
+    // The dice packed for the native code and the texture atlas bitmap, which is null when the
+    // native atlas cache already has the atlas.
+    static final private class PackedRoll {
+        public ByteBuffer packedDice;
+        public long atlasKey;
+        public byte[] bitmap;
+        public PackedRoll(ByteBuffer inPackedDice, long inAtlasKey, byte[] inBitmap) {
+            packedDice = inPackedDice;
+            atlasKey = inAtlasKey;
+            bitmap = inBitmap;
+        }
+    }
+
     public Draw() {
     }
 
     public static String startDrawingRoll(DieConfiguration[] diceConfig, String diceName) {
+        return startDrawingRoll(diceConfig, diceName, null);
+    }
+
+    // seed: null or the 32 byte seed of a roll to replay (it is returned with the results of
+    // every roll).
+    public static String startDrawingRoll(DieConfiguration[] diceConfig, String diceName,
+                                          byte[] seed) {
+        if (seed != null && seed.length != ROLL_SEED_LENGTH) {
+            return "error: The roll seed must be " + ROLL_SEED_LENGTH + " bytes long.";
+        }
+
         if (diceConfig == null || diceConfig.length == 0) {
             // somehow someone managed to crash the code by having dice config null.  I don't know
             // how they did this, but returning here avoids the crash.
             return "No dice configurations exist, please choose dice.";
         }
 
-        Collection<String> symbolSet = getSymbols(diceConfig);
-
-        DiceTexture texture = createTexture(symbolSet, changeAspectRatio(diceConfig));
-        if (texture == null) {
+        PackedRoll roll = packRoll(diceConfig);
+        if (roll == null) {
             return "error: Could not create texture.";
         }
 
-        String err = rollDice(diceName, diceConfig,
-                symbolSet.toArray(new String[symbolSet.size()]),
-                texture.width, texture.height, texture.textureCoordLeft, texture.textureCoordRight,
-                texture.textureCoordTop, texture.textureCoordBottom, texture.bytes);
+        String err = rollDice(diceName, registerConfiguration(diceConfig), roll.packedDice,
+                roll.atlasKey, roll.bitmap, seed);
         if (err != null && err.length() != 0) {
             return err;
         }
@@ -109,18 +147,13 @@ public class Draw {
             return "No dice configurations exist, please choose dice.";
         }
 
-        Collection<String> symbolSet = getSymbols(diceConfig);
-
-        DiceTexture texture = createTexture(symbolSet, changeAspectRatio(diceConfig));
-        if (texture == null) {
+        PackedRoll roll = packRoll(diceConfig);
+        if (roll == null) {
             return "error: Could not create texture.";
         }
 
-        String err = drawStoppedDice(name, diceConfig, diceResult,
-                symbolSet.toArray(new String[symbolSet.size()]),
-                texture.width, texture.height,
-                texture.textureCoordLeft, texture.textureCoordRight, texture.textureCoordTop,
-                texture.textureCoordBottom, texture.bytes);
+        String err = drawStoppedDice(name, registerConfiguration(diceConfig), roll.packedDice,
+                diceResult, roll.atlasKey, roll.bitmap);
         if (err != null && err.length() != 0) {
             return err;
         }
@@ -128,6 +161,94 @@ public class Draw {
         return null;
     }
 
+    // Keeps a copy of diceConfig for the results and returns the ID the native code sends them
+    // back with.
+    private static synchronized int registerConfiguration(DieConfiguration[] diceConfig) {
+        DieConfiguration[] copy = new DieConfiguration[diceConfig.length];
+        for (int i = 0; i < diceConfig.length; i++) {
+            copy[i] = new DieConfiguration(diceConfig[i]);
+        }
+
+        int configurationId = s_nextConfigurationId++;
+        s_configurations.put(configurationId, copy);
+        return configurationId;
+    }
+
+    // Returns a copy of the dice configuration with the ID or null if it is no longer kept.
+    public static synchronized DieConfiguration[] configurationForId(int configurationId) {
+        DieConfiguration[] diceConfig = s_configurations.get(configurationId);
+        if (diceConfig == null) {
+            return null;
+        }
+
+        DieConfiguration[] copy = new DieConfiguration[diceConfig.length];
+        for (int i = 0; i < diceConfig.length; i++) {
+            copy[i] = new DieConfiguration(diceConfig[i]);
+        }
+        return copy;
+    }
+
+    // Packs the dice and, unless the native atlas cache has it, rasterizes their texture atlas.
+    // Returns null if the atlas could not be created.
+    private static PackedRoll packRoll(DieConfiguration[] diceConfig) {
+        Collection<String> symbolSet = getSymbols(diceConfig);
+        boolean changeAspectRatio = changeAspectRatio(diceConfig);
+        long atlasKey = atlasKey(symbolSet, changeAspectRatio);
+        if (hasCachedAtlas(atlasKey)) {
+            return new PackedRoll(PackedDiceConfiguration.pack(diceConfig), atlasKey, null);
+        }
+
+        DiceTexture texture = createTexture(symbolSet, changeAspectRatio);
+        if (texture == null) {
+            return null;
+        }
+        return new PackedRoll(packDice(diceConfig, symbolSet, texture), atlasKey, texture.bytes);
+    }
+
+    // A 64 bit FNV-1a hash of everything the layout and rasterization of the texture atlas in
+    // createTexture depend on: the symbols, the texture constants and the system fonts (which
+    // only change with the build).  The native atlas cache keeps atlases by this key.
+    private static long atlasKey(Collection<String> symbolSet, boolean changeAspectRatio) {
+        long hash = 0xcbf29ce484222325L;
+        hash = hashBytes(hash, Build.FINGERPRINT.getBytes(StandardCharsets.UTF_8));
+        hash = hashInt(hash, MAX_TEXTURE_DIMENSION);
+        hash = hashInt(hash, TEXWIDTH);
+        hash = hashInt(hash, TEX_PADDING);
+        hash = hashInt(hash, TEX_BLANK_HEIGHT);
+        hash = hashInt(hash, changeAspectRatio ? 1 : 0);
+        hash = hashInt(hash, symbolSet.size());
+        for (String symbol : symbolSet) {
+            byte[] bytes = symbol.getBytes(StandardCharsets.UTF_8);
+            hash = hashInt(hash, bytes.length);
+            hash = hashBytes(hash, bytes);
+        }
+        return hash;
+    }
+
+    private static long hashBytes(long hash, byte[] bytes) {
+        for (byte b : bytes) {
+            hash ^= b & 0xff;
+            hash *= 0x100000001b3L;
+        }
+        return hash;
+    }
+
+    private static long hashInt(long hash, int value) {
+        for (int i = 0; i < 4; i++) {
+            hash ^= (value >>> (8 * i)) & 0xff;
+            hash *= 0x100000001b3L;
+        }
+        return hash;
+    }
+
+    private static ByteBuffer packDice(DieConfiguration[] diceConfig, Collection<String> symbolSet,
+                                       DiceTexture texture) {
+        return PackedDiceConfiguration.pack(diceConfig,
+                symbolSet.toArray(new String[symbolSet.size()]), texture.width, texture.height,
+                texture.textureCoordLeft, texture.textureCoordRight, texture.textureCoordTop,
+                texture.textureCoordBottom);
+    }
+
     private static Collection<String> getSymbols(DieConfiguration[] diceConfig) {
         TreeSet<String> symbolSet = new TreeSet<>();
 
@@ -330,15 +451,20 @@ public class Draw {
                 textureCoordTopNorm, textureCoordBottomNorm, bytes);
     }
 
-    private static native String rollDice(String diceName, DieConfiguration[] diceConfig,
-                                   String[] symbols, int width, int height,
-                                   float[] textureCoordLeft, float[] textureCoordRight,
-                                   float[] textureCoordTop, float[] textureCoordBottom,  byte[] bitmap);
-    private static native String drawStoppedDice(String diceName, DieConfiguration[] diceConfig,
-                                          DiceResult diceResult,
-                                          String[] symbolsTexture, int width, int height,
-                                          float[] textureCoordLeft, float[] textureCoordRight,
-                                          float[] textureCoordTop, float[] textureCoordBottom,  byte[] bitmap);
+    // configurationId: the ID the results are sent back with (see registerConfiguration).
+    // packedDice: the dice and texture layout packed by PackedDiceConfiguration.
+    // atlasKey, bitmap: the key of the texture atlas (see atlasKey) and its bitmap, or null
+    // when hasCachedAtlas returned true for the key.  The texture layout is then left out of
+    // packedDice.
+    private static native String rollDice(String diceName, int configurationId,
+                                          ByteBuffer packedDice, long atlasKey, byte[] bitmap,
+                                          byte[] seed);
+    private static native String drawStoppedDice(String diceName, int configurationId,
+                                                 ByteBuffer packedDice, DiceResult diceResult,
+                                                 long atlasKey, byte[] bitmap);
+    // Returns true if the native atlas cache has the atlas with the key and keeps it ready for
+    // the next rollDice or drawStoppedDice call.
+    private static native boolean hasCachedAtlas(long atlasKey);
     public static native void tellDrawerStop();
 
     public static native String tellDrawerSurfaceChanged(int width, int height);
@@ -356,4 +482,33 @@ public class Draw {
     public static native void deleteSelected();
 
     public static native void resetView();
+
+    // Turns recording of the native frame phase trace on or off.
+    public static native void setTracing(boolean enable);
+
+    // Writes the native frame phase trace to the file in the Chrome trace event JSON format.
+    // Returns an empty string on success or an error message.
+    public static native String dumpTrace(String path);
+
+    // Returns a snapshot of the native engine metrics packed as:
+    //   version, nbrCounters, counters..., nbrGauges, gauges...,
+    //   nbrHistograms, then for each histogram: count, sum, max, nbrBuckets, buckets...
+    // Counters: draw calls, vertices drawn, events processed, bounce pair tests, allocations
+    // (debug builds only), frames drawn, rolls completed, texture bytes uploaded, events dropped,
+    // missed frame deadlines.  Gauges: buffer bytes allocated, dice alive.  Histograms (power of 2
+    // buckets): draw calls, vertices, events, bounce pair tests and allocations per frame, the time
+    // from a roll request to its result in ms, and the frame time and frame busy time in us.
+    public static native long[] getMetrics();
+
+    // Returns the exact probability distribution of the total of a roll of diceConfigs, packed as:
+    //   minTotal, nbrTotals, pmf (nbrTotals values), cdf (nbrTotals values),
+    //   nbrPercentiles, then (probability, total) for each percentile.
+    // pmf[i] and cdf[i] are for the total minTotal + i.  Each die counts the values of all the
+    // faces it lands on including rerolls, subtract operations count negatively and symbols
+    // without a value count as 0.  Returns null if the distribution could not be computed.
+    public static double[] diceDistribution(DieConfiguration[] diceConfigs) {
+        return diceDistribution(PackedDiceConfiguration.pack(diceConfigs));
+    }
+
+    private static native double[] diceDistribution(ByteBuffer packedDice);
 }
@@ -778,8 +778,9 @@ public class MainActivity extends AppCompatActivity {
         TextView resultView = findViewById(R.id.rollResult);
         Handler notify = new Handler(new ResultHandler(resultView));
         drawer = new Thread(new DiceWorker(notify, drawSurfaceHolder, assetManager,
-                configurationFile.useGravity(), configurationFile.drawRollingDice(),
-                configurationFile.useLegacy(), configurationFile.reverseGravity()));
+                getCacheDir().getPath(), configurationFile.useGravity(), configurationFile.drawRollingDice(),
+                configurationFile.useLegacy(), configurationFile.reverseGravity(),
+                getWindowManager().getDefaultDisplay().getRefreshRate()));
         drawer.start();
     }
 
@@ -826,6 +827,12 @@ public class MainActivity extends AppCompatActivity {
                 // the result is an error message.  Print the error message to the text view
                 text.setText(serror);
                 return true;
+            } else if (data.containsKey(DiceDrawerReturnChannel.runningTotalMsg)) {
+                // some of the dice are still rolling, show the total of the ones that landed.
+                int total = data.getInt(DiceDrawerReturnChannel.runningTotalMsg);
+                text.setText(String.format(Locale.getDefault(),
+                        getString(R.string.diceRunningTotal), total));
+                return true;
             } else if (data.containsKey(DiceDrawerReturnChannel.diceSelected)) {
                 boolean diceSelected = data.getBoolean(DiceDrawerReturnChannel.diceSelected);
                 Button plusRolling = MainActivity.this.findViewById(R.id.plus_rolling_dice);
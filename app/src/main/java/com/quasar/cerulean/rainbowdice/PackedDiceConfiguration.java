@@ -0,0 +1,127 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+package com.quasar.cerulean.rainbowdice;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.charset.StandardCharsets;
+
+/**
+ * Packs dice configurations and the layout of their symbols in the texture atlas into a direct
+ * ByteBuffer that the native code reads without calling back into Java.  The format is described
+ * in packedDice.hpp and the version here has to match the one there.
+ */
+public class PackedDiceConfiguration {
+    private static final int VERSION = 1;
+    private static final int COLOR_LENGTH = 4;
+
+    // Packs only the dice, with no symbols in the texture section.
+    public static ByteBuffer pack(DieConfiguration[] diceConfig) {
+        return pack(diceConfig, new String[0], 0, 0, new float[0], new float[0], new float[0],
+                new float[0]);
+    }
+
+    public static ByteBuffer pack(DieConfiguration[] diceConfig, String[] symbols,
+                                  int width, int height,
+                                  float[] textureCoordLeft, float[] textureCoordRight,
+                                  float[] textureCoordTop, float[] textureCoordBottom) {
+        float[] color = new float[COLOR_LENGTH];
+
+        // encode the strings first so that the exact size of the buffer is known.
+        byte[][][] sideSymbols = new byte[diceConfig.length][][];
+        byte[][] textureSymbols = new byte[symbols.length][];
+        int size = 4 + 4;
+        for (int i = 0; i < diceConfig.length; i++) {
+            DieConfiguration dieConfig = diceConfig[i];
+            size += 4 + 1 + 1 + 4 + 4;
+            if (!dieConfig.isRainbow() && dieConfig.getColor(color)) {
+                size += 4 * COLOR_LENGTH;
+            }
+            int nbrSides = dieConfig.getNumberOfSides();
+            sideSymbols[i] = new byte[nbrSides][];
+            for (int j = 0; j < nbrSides; j++) {
+                sideSymbols[i][j] = dieConfig.getSide(j).symbol().getBytes(StandardCharsets.UTF_8);
+                size += 4 + sideSymbols[i][j].length + 1 + 4;
+            }
+            size += 4 * dieConfig.getNbrIndicesReRollOn();
+        }
+        size += 4;
+        for (int i = 0; i < symbols.length; i++) {
+            textureSymbols[i] = symbols[i].getBytes(StandardCharsets.UTF_8);
+            size += 4 + textureSymbols[i].length;
+        }
+        size += 4 + 4 + 4 * 4 * symbols.length;
+
+        ByteBuffer buffer = ByteBuffer.allocateDirect(size).order(ByteOrder.LITTLE_ENDIAN);
+        buffer.putInt(VERSION);
+
+        buffer.putInt(diceConfig.length);
+        for (int i = 0; i < diceConfig.length; i++) {
+            DieConfiguration dieConfig = diceConfig[i];
+            buffer.putInt(dieConfig.getNumberOfDice());
+            buffer.put((byte) (dieConfig.isAddOperation() ? 1 : 0));
+            if (!dieConfig.isRainbow() && dieConfig.getColor(color)) {
+                buffer.put((byte) 1);
+                for (float component : color) {
+                    buffer.putFloat(component);
+                }
+            } else {
+                buffer.put((byte) 0);
+            }
+
+            int nbrSides = dieConfig.getNumberOfSides();
+            buffer.putInt(nbrSides);
+            for (int j = 0; j < nbrSides; j++) {
+                putString(buffer, sideSymbols[i][j]);
+                Integer value = dieConfig.getSide(j).value();
+                buffer.put((byte) (value != null ? 1 : 0));
+                buffer.putInt(value != null ? value : 0);
+            }
+
+            int[] rerollOn = new int[dieConfig.getNbrIndicesReRollOn()];
+            dieConfig.getReRollOn(rerollOn);
+            buffer.putInt(rerollOn.length);
+            for (int index : rerollOn) {
+                buffer.putInt(index);
+            }
+        }
+
+        buffer.putInt(symbols.length);
+        for (byte[] symbol : textureSymbols) {
+            putString(buffer, symbol);
+        }
+        buffer.putInt(width);
+        buffer.putInt(height);
+        for (float[] coords : new float[][] {textureCoordLeft, textureCoordRight, textureCoordTop,
+                textureCoordBottom}) {
+            for (int i = 0; i < symbols.length; i++) {
+                buffer.putFloat(coords[i]);
+            }
+        }
+
+        buffer.rewind();
+        return buffer;
+    }
+
+    private static void putString(ByteBuffer buffer, byte[] utf8) {
+        buffer.putInt(utf8.length);
+        buffer.put(utf8);
+    }
+}
@@ -40,6 +40,7 @@ layout(set = 0, binding = 2) uniform UniformBufferObject {
 layout(set = 0, binding = 3) uniform UniformBufferObjectObj {
     int isSelected;
     float edgeWidth;
+    int isDistanceField;
 } fragPerObjUbo;
 
 layout(location = 0) out vec4 outColor;
@@ -59,7 +60,15 @@ void main() {
     vec3 color;
     float alpha;
     vec4 textureColor = texture(texSampler, fragTexCoord);
-    if (textureColor.a != 0.0) {
+    if (fragPerObjUbo.isDistanceField > 0) {
+        // a is the distance to the edge of the symbol, 0.5 on the edge and more inside it.
+        // Blend over about one pixel on the screen so that the edge is smooth at any zoom.
+        float distance = textureColor.a;
+        float smoothing = max(0.7 * fwidth(distance), 0.001);
+        float coverage = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+        color = mix(fragColor.rgb, vec3(1.0) - fragColor.rgb, coverage);
+        alpha = fragColor.a;
+    } else if (textureColor.a != 0.0) {
         if (textureColor.r == 0.0 && textureColor.g == 0.0 && textureColor.b == 0.0) {
             color = vec3(1.0 - fragColor.r, 1.0 - fragColor.g, 1.0 - fragColor.b);
         } else {
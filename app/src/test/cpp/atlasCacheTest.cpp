@@ -0,0 +1,434 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Host test of the texture atlas cache (atlasCache.hpp).  Build with the host target in
+ * app/CMakeLists.txt and run through ctest, or directly:
+ *
+ *   atlas-cache-test
+ *
+ * The cache files go to a temporary directory.  An atlas written by one AtlasCache has to read
+ * back unchanged through another one (which has nothing in memory), and every truncated or
+ * corrupted file has to be rejected instead of handed to the renderers.  It also checks the
+ * symbol IDs the atlases intern: dense, in the order the symbols were added, unchanged when
+ * symbols are added in place and when the atlas is read back from the cache.  The host build
+ * compiles the tests with ASan and UBSan (ENGINE_TESTS_SANITIZE) so that a read outside the
+ * mapping fails the run too.
+ */
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "atlasCache.hpp"
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, char const *what) {
+        if (!condition) {
+            fprintf(stderr, "FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    // AtlasCache::m_maxFiles
+    size_t const maxFiles = 16;
+
+    // offsets into a cache file (see the layout in atlasCache.cpp).
+    size_t const magicOffset = 0;
+    size_t const versionOffset = 4;
+    size_t const keyOffset = 8;
+    size_t const formatOffset = 16;
+    size_t const widthOffset = 20;
+    size_t const heightOffset = 24;
+    size_t const nbrSymbolsOffset = 28;
+    size_t const bitmapLengthOffset = 32;
+    // the first symbol is "1": its length, its one byte, then its four coordinates.
+    size_t const firstCoordinateOffset = 36 + 4 + 1;
+
+    std::vector<std::string> const symbols{"1", "22", "\xe2\x98\x85", "blank"};
+
+    /* A width x height atlas of a checker board, with the symbols in the four quadrants.  A
+     * monochrome atlas is converted to a distance field, a colour one stays RGBA.
+     */
+    std::shared_ptr<TextureAtlas> makeAtlas(uint32_t width, uint32_t height, bool colour) {
+        uint32_t length = 4 * width * height;
+        std::unique_ptr<unsigned char[]> bitmap{new unsigned char[length]};
+        std::memset(bitmap.get(), 0, length);
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                if ((x / 8 + y / 8) % 2 == 0) {
+                    unsigned char *texel = bitmap.get() + 4 * (y * width + x);
+                    texel[3] = 255;
+                    if (colour) {
+                        texel[0] = static_cast<unsigned char>(x);
+                        texel[1] = static_cast<unsigned char>(y);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::pair<float, float>> leftRight{{0.0f, 0.5f}, {0.5f, 1.0f}, {0.0f, 0.5f},
+                                                       {0.5f, 1.0f}};
+        std::vector<std::pair<float, float>> topBottom{{0.0f, 0.5f}, {0.0f, 0.5f}, {0.5f, 1.0f},
+                                                       {0.5f, 1.0f}};
+        return std::make_shared<TextureAtlas>(symbols, width, height, leftRight, topBottom,
+                                              std::move(bitmap), length);
+    }
+
+    bool sameAtlas(TextureAtlas &a, TextureAtlas &b) {
+        if (a.format() != b.format() || a.getImageWidth() != b.getImageWidth() ||
+            a.getImageHeight() != b.getImageHeight() || a.bitmapLength() != b.bitmapLength() ||
+            a.getNbrImages() != b.getNbrImages() ||
+            std::memcmp(a.bitmap(), b.bitmap(), a.bitmapLength()) != 0) {
+            return false;
+        }
+        for (auto const &symbol : symbols) {
+            TextureImage const &imageA = a.getTextureCoordinates(a.symbolId(symbol));
+            TextureImage const &imageB = b.getTextureCoordinates(b.symbolId(symbol));
+            if (imageA.left != imageB.left || imageA.right != imageB.right ||
+                imageA.top != imageB.top || imageA.bottom != imageB.bottom) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    class TemporaryDirectory {
+    public:
+        TemporaryDirectory() {
+            char path[] = "/tmp/atlas-cache-test-XXXXXX";
+            if (mkdtemp(path) == nullptr) {
+                throw std::runtime_error("Could not create a temporary directory.");
+            }
+            m_path = path;
+        }
+
+        TemporaryDirectory(TemporaryDirectory const &) = delete;
+        TemporaryDirectory &operator=(TemporaryDirectory const &) = delete;
+
+        ~TemporaryDirectory() {
+            for (auto const &name : files()) {
+                unlink((m_path + "/" + name).c_str());
+            }
+            rmdir(m_path.c_str());
+        }
+
+        std::string const &path() const { return m_path; }
+
+        std::vector<std::string> files() const {
+            std::vector<std::string> names;
+            DIR *dir = opendir(m_path.c_str());
+            if (dir == nullptr) {
+                return names;
+            }
+            for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+                std::string name(entry->d_name);
+                if (name != "." && name != "..") {
+                    names.push_back(name);
+                }
+            }
+            closedir(dir);
+            return names;
+        }
+
+    private:
+        std::string m_path;
+    };
+
+    std::string cacheFile(TemporaryDirectory const &directory, uint64_t key) {
+        char name[32];
+        snprintf(name, sizeof (name), "atlas-%016llx.bin", static_cast<unsigned long long>(key));
+        return directory.path() + "/" + name;
+    }
+
+    std::vector<char> readFile(std::string const &path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void writeFile(std::string const &path, std::vector<char> const &data) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    template <typename T>
+    void poke(std::vector<char> &data, size_t offset, T value) {
+        std::memcpy(data.data() + offset, &value, sizeof (value));
+    }
+
+    // looks the key up through a new cache, so that it has to be read from its file.
+    std::shared_ptr<TextureAtlas> load(TemporaryDirectory const &directory, uint64_t key) {
+        AtlasCache cache;
+        cache.setDirectory(directory.path());
+        return cache.find(key);
+    }
+
+    void testRoundTrip() {
+        for (bool colour : {false, true}) {
+            TemporaryDirectory directory;
+            uint64_t key = colour ? 0xc0105 : 0x11000;
+            auto atlas = makeAtlas(64, 32, colour);
+            check(atlas->format() == (colour ? TextureFormat::rgba8 : TextureFormat::distanceField8),
+                  "a monochrome atlas is converted to a distance field, a colour one is not");
+
+            {
+                AtlasCache inMemoryOnly;
+                inMemoryOnly.add(key, atlas);
+                check(inMemoryOnly.find(key) == atlas,
+                      "without a directory the most recent atlas is kept in memory");
+                check(inMemoryOnly.find(key + 1) == nullptr, "an unknown key is not found");
+            }
+
+            AtlasCache cache;
+            cache.setDirectory(directory.path());
+            cache.add(key, atlas);
+            check(cache.find(key) == atlas, "the atlas just added is handed out again as is");
+
+            auto loaded = load(directory, key);
+            check(loaded != nullptr && loaded != atlas, "the atlas is read back from its file");
+            check(loaded != nullptr && sameAtlas(*atlas, *loaded),
+                  "the atlas read back is the same as the one written");
+            check(load(directory, key + 1) == nullptr, "a key without a file is not found");
+        }
+    }
+
+    void testTruncated() {
+        TemporaryDirectory directory;
+        uint64_t key = 0x7a;
+        AtlasCache cache;
+        cache.setDirectory(directory.path());
+        cache.add(key, makeAtlas(32, 16, true));
+        std::vector<char> const file = readFile(cacheFile(directory, key));
+        check(!file.empty(), "the cache file is written");
+
+        bool allRejected = true;
+        for (size_t length = 0; length < file.size(); length++) {
+            writeFile(cacheFile(directory, key), std::vector<char>(file.begin(), file.begin() + length));
+            allRejected = load(directory, key) == nullptr && allRejected;
+        }
+        check(allRejected, "every truncated cache file is rejected");
+
+        std::vector<char> extended = file;
+        extended.push_back(0);
+        writeFile(cacheFile(directory, key), extended);
+        check(load(directory, key) == nullptr, "extra data at the end is rejected");
+
+        writeFile(cacheFile(directory, key), file);
+        check(load(directory, key) != nullptr, "the complete file is accepted again");
+    }
+
+    void testCorrupted() {
+        TemporaryDirectory directory;
+        uint64_t key = 0xbad;
+        AtlasCache cache;
+        cache.setDirectory(directory.path());
+        cache.add(key, makeAtlas(32, 16, true));
+        std::vector<char> const file = readFile(cacheFile(directory, key));
+
+        auto rejects = [&](std::vector<char> const &data) {
+            writeFile(cacheFile(directory, key), data);
+            return load(directory, key) == nullptr;
+        };
+
+        std::vector<char> data = file;
+        poke(data, firstCoordinateOffset, 0.25f);
+        check(!rejects(data), "a changed coordinate inside the atlas is accepted");
+
+        data = file;
+        poke(data, magicOffset, uint32_t{0});
+        check(rejects(data), "a wrong magic number is rejected");
+
+        data = file;
+        poke(data, versionOffset, uint32_t{2});
+        check(rejects(data), "an unsupported version is rejected");
+
+        data = file;
+        poke(data, keyOffset, key + 1);
+        check(rejects(data), "a file written for another key is rejected");
+
+        data = file;
+        poke(data, formatOffset, static_cast<uint32_t>(TextureFormat::distanceField8) + 1);
+        check(rejects(data), "an unknown texture format is rejected");
+
+        data = file;
+        poke(data, formatOffset, static_cast<uint32_t>(TextureFormat::alpha8));
+        check(rejects(data), "a format with a different texel size than the bitmap is rejected");
+
+        data = file;
+        poke(data, widthOffset, uint32_t{0});
+        check(rejects(data), "a zero width is rejected");
+
+        data = file;
+        poke(data, heightOffset, uint32_t{0});
+        check(rejects(data), "a zero height is rejected");
+
+        data = file;
+        poke(data, widthOffset, uint32_t{33});
+        check(rejects(data), "a width that does not match the bitmap is rejected");
+
+        data = file;
+        poke(data, heightOffset, uint32_t{0x40000000});
+        check(rejects(data), "a height that overflows 32 bits of texels is rejected");
+
+        data = file;
+        poke(data, bitmapLengthOffset, static_cast<uint32_t>(32 * 16 * 4 - 1));
+        check(rejects(data), "a bitmap length that does not match the dimensions is rejected");
+
+        data = file;
+        poke(data, nbrSymbolsOffset, uint32_t{0xffffffff});
+        check(rejects(data), "a symbol count larger than the file is rejected");
+
+        data = file;
+        poke(data, nbrSymbolsOffset, static_cast<uint32_t>(symbols.size() + 1));
+        check(rejects(data), "a symbol count one too large is rejected");
+
+        data = file;
+        poke(data, 36, uint32_t{0xfffffff0});
+        check(rejects(data), "a symbol length larger than the file is rejected");
+
+        for (float bad : {std::nanf(""), INFINITY, -0.5f, 2.0f}) {
+            for (size_t i = 0; i < 4; i++) {
+                data = file;
+                poke(data, firstCoordinateOffset + 4 * i, bad);
+                check(rejects(data), "a coordinate outside [0, 1] is rejected");
+            }
+        }
+    }
+
+    void testSymbolIds() {
+        // a symbol that is there twice keeps the ID and the coordinates of its first entry.
+        std::vector<std::string> withDuplicate{"b", "a", "b", "c"};
+        std::vector<std::pair<float, float>> leftRight{{0.0f, 0.25f}, {0.25f, 0.5f},
+                                                       {0.5f, 0.75f}, {0.75f, 1.0f}};
+        std::vector<std::pair<float, float>> topBottom(4, std::make_pair(0.0f, 1.0f));
+        std::unique_ptr<unsigned char[]> bitmap{new unsigned char[16 * 16 * 4]()};
+        TextureAtlas atlas{withDuplicate, 16, 16, leftRight, topBottom, std::move(bitmap),
+                           16 * 16 * 4};
+        check(atlas.getNbrImages() == 3, "a symbol that is there twice is interned once");
+        check(atlas.symbolId("b") == 0 && atlas.symbolId("a") == 1 && atlas.symbolId("c") == 2,
+              "the IDs are dense, in the order the symbols were added");
+        check(atlas.symbols() == std::vector<std::string>({"b", "a", "c"}),
+              "symbols() lists the symbols by ID");
+        check(atlas.getTextureCoordinates(atlas.symbolId("b")).right == 0.25f,
+              "the first entry of a symbol wins");
+
+        try {
+            atlas.symbolId("missing");
+            check(false, "a symbol that is not in the atlas throws");
+        } catch (std::runtime_error &) {
+        }
+
+        // all the dice of a description share its IDs.
+        SymbolIds ids = atlas.symbolIds({"c", "b", "b"});
+        SymbolIds copy = ids;
+        check(ids.size() == 3 && ids[0] == 2 && ids[1] == 0 && ids[2] == 0,
+              "symbolIds maps each symbol to its ID");
+        check(copy == ids && &*copy.begin() == &*ids.begin(), "copied IDs share their storage");
+        check(atlas.symbolIds({"c", "b", "b"}) == ids, "the same symbols give the same IDs");
+
+        // TextureAtlasManager adds symbols to its resident atlas in place.
+        atlas.addTextureImage("d", TextureImage{0.0f, 0.5f, 0.0f, 0.5f});
+        atlas.addTextureImage("a", TextureImage{0.5f, 1.0f, 0.5f, 1.0f});
+        check(atlas.symbolId("d") == 3 && atlas.getNbrImages() == 4,
+              "a symbol added in place gets the next ID");
+        check(atlas.symbolId("b") == 0 && atlas.symbolId("a") == 1 && atlas.symbolId("c") == 2,
+              "adding symbols in place keeps the IDs of the others");
+        check(atlas.getTextureCoordinates(atlas.symbolId("a")).left == 0.5f,
+              "adding a symbol again replaces its coordinates");
+
+        // the cache writes the symbols in ID order, so they read back with the same IDs.
+        TemporaryDirectory directory;
+        auto written = makeAtlas(32, 32, false);
+        AtlasCache cache;
+        cache.setDirectory(directory.path());
+        cache.add(0x1d, written);
+        auto loaded = load(directory, 0x1d);
+        bool sameIds = loaded != nullptr && loaded->symbols() == written->symbols();
+        for (auto const &symbol : symbols) {
+            sameIds = sameIds && loaded->symbolId(symbol) == written->symbolId(symbol);
+        }
+        check(sameIds, "an atlas read back from the cache gives its symbols the same IDs");
+    }
+
+    void setModificationTime(std::string const &path, time_t seconds) {
+        struct timespec times[2] = {{seconds, 0}, {seconds, 0}};
+        utimensat(AT_FDCWD, path.c_str(), times, 0);
+    }
+
+    void testFileLimit() {
+        TemporaryDirectory directory;
+        auto atlas = makeAtlas(16, 16, false);
+        AtlasCache cache;
+        cache.setDirectory(directory.path());
+
+        // file i was last used i minutes after the oldest one.
+        time_t start = time(nullptr) - 3600;
+        for (uint64_t key = 0; key < maxFiles; key++) {
+            cache.add(key, atlas);
+            setModificationTime(cacheFile(directory, key), start + 60 * static_cast<time_t>(key));
+        }
+        check(directory.files().size() == maxFiles, "files up to the limit are all kept");
+
+        // reading file 0 back makes it the most recently used, file 1 becomes the oldest.
+        check(load(directory, 0) != nullptr, "the oldest file is read back");
+
+        cache.add(maxFiles, atlas);
+        check(directory.files().size() == maxFiles, "adding past the limit removes a file");
+        check(access(cacheFile(directory, 1).c_str(), F_OK) != 0,
+              "the least recently used file is removed");
+        check(access(cacheFile(directory, 0).c_str(), F_OK) == 0,
+              "a file that was read back is kept");
+        check(access(cacheFile(directory, maxFiles).c_str(), F_OK) == 0,
+              "the file just added is kept");
+
+        for (uint64_t key = maxFiles + 1; key < 3 * maxFiles; key++) {
+            cache.add(key, atlas);
+        }
+        check(directory.files().size() == maxFiles, "the number of files stays at the limit");
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testTruncated();
+    testCorrupted();
+    testFileLimit();
+    testSymbolIds();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return 0;
+}
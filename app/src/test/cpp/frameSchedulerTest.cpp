@@ -0,0 +1,459 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Host test of the frame pacing in frameScheduler.hpp.  The scheduler runs on a fake clock whose
+ * time only moves when the test says a frame did some work, when a frame is presented (to the next
+ * vsync) or when the scheduler sleeps, so the deadlines can be checked exactly.  The frame loop of
+ * DiceWorker::drawingLoop (runFrameLoop) is run with a renderer that draws nothing.
+ */
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "frameScheduler.hpp"
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, char const *what) {
+        if (!condition) {
+            fprintf(stderr, "FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    bool near(float value, float expected) {
+        return std::fabs(value - expected) < 1e-5f;
+    }
+
+    // A clock whose sleepUntil jumps to the deadline and remembers it.
+    class FakeClock {
+    public:
+        using time_point = std::chrono::steady_clock::time_point;
+        using duration = std::chrono::steady_clock::duration;
+
+        FakeClock() : m_now{}, m_wakeUps{}, m_presents{} {}
+
+        time_point now() { return m_now; }
+
+        void sleepUntil(time_point deadline) {
+            if (deadline > m_now) {
+                m_now = deadline;
+            }
+            m_wakeUps.push_back(deadline);
+        }
+
+        // the time a frame spends drawing.
+        void work(duration d) { m_now += d; }
+
+        // a present that blocks until the next vsync of a display refreshing every refresh.
+        void present(duration refresh) {
+            duration sinceEpoch = m_now.time_since_epoch();
+            m_now = time_point{(sinceEpoch + refresh - duration{1}) / refresh * refresh};
+            m_presents.push_back(m_now);
+        }
+
+        std::vector<time_point> const &presents() const { return m_presents; }
+
+        std::vector<time_point> const &wakeUps() const { return m_wakeUps; }
+
+    private:
+        time_point m_now;
+        std::vector<time_point> m_wakeUps;
+        std::vector<time_point> m_presents;
+    };
+
+    using Scheduler = FrameScheduler<FakeClock>;
+    using std::chrono::milliseconds;
+
+    FakeClock::duration period(uint32_t framesPerSecond) {
+        return std::chrono::duration_cast<FakeClock::duration>(std::chrono::seconds(1)) /
+                framesPerSecond;
+    }
+
+    // draws nbrFrames frames that each take busy and checks that they start one period apart.
+    void checkSpacing(Scheduler &scheduler, uint32_t nbrFrames, FakeClock::duration busy,
+            bool onlySettling, FakeClock::duration expectedPeriod, char const *what) {
+        FakeClock &clock = scheduler.clock();
+        size_t firstWakeUp = clock.wakeUps().size();
+        FakeClock::time_point begin = clock.now();
+        for (uint32_t i = 0; i < nbrFrames; i++) {
+            clock.work(busy);
+            scheduler.frameDone(onlySettling);
+        }
+
+        bool spaced = clock.wakeUps().size() == firstWakeUp + nbrFrames;
+        for (uint32_t i = 0; spaced && i < nbrFrames; i++) {
+            spaced = clock.wakeUps()[firstWakeUp + i] == begin + expectedPeriod * (i + 1);
+        }
+        check(spaced, what);
+    }
+
+    void testSpacing() {
+        Scheduler scheduler(60, 20);
+        scheduler.start();
+        checkSpacing(scheduler, 120, milliseconds(5), false, period(60),
+                     "frames at 60 fps start 1/60 s apart");
+        check(scheduler.stats().nbrMissedDeadlines == 0, "no deadline is missed at 60 fps");
+
+        scheduler.setTargetFramesPerSecond(30);
+        checkSpacing(scheduler, 60, milliseconds(20), false, period(30),
+                     "frames at 30 fps start 1/30 s apart");
+        check(scheduler.stats().nbrMissedDeadlines == 0, "no deadline is missed at 30 fps");
+
+        // a frame that takes longer than 1/60 s but less than 1/30 s still makes 30 fps.
+        Scheduler slow(30, 20);
+        slow.start();
+        checkSpacing(slow, 30, milliseconds(25), false, period(30),
+                     "25 ms frames keep to 30 fps");
+    }
+
+    void testMissedDeadline() {
+        Scheduler scheduler(60, 20);
+        FakeClock &clock = scheduler.clock();
+        scheduler.start();
+        checkSpacing(scheduler, 3, milliseconds(5), false, period(60), "frames before the miss");
+
+        // the frame runs past its deadline: there is no sleep and the schedule restarts from now.
+        size_t nbrWakeUps = clock.wakeUps().size();
+        clock.work(milliseconds(40));
+        scheduler.frameDone(false);
+        check(scheduler.stats().nbrMissedDeadlines == 1, "a late frame is counted as missed");
+        check(clock.wakeUps().size() == nbrWakeUps, "the scheduler does not sleep after a miss");
+
+        // the following frames are paced from the end of the late frame, not the old schedule.
+        checkSpacing(scheduler, 10, milliseconds(5), false, period(60),
+                     "the schedule restarts from the end of the late frame");
+        check(scheduler.stats().nbrMissedDeadlines == 1, "the frames after the miss do not catch up");
+    }
+
+    void testSettleRate() {
+        Scheduler scheduler(60, 20);
+        scheduler.start();
+        checkSpacing(scheduler, 10, milliseconds(5), false, period(60), "rolling frames at 60 fps");
+        checkSpacing(scheduler, 10, milliseconds(5), true, period(20),
+                     "frames that only settle dice run at the idle rate");
+        checkSpacing(scheduler, 10, milliseconds(5), false, period(60),
+                     "rolling frames go back to 60 fps");
+
+        scheduler.setIdleFramesPerSecond(10);
+        checkSpacing(scheduler, 5, milliseconds(5), true, period(10),
+                     "a new idle rate is used for settling frames");
+        check(scheduler.stats().nbrMissedDeadlines == 0, "switching rates does not miss deadlines");
+    }
+
+    void testStatistics() {
+        Scheduler scheduler(50, 20);
+        FakeClock &clock = scheduler.clock();
+        scheduler.start();
+
+        // three 4 ms frames at 50 fps, then a 30 ms frame that misses its deadline.
+        for (int i = 0; i < 3; i++) {
+            clock.work(milliseconds(4));
+            scheduler.frameDone(false);
+        }
+        clock.work(milliseconds(30));
+        scheduler.frameDone(false);
+
+        FrameStatistics const &stats = scheduler.stats();
+        check(stats.nbrFrames == 4, "every frame is counted");
+        check(stats.nbrMissedDeadlines == 1, "the late frame is counted as missed");
+        check(near(stats.lastFrameTime, 0.030f), "the last frame time is the late frame");
+        check(near(stats.lastBusyTime, 0.030f), "the last busy time is the late frame");
+        check(near(stats.minFrameTime, 0.020f), "the shortest frame is one period");
+        check(near(stats.maxFrameTime, 0.030f), "the longest frame is the late frame");
+        check(near(stats.averageFrameTime, (3 * 0.020f + 0.030f) / 4), "the average frame time");
+        check(near(stats.averageBusyTime, (3 * 0.004f + 0.030f) / 4), "the average busy time");
+
+        scheduler.resetStats();
+        check(scheduler.stats().nbrFrames == 0 && scheduler.stats().nbrMissedDeadlines == 0 &&
+              scheduler.stats().averageFrameTime == 0.0f, "resetStats clears the statistics");
+        clock.work(milliseconds(4));
+        scheduler.frameDone(false);
+        check(scheduler.stats().nbrFrames == 1 && near(scheduler.stats().averageFrameTime, 0.020f) &&
+              near(scheduler.stats().minFrameTime, 0.020f), "the statistics restart after a reset");
+    }
+
+    // the refresh period the scheduler computes from a refresh rate of 60 Hz.
+    FakeClock::duration const refresh60 = std::chrono::duration_cast<FakeClock::duration>(
+            std::chrono::duration<float>(1.0f / 60.0f));
+
+    // true if the presents from first on are every nbrRefreshes vsyncs.
+    bool presentsEvery(FakeClock const &clock, size_t first, uint32_t nbrRefreshes) {
+        auto const &presents = clock.presents();
+        if (presents.size() < first + 2) {
+            return false;
+        }
+        for (size_t i = first + 1; i < presents.size(); i++) {
+            if (presents[i] - presents[i - 1] != refresh60 * nbrRefreshes) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void testVsync() {
+        Scheduler scheduler(60, 30);
+        scheduler.setDisplayRefreshRate(60.0f);
+        FakeClock &clock = scheduler.clock();
+        clock.work(milliseconds(3));
+        scheduler.start();
+
+        // at the display's rate the presents pace the frames: no sleeping on top of them.
+        for (int i = 0; i < 60; i++) {
+            clock.work(milliseconds(5));
+            clock.present(refresh60);
+            scheduler.frameDone(false, true);
+        }
+        check(clock.wakeUps().empty(), "the scheduler does not sleep when the presents pace the frames");
+        check(presentsEvery(clock, 0, 1), "frames at 60 fps are presented on every vsync");
+        check(scheduler.stats().nbrMissedDeadlines == 0, "no deadline is missed on every vsync");
+
+        // at the settle rate, a frame is presented on every other vsync.  The scheduler only sleeps
+        // for the refresh that the present does not wait for.
+        size_t firstSettling = clock.presents().size();
+        for (int i = 0; i < 30; i++) {
+            clock.work(milliseconds(5));
+            clock.present(refresh60);
+            scheduler.frameDone(true, true);
+        }
+        check(presentsEvery(clock, firstSettling, 2), "settling frames are presented every other vsync");
+        bool sleptOneRefresh = !clock.wakeUps().empty();
+        for (size_t i = 0; sleptOneRefresh && i + 1 < clock.wakeUps().size(); i++) {
+            sleptOneRefresh = clock.wakeUps()[i] == clock.presents()[firstSettling + i] +
+                    (period(30) - refresh60);
+        }
+        check(sleptOneRefresh, "the sleep is the settle period less the refresh the present covers");
+        check(scheduler.stats().nbrMissedDeadlines == 0, "no deadline is missed at the settle rate");
+
+        // a 20 ms frame at 60 fps misses a vsync.  The following frames are back on every vsync.
+        clock.work(milliseconds(20));
+        clock.present(refresh60);
+        scheduler.frameDone(false, true);
+        check(scheduler.stats().nbrMissedDeadlines == 1, "a present that skips a vsync is missed");
+        size_t afterMiss = clock.presents().size() - 1;
+        for (int i = 0; i < 10; i++) {
+            clock.work(milliseconds(5));
+            clock.present(refresh60);
+            scheduler.frameDone(false, true);
+        }
+        check(presentsEvery(clock, afterMiss, 1), "the frames after a miss are on every vsync again");
+        check(scheduler.stats().nbrMissedDeadlines == 1, "only the late present is missed");
+
+        // presents on a 120 Hz display, in which case a 60 fps frame sleeps for one refresh.
+        Scheduler fast(60, 30);
+        fast.setDisplayRefreshRate(120.0f);
+        FakeClock::duration refresh120 = std::chrono::duration_cast<FakeClock::duration>(
+                std::chrono::duration<float>(1.0f / 120.0f));
+        fast.start();
+        for (int i = 0; i < 20; i++) {
+            fast.clock().work(milliseconds(2));
+            fast.clock().present(refresh120);
+            fast.frameDone(false, true);
+        }
+        bool everyOther = true;
+        auto const &presents = fast.clock().presents();
+        for (size_t i = 1; i < presents.size(); i++) {
+            everyOther = everyOther && presents[i] - presents[i - 1] == 2 * refresh120;
+        }
+        check(everyOther && fast.stats().nbrMissedDeadlines == 0,
+              "60 fps on a 120 Hz display is every other vsync");
+    }
+
+    // What the simulation has published, as RainbowDice::simulationSnapshot returns it.
+    struct NullSnapshot {
+        bool allStopped;
+        bool anyRolling;
+    };
+
+    /* A renderer that draws nothing.  The dice roll for nbrRolling snapshots and then settle for
+     * nbrSettling more.  If noSnapshotEvery is not 0, every noSnapshotEvery turns there is no new
+     * snapshot, as when the simulation thread has not published one yet.  Drawing takes 4 ms and
+     * then presents on the next vsync.
+     */
+    class NullRenderer {
+    public:
+        NullRenderer(FakeClock &clock, uint32_t nbrRolling, uint32_t nbrSettling,
+                     uint32_t noSnapshotEvery)
+                : m_clock{clock},
+                  m_nbrRolling{nbrRolling},
+                  m_nbrSettling{nbrSettling},
+                  m_noSnapshotEvery{noSnapshotEvery},
+                  m_nbrTurns{0},
+                  m_nbrSnapshots{0},
+                  m_nbrDrawn{0},
+                  m_snapshot{false, true}
+        {}
+
+        bool applySimulationSnapshot() {
+            m_nbrTurns++;
+            if ((m_noSnapshotEvery != 0 && m_nbrTurns % m_noSnapshotEvery == 0) ||
+                m_snapshot.allStopped) {
+                return false;
+            }
+            m_nbrSnapshots++;
+            m_snapshot.anyRolling = m_nbrSnapshots < m_nbrRolling;
+            m_snapshot.allStopped = m_nbrSnapshots >= m_nbrRolling + m_nbrSettling;
+            return true;
+        }
+
+        void drawFrame() {
+            m_nbrDrawn++;
+            m_clock.work(milliseconds(4));
+            m_clock.present(refresh60);
+        }
+
+        NullSnapshot const &simulationSnapshot() const { return m_snapshot; }
+
+        // starts another roll, like a reroll does.
+        void reroll(uint32_t nbrRolling, uint32_t nbrSettling) {
+            m_nbrRolling = nbrRolling;
+            m_nbrSettling = nbrSettling;
+            m_nbrSnapshots = 0;
+            m_snapshot = NullSnapshot{false, true};
+        }
+
+        uint32_t nbrDrawn() const { return m_nbrDrawn; }
+        uint32_t nbrSnapshots() const { return m_nbrSnapshots; }
+
+    private:
+        FakeClock &m_clock;
+        uint32_t m_nbrRolling;
+        uint32_t m_nbrSettling;
+        uint32_t m_noSnapshotEvery;
+        uint32_t m_nbrTurns;
+        uint32_t m_nbrSnapshots;
+        uint32_t m_nbrDrawn;
+        NullSnapshot m_snapshot;
+    };
+
+    void testFrameLoop() {
+        // a snapshot every turn: the presents pace the rolling frames and the settling ones are on
+        // every other vsync.
+        {
+            Scheduler scheduler(60, 30);
+            scheduler.setDisplayRefreshRate(60.0f);
+            FakeClock &clock = scheduler.clock();
+            NullRenderer renderer(clock, 40, 20, 0);
+            scheduler.start();
+            runFrameLoop(renderer, scheduler,
+                    [](uint32_t &) { return true; },
+                    [](bool, bool) {},
+                    []() { return true; });
+
+            check(renderer.nbrDrawn() == 60, "every snapshot is drawn");
+            check(clock.presents().size() == 60, "every drawn frame is presented");
+            auto const &presents = clock.presents();
+            bool rollingEveryVsync = true;
+            for (size_t i = 1; i < 40; i++) {
+                rollingEveryVsync = rollingEveryVsync && presents[i] - presents[i - 1] == refresh60;
+            }
+            check(rollingEveryVsync, "rolling frames are presented on every vsync");
+            bool settlingEveryOther = true;
+            for (size_t i = 41; i < presents.size(); i++) {
+                settlingEveryOther = settlingEveryOther &&
+                        presents[i] - presents[i - 1] == 2 * refresh60;
+            }
+            check(settlingEveryOther, "settling frames are presented every other vsync");
+            check(scheduler.stats().nbrMissedDeadlines == 0, "no deadline is missed");
+        }
+
+        // no new snapshot every 4th turn, an event that needs a redraw and a reroll.
+        {
+            Scheduler scheduler(60, 30);
+            scheduler.setDisplayRefreshRate(60.0f);
+            FakeClock &clock = scheduler.clock();
+            NullRenderer renderer(clock, 40, 20, 4);
+
+            uint32_t nbrTurns = 0;
+            uint32_t nbrDrawnReported = 0;
+            uint32_t nbrMovedReported = 0;
+            uint32_t nbrStopped = 0;
+            scheduler.start();
+            runFrameLoop(renderer, scheduler,
+                    [&](uint32_t &nbrRequireRedraw) {
+                        // a scroll on a turn without a new snapshot.
+                        if (++nbrTurns == 12) {
+                            nbrRequireRedraw++;
+                        }
+                        return true;
+                    },
+                    [&](bool drew, bool moved) {
+                        nbrDrawnReported += drew ? 1 : 0;
+                        nbrMovedReported += moved ? 1 : 0;
+                    },
+                    [&]() {
+                        // the first time the dice stop, some of them are rerolled.
+                        if (nbrStopped++ == 0) {
+                            renderer.reroll(4, 4);
+                            return false;
+                        }
+                        return true;
+                    });
+
+            check(nbrStopped == 2, "the loop ends when the dice stop and there is no reroll");
+            check(renderer.nbrSnapshots() == 8, "the reroll's snapshots are drawn too");
+            check(nbrMovedReported == 60 + 8, "every new snapshot is reported as moved");
+            check(renderer.nbrDrawn() == nbrMovedReported + 1,
+                  "a frame is drawn for every new snapshot and for the event that needs a redraw");
+            check(nbrDrawnReported == renderer.nbrDrawn(), "every drawn frame is reported");
+            check(scheduler.stats().nbrFrames == nbrTurns - nbrStopped,
+                  "the scheduler waits after every turn except when the dice stop");
+            check(scheduler.stats().nbrMissedDeadlines == 0,
+                  "turns without a snapshot and the reroll do not miss deadlines");
+            bool onVsyncs = true;
+            for (auto const &present : clock.presents()) {
+                onVsyncs = onVsyncs && present.time_since_epoch() % refresh60 == FakeClock::duration::zero();
+            }
+            check(onVsyncs, "every present is on a vsync");
+        }
+
+        // the loop also ends when an event has to go to the waiting loop.
+        {
+            Scheduler scheduler(60, 30);
+            NullRenderer endless(scheduler.clock(), 1000, 0, 0);
+            uint32_t nbrTurns = 0;
+            scheduler.start();
+            runFrameLoop(endless, scheduler,
+                    [&](uint32_t &) { return ++nbrTurns < 5; },
+                    [](bool, bool) {},
+                    []() { return true; });
+            check(nbrTurns == 5 && endless.nbrDrawn() == 4,
+                  "the loop ends before drawing when the events say so");
+        }
+    }
+}
+
+int main() {
+    testSpacing();
+    testMissedDeadline();
+    testSettleRate();
+    testStatistics();
+    testVsync();
+    testFrameLoop();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,281 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Host test of the grouped vector the dice are kept in (groupedVector.hpp).  Build with the host
+ * target in app/CMakeLists.txt and run through ctest, or directly:
+ *
+ *   grouped-vector-test [--cases <n>]
+ *
+ * Besides the hand made cases for insert, erase, eraseIf, append and group growth, it applies n
+ * (20000 by default) random operations to a GroupedVector and to a vector of vectors and checks
+ * after each one that both hold the same values in the same groups.  The values are shared_ptrs,
+ * as in RainbowDiceGraphics, so that a value left behind in spare capacity shows up as an extra
+ * reference.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "groupedVector.hpp"
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, char const *what) {
+        if (!condition) {
+            fprintf(stderr, "FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    using Values = GroupedVector<std::shared_ptr<int>>;
+    using Model = std::vector<std::vector<std::shared_ptr<int>>>;
+
+    bool sameAs(Values const &values, Model const &model) {
+        if (values.nbrGroups() != model.size()) {
+            return false;
+        }
+        uint32_t size = 0;
+        uint32_t g = 0;
+        for (auto const &group : values) {
+            if (group.size() != model[g].size()) {
+                return false;
+            }
+            for (uint32_t i = 0; i < group.size(); i++) {
+                if (group[i] != model[g][i]) {
+                    return false;
+                }
+            }
+            size += group.size();
+            g++;
+        }
+        return size == values.size();
+    }
+
+    // every value is referenced once by the model and once by the grouped vector.
+    bool noStaleValues(Model const &model) {
+        for (auto const &group : model) {
+            for (auto const &value : group) {
+                if (value.use_count() != 2) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::vector<int> groupValues(Values const &values, uint32_t g) {
+        std::vector<int> out;
+        for (auto const &value : values.group(g)) {
+            out.push_back(*value);
+        }
+        return out;
+    }
+
+    void testAppendAndGrowth() {
+        Values values;
+        uint32_t first = values.addGroup();
+        uint32_t second = values.addGroup();
+        check(first == 0 && second == 1, "addGroup returns the group indices in order");
+        check(values.capacity() == 2, "a new group reserves a single entry");
+        check(values.empty() && values.group(0).empty(), "new groups are empty");
+
+        for (int i = 0; i < 9; i++) {
+            values.append(first, std::make_shared<int>(i));
+        }
+        values.append(second, std::make_shared<int>(100));
+
+        check(values.size() == 10, "size counts the values in all the groups");
+        check(groupValues(values, first) == std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8}),
+              "appending past the capacity keeps the values in order");
+        check(groupValues(values, second) == std::vector<int>({100}),
+              "growing one group does not disturb the others");
+
+        // the first group grew 1 -> 2 -> 4 -> 8 -> 16, the abandoned ranges are compacted away.
+        check(values.capacity() < 2 * (16 + 1), "abandoned ranges are reclaimed");
+        check(values.group(first).begin() + values.group(first).size() <=
+              values.group(second).begin() ||
+              values.group(second).begin() + 1 <= values.group(first).begin(),
+              "groups do not overlap");
+
+        try {
+            values.insert(first, 10, std::make_shared<int>(0));
+            check(false, "inserting past the end of a group throws");
+        } catch (std::out_of_range &) {
+        }
+        try {
+            values.append(2, std::make_shared<int>(0));
+            check(false, "appending to a missing group throws");
+        } catch (std::out_of_range &) {
+        }
+    }
+
+    void testInsertAndErase() {
+        Values values;
+        uint32_t g = values.addGroup(4);
+        values.append(g, std::make_shared<int>(1));
+        values.append(g, std::make_shared<int>(3));
+        values.insert(g, 1, std::make_shared<int>(2));
+        values.insert(g, 0, std::make_shared<int>(0));
+        check(groupValues(values, g) == std::vector<int>({0, 1, 2, 3}),
+              "insert puts the value before the given position");
+        check(values.capacity() == 4, "inserting within capacity does not grow the group");
+
+        auto erased = values.group(g)[1];
+        values.erase(g, 1);
+        check(groupValues(values, g) == std::vector<int>({0, 2, 3}),
+              "erase removes the value and keeps the order of the others");
+        check(erased.use_count() == 1, "erase releases the value");
+
+        values.erase(g, 2);
+        check(groupValues(values, g) == std::vector<int>({0, 2}), "erase of the last value");
+        check(values.size() == 2, "erase updates the size");
+
+        try {
+            values.erase(g, 2);
+            check(false, "erasing past the end of a group throws");
+        } catch (std::out_of_range &) {
+        }
+
+        values.clearGroup(g);
+        check(values.empty() && values.nbrGroups() == 1, "clearGroup keeps the empty group");
+        values.clear();
+        check(values.nbrGroups() == 0 && values.capacity() == 0, "clear removes the groups");
+    }
+
+    void testEraseIf() {
+        Values values;
+        Model model;
+        for (uint32_t g = 0; g < 4; g++) {
+            values.addGroup();
+            model.emplace_back();
+            for (int i = 0; i < 5; i++) {
+                auto value = std::make_shared<int>(static_cast<int>(g) * 10 + i);
+                values.append(g, value);
+                model[g].push_back(value);
+            }
+        }
+
+        uint32_t nbrErased = values.eraseIf([](std::shared_ptr<int> const &value) {
+            return *value % 2 == 0 || *value >= 30;
+        });
+        std::vector<std::weak_ptr<int>> erased;
+        for (auto &group : model) {
+            std::vector<std::shared_ptr<int>> kept;
+            for (auto &value : group) {
+                if (*value % 2 != 0 && *value < 30) {
+                    kept.push_back(value);
+                } else {
+                    erased.push_back(value);
+                }
+            }
+            group = kept;
+        }
+
+        check(nbrErased == 14, "eraseIf returns the number of values erased");
+        check(sameAs(values, model), "eraseIf keeps the order of the other values");
+        check(values.group(3).empty(), "eraseIf can empty a group");
+        check(noStaleValues(model), "eraseIf keeps one reference to the other values");
+        bool allReleased = true;
+        for (auto const &value : erased) {
+            allReleased = allReleased && value.expired();
+        }
+        check(allReleased, "eraseIf releases the erased values");
+    }
+
+    void testRandomOperations(uint32_t nbrCases) {
+        std::mt19937 rng{1234};
+        Values values;
+        Model model;
+        int next = 0;
+        uint32_t nbrMismatches = 0;
+
+        for (uint32_t i = 0; i < nbrCases; i++) {
+            uint32_t op = rng() % 10;
+            if (model.empty() || op == 0) {
+                values.addGroup();
+                model.emplace_back();
+            } else {
+                uint32_t g = static_cast<uint32_t>(rng() % model.size());
+                auto &group = model[g];
+                if (op <= 4) {
+                    auto value = std::make_shared<int>(next++);
+                    values.append(g, value);
+                    group.push_back(value);
+                } else if (op <= 6) {
+                    uint32_t position = static_cast<uint32_t>(rng() % (group.size() + 1));
+                    auto value = std::make_shared<int>(next++);
+                    values.insert(g, position, value);
+                    group.insert(group.begin() + position, value);
+                } else if (op <= 8 && !group.empty()) {
+                    uint32_t position = static_cast<uint32_t>(rng() % group.size());
+                    values.erase(g, position);
+                    group.erase(group.begin() + position);
+                } else {
+                    int modulus = 2 + static_cast<int>(rng() % 5);
+                    auto pred = [modulus](std::shared_ptr<int> const &value) {
+                        return *value % modulus == 0;
+                    };
+                    values.eraseIf(pred);
+                    for (auto &modelGroup : model) {
+                        modelGroup.erase(std::remove_if(modelGroup.begin(), modelGroup.end(), pred),
+                                         modelGroup.end());
+                    }
+                }
+            }
+
+            if (!sameAs(values, model) || !noStaleValues(model)) {
+                nbrMismatches++;
+            }
+        }
+
+        check(nbrMismatches == 0, "random operations match the vector of vectors");
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t nbrCases = 20000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+            nbrCases = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "Usage: %s [--cases <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    testAppendAndGrowth();
+    testInsertAndErase();
+    testEraseIf();
+    testRandomOperations(nbrCases);
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return 0;
+}
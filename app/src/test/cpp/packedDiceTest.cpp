@@ -0,0 +1,281 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Host test of the packed dice configuration format (packedDice.hpp).  Build with the host target
+ * in app/CMakeLists.txt and run through ctest, or directly:
+ *
+ *   packed-dice-test [--cases <n>]
+ *
+ * Besides the round trip and the hand made corruptions, it unpacks n (200000 by default)
+ * buffers that are either truncated or have up to four random bytes changed.  Each one has to either be rejected with a
+ * std::runtime_error or unpack to a set that packs and unpacks again unchanged, with its die
+ * counts and texture dimensions inside the limits in packedDice.hpp.  The host build
+ * compiles the tests with ASan and UBSan (ENGINE_TESTS_SANITIZE) so that a read outside the
+ * buffer fails the run too.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "packedDice.hpp"
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, char const *what) {
+        if (!condition) {
+            fprintf(stderr, "FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    std::shared_ptr<DiceDescription> makeDie(uint32_t nbrDice, std::vector<std::string> symbols,
+            bool hasValues, std::vector<float> color, std::vector<uint32_t> rerollOn,
+            bool isAddOperation) {
+        std::vector<std::shared_ptr<int32_t>> values;
+        for (size_t i = 0; i < symbols.size(); i++) {
+            values.push_back(hasValues ? std::make_shared<int32_t>(static_cast<int32_t>(i) - 2)
+                                       : std::shared_ptr<int32_t>());
+        }
+        return std::make_shared<DiceDescription>(nbrDice, std::move(symbols), std::move(values),
+                std::move(color), std::move(rerollOn), isAddOperation);
+    }
+
+    PackedDiceSet makeSet() {
+        PackedDiceSet set;
+        set.m_dice.push_back(makeDie(3, {"1", "2", "3", "4", "5", "6"}, true, {}, {5}, true));
+        set.m_dice.push_back(makeDie(1, {"\xe2\x98\x85", "blank", "\xe2\x99\xa5\xe2\x99\xa5"},
+                false, {0.25f, 0.5f, 0.75f, 1.0f}, {}, false));
+        set.m_dice.push_back(makeDie(12, {"-1", "0", "+1"}, true, {1.0f, 0.0f, 0.0f, 0.5f},
+                {0, 2}, true));
+
+        set.m_symbols = {"1", "2", "3", "4", "5", "6", "\xe2\x98\x85", "blank",
+                         "\xe2\x99\xa5\xe2\x99\xa5", "-1", "0", "+1"};
+        set.m_textureWidth = 512;
+        set.m_textureHeight = 1024;
+        for (size_t i = 0; i < set.m_symbols.size(); i++) {
+            float fraction = static_cast<float>(i) / set.m_symbols.size();
+            set.m_textureCoordLeft.push_back(0.0f);
+            set.m_textureCoordRight.push_back(1.0f);
+            set.m_textureCoordTop.push_back(fraction);
+            set.m_textureCoordBottom.push_back(fraction + 1.0f / set.m_symbols.size());
+        }
+        return set;
+    }
+
+    void putUInt32(std::vector<uint8_t> &data, size_t position, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            data[position + i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    // returns true if unpacking data throws a std::runtime_error (and nothing else).
+    bool rejects(std::vector<uint8_t> const &data) {
+        try {
+            PackedDiceSet::unpack(data.data(), data.size());
+        } catch (std::runtime_error const &) {
+            return true;
+        } catch (...) {
+            check(false, "unpack threw something other than std::runtime_error");
+            return true;
+        }
+        return false;
+    }
+
+    void testRoundTrip() {
+        std::vector<uint8_t> packed = makeSet().pack();
+        PackedDiceSet unpacked = PackedDiceSet::unpack(packed.data(), packed.size());
+        check(unpacked.pack() == packed, "pack, unpack, pack gives the same bytes");
+        check(unpacked.m_dice.size() == 3, "all the dice configurations are unpacked");
+        check(unpacked.m_dice[1]->m_color.size() == 4 && unpacked.m_dice[0]->m_color.empty(),
+              "the colors are unpacked");
+        check(unpacked.m_dice[2]->m_rerollOnIndices == std::vector<uint32_t>({0, 2}),
+              "the reroll indices are unpacked");
+        check(unpacked.m_dice[1]->m_values[0] == nullptr && *unpacked.m_dice[0]->m_values[5] == 3,
+              "the side values are unpacked");
+
+        PackedDiceSet empty;
+        std::vector<uint8_t> packedEmpty = empty.pack();
+        check(PackedDiceSet::unpack(packedEmpty.data(), packedEmpty.size()).pack() == packedEmpty,
+              "an empty set round trips");
+    }
+
+    void testTruncated() {
+        std::vector<uint8_t> packed = makeSet().pack();
+        bool allRejected = true;
+        for (size_t length = 0; length < packed.size(); length++) {
+            allRejected = rejects(std::vector<uint8_t>(packed.begin(), packed.begin() + length)) &&
+                    allRejected;
+        }
+        check(allRejected, "every truncated buffer is rejected");
+        check(rejects(std::vector<uint8_t>()), "an empty buffer is rejected");
+    }
+
+    void testMutated() {
+        std::vector<uint8_t> const packed = makeSet().pack();
+
+        // offsets into the first dice configuration (see the layout in packedDice.hpp).
+        size_t const nbrConfigurationsOffset = 4;
+        size_t const nbrDiceOffset = 4 + 4;
+        size_t const nbrSidesOffset = 4 + 4 + 4 + 1 + 1;
+
+        std::vector<uint8_t> data = packed;
+        putUInt32(data, 0, PackedDiceSet::m_version + 1);
+        check(rejects(data), "an unsupported version is rejected");
+
+        data = packed;
+        putUInt32(data, nbrConfigurationsOffset, 0xffffffff);
+        check(rejects(data), "a configuration count larger than the data is rejected");
+
+        data = packed;
+        putUInt32(data, nbrDiceOffset, 0xffffffff);
+        check(rejects(data), "a die count of 0xffffffff is rejected");
+
+        data = packed;
+        putUInt32(data, nbrDiceOffset, PackedDiceSet::m_maxNbrDice + 1);
+        check(rejects(data), "a die count above the maximum is rejected");
+
+        data = packed;
+        putUInt32(data, nbrDiceOffset, PackedDiceSet::m_maxNbrDice);
+        check(!rejects(data), "the maximum die count is accepted");
+
+        data = packed;
+        putUInt32(data, nbrSidesOffset, 0);
+        check(rejects(data), "a die without sides is rejected");
+
+        data = packed;
+        putUInt32(data, nbrSidesOffset, 0x10000000);
+        check(rejects(data), "a side count larger than the data is rejected");
+
+        data = packed;
+        putUInt32(data, nbrSidesOffset + 4, 0xfffffff0);
+        check(rejects(data), "a symbol length larger than the data is rejected");
+
+        // the first die has six one byte symbols, each packed with its value, and then one
+        // reroll index.
+        size_t const sideSize = 4 + 1 + 1 + 4;
+        size_t const rerollOffset = nbrSidesOffset + 4 + 6 * sideSize + 4;
+        data = packed;
+        putUInt32(data, rerollOffset, 6);
+        check(rejects(data), "a reroll index past the last side is rejected");
+
+        // the texture width and height come right before the four arrays of texture coordinates.
+        size_t const textureWidthOffset = packed.size() - 4 * 4 * makeSet().m_symbols.size() - 8;
+        data = packed;
+        putUInt32(data, textureWidthOffset, static_cast<uint32_t>(-1));
+        check(rejects(data), "a negative texture width is rejected");
+
+        data = packed;
+        putUInt32(data, textureWidthOffset + 4, PackedDiceSet::m_maxTextureSize + 1);
+        check(rejects(data), "a texture height above the maximum is rejected");
+
+        data = packed;
+        data.push_back(0);
+        check(rejects(data), "extra data at the end is rejected");
+    }
+
+    /* Half of the cases are truncated and the other half mutated.  Every truncated buffer has to be
+     * rejected.  A mutated buffer may still be a valid set (e.g.
+     * a changed texture coordinate), but then it has to pack and unpack again to the same set.
+     */
+    void testFuzz(uint32_t nbrCases) {
+        std::vector<uint8_t> const packed = makeSet().pack();
+        std::mt19937 generator(43);
+        std::uniform_int_distribution<size_t> position(0, packed.size() - 1);
+        std::uniform_int_distribution<int> byte(0, 255);
+        std::uniform_int_distribution<int> nbrChanges(1, 4);
+
+        uint32_t rejected = 0;
+        uint32_t accepted = 0;
+        bool truncatedRejected = true;
+        bool acceptedRoundTrips = true;
+        bool acceptedWithinLimits = true;
+        for (uint32_t i = 0; i < nbrCases; i++) {
+            std::vector<uint8_t> data = packed;
+            bool truncated = i % 2 == 0;
+            if (truncated) {
+                data.resize(position(generator));
+            } else {
+                for (int j = nbrChanges(generator); j > 0; j--) {
+                    data[position(generator)] = static_cast<uint8_t>(byte(generator));
+                }
+            }
+
+            // the buffer is copied to its own allocation so that ASan sees any read past its end.
+            std::unique_ptr<uint8_t[]> buffer{new uint8_t[data.size()]};
+            std::memcpy(buffer.get(), data.data(), data.size());
+            try {
+                PackedDiceSet set = PackedDiceSet::unpack(buffer.get(), data.size());
+                accepted++;
+                truncatedRejected = truncatedRejected && !truncated;
+                for (auto const &die : set.m_dice) {
+                    acceptedWithinLimits = acceptedWithinLimits &&
+                            die->m_nbrDice <= PackedDiceSet::m_maxNbrDice;
+                }
+                acceptedWithinLimits = acceptedWithinLimits &&
+                        set.m_textureWidth >= 0 && set.m_textureWidth <= PackedDiceSet::m_maxTextureSize &&
+                        set.m_textureHeight >= 0 && set.m_textureHeight <= PackedDiceSet::m_maxTextureSize;
+                std::vector<uint8_t> repacked = set.pack();
+                acceptedRoundTrips = acceptedRoundTrips &&
+                        PackedDiceSet::unpack(repacked.data(), repacked.size()).pack() == repacked;
+            } catch (std::runtime_error const &) {
+                rejected++;
+            } catch (...) {
+                check(false, "unpack threw something other than std::runtime_error");
+            }
+        }
+
+        check(truncatedRejected, "every truncated buffer is rejected");
+        check(acceptedRoundTrips, "every mutated buffer that is accepted round trips");
+        check(acceptedWithinLimits, "every buffer that is accepted has its counts and sizes bounded");
+        fprintf(stderr, "fuzz: %u cases, %u rejected, %u accepted\n", nbrCases, rejected, accepted);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t nbrCases = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+            nbrCases = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else {
+            fprintf(stderr, "Usage: %s [--cases <n>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    testRoundTrip();
+    testTruncated();
+    testMutated();
+    testFuzz(nbrCases);
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,329 @@
+/**
+ * Copyright 2019 Cerulean Quasar. All Rights Reserved.
+ *
+ *  This file is part of RainbowDice.
+ *
+ *  RainbowDice is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  RainbowDice is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with RainbowDice.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* Host test of the resident texture atlas (textureAtlasManager.hpp).  Build with the host target
+ * in app/CMakeLists.txt and run through ctest, or directly:
+ *
+ *   texture-atlas-manager-test
+ *
+ * It merges a sequence of atlases the way the renderer gets them from Java: the same symbols laid
+ * out differently, new symbols, a symbol drawn differently, more symbols than fit and a new
+ * format.  After each merge, every symbol of the atlas just merged has to show the same texels
+ * in the resident atlas as in its source atlas, and so does every symbol still resident from an
+ * earlier merge.  When the resident atlas is only added to, the regions returned are exactly the
+ * slots of the new symbols.  The ShelfPacker is also checked on its own: its rectangles stay
+ * inside it and never overlap.
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "textureAtlasManager.hpp"
+
+namespace {
+    int failures = 0;
+
+    void check(bool condition, char const *what) {
+        if (!condition) {
+            fprintf(stderr, "FAILED: %s\n", what);
+            failures++;
+        }
+    }
+
+    // the texels of one symbol, the same in every atlas it is drawn in unless its style changes.
+    struct Glyph {
+        uint32_t width;
+        uint32_t height;
+        std::vector<unsigned char> texels;
+    };
+
+    // the style only changes the texels, so that the texels have to be compared to notice it.
+    Glyph makeGlyph(std::string const &symbol, uint32_t style, uint32_t texelSize) {
+        uint32_t hash = 17;
+        for (char c : symbol) {
+            hash = hash * 31 + static_cast<unsigned char>(c);
+        }
+        Glyph glyph{8 + hash % 40, 8 + (hash / 64) % 24, {}};
+        glyph.texels.resize(glyph.width * glyph.height * texelSize);
+        for (size_t i = 0; i < glyph.texels.size(); i++) {
+            glyph.texels[i] = static_cast<unsigned char>(1 + (hash + style + i * 7) % 255);
+        }
+        return glyph;
+    }
+
+    /* An atlas of the symbols in order, on rows width texels wide, with gaps between them.  The
+     * offset shifts every glyph so that the same symbols land somewhere else than in another
+     * atlas.  A symbol in styled is drawn in a different style.
+     */
+    std::shared_ptr<TextureAtlas> makeAtlas(std::vector<std::string> const &symbols,
+            TextureFormat format, uint32_t offset = 0, std::vector<std::string> const &styled = {}) {
+        uint32_t texelSize = bytesPerTexel(format);
+        uint32_t width = 512;
+        std::vector<Glyph> glyphs;
+        std::vector<AtlasRegion> regions;
+        uint32_t x = offset;
+        uint32_t y = 3;
+        uint32_t rowHeight = 0;
+        for (auto const &symbol : symbols) {
+            bool isStyled = std::find(styled.begin(), styled.end(), symbol) != styled.end();
+            glyphs.push_back(makeGlyph(symbol, isStyled ? 1 : 0, texelSize));
+            if (x + glyphs.back().width + 3 > width) {
+                x = offset;
+                y += rowHeight + 3;
+                rowHeight = 0;
+            }
+            regions.push_back(AtlasRegion{x, y, glyphs.back().width, glyphs.back().height});
+            x += glyphs.back().width + 3;
+            rowHeight = std::max(rowHeight, glyphs.back().height);
+        }
+        uint32_t height = y + rowHeight + 3;
+
+        uint32_t length = width * height * texelSize;
+        std::shared_ptr<unsigned char> bitmap(new unsigned char[length](),
+                                              std::default_delete<unsigned char[]>());
+        std::vector<TextureImage> images;
+        for (size_t i = 0; i < symbols.size(); i++) {
+            AtlasRegion const &region = regions[i];
+            for (uint32_t row = 0; row < region.height; row++) {
+                std::copy_n(glyphs[i].texels.begin() + row * region.width * texelSize,
+                            region.width * texelSize,
+                            bitmap.get() + ((region.y + row) * width + region.x) * texelSize);
+            }
+            images.push_back(TextureImage{static_cast<float>(region.x) / width,
+                                          static_cast<float>(region.x + region.width) / width,
+                                          static_cast<float>(region.y) / height,
+                                          static_cast<float>(region.y + region.height) / height});
+        }
+        return std::make_shared<TextureAtlas>(width, height, format, symbols, images,
+                                              std::shared_ptr<unsigned char const>(bitmap), length);
+    }
+
+    // the texels a symbol covers in an atlas, from its texture coordinates.
+    AtlasRegion symbolRegion(TextureAtlas &atlas, std::string const &symbol) {
+        TextureImage const &image = atlas.getTextureCoordinates(atlas.symbolId(symbol));
+        float width = atlas.getImageWidth();
+        float height = atlas.getImageHeight();
+        auto x0 = static_cast<uint32_t>(std::lround(image.left * width));
+        auto x1 = static_cast<uint32_t>(std::lround(image.right * width));
+        auto y0 = static_cast<uint32_t>(std::lround(image.top * height));
+        auto y1 = static_cast<uint32_t>(std::lround(image.bottom * height));
+        return AtlasRegion{x0, y0, x1 - x0, y1 - y0};
+    }
+
+    std::vector<unsigned char> texels(TextureAtlas &atlas, AtlasRegion const &region) {
+        std::vector<unsigned char> out;
+        copyAtlasRegion(atlas, region, out);
+        return out;
+    }
+
+    bool sameRegion(AtlasRegion const &a, AtlasRegion const &b) {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+    }
+
+    bool overlap(AtlasRegion const &a, AtlasRegion const &b) {
+        return a.x < b.x + b.width && b.x < a.x + a.width &&
+               a.y < b.y + b.height && b.y < a.y + a.height;
+    }
+
+    bool inside(AtlasRegion const &region, uint32_t width, uint32_t height) {
+        return region.x + region.width <= width && region.y + region.height <= height;
+    }
+
+    class MergeChecker {
+    public:
+        /* Merges atlas and checks the resident atlas against it.  Returns the update so that the
+         * caller can check whether it was rebuilt.
+         */
+        TextureAtlasManager::Update merge(std::shared_ptr<TextureAtlas> const &atlas,
+                                          char const *step) {
+            uint64_t generation = m_manager.generation();
+            TextureAtlasManager::Update update = m_manager.merge(atlas);
+            TextureAtlas &resident = *m_manager.atlas();
+            fprintf(stderr, "%s: %s, %zu regions, resident atlas %ux%u\n", step,
+                    update.m_rebuilt ? "rebuilt" : "added to", update.m_regions.size(),
+                    resident.getImageWidth(), resident.getImageHeight());
+
+            if (update.m_rebuilt) {
+                check(m_manager.atlas() == atlas || m_manager.generation() != generation,
+                      "a rebuild changes the generation");
+                check(update.m_regions.empty(), "a rebuild uploads everything, not regions");
+                m_resident.clear();
+            } else {
+                check(m_manager.generation() == generation,
+                      "adding to the resident atlas keeps the generation");
+            }
+
+            // every symbol of the atlas merged shows its texels in the resident atlas.
+            std::vector<AtlasRegion> added;
+            bool allMatch = true;
+            for (auto const &symbol : atlas->symbols()) {
+                AtlasRegion region = symbolRegion(resident, symbol);
+                allMatch = allMatch && inside(region, resident.getImageWidth(),
+                                              resident.getImageHeight()) &&
+                        texels(resident, region) == texels(*atlas, symbolRegion(*atlas, symbol));
+                if (m_resident.count(symbol) == 0) {
+                    added.push_back(region);
+                }
+                m_resident[symbol] = texels(*atlas, symbolRegion(*atlas, symbol));
+            }
+            check(allMatch, "every symbol merged has the texels of its source atlas");
+
+            // so does every symbol still there from an earlier merge, and no two slots overlap.
+            bool residentMatch = true;
+            bool noOverlap = true;
+            std::vector<AtlasRegion> regions;
+            for (auto const &symbol : m_resident) {
+                AtlasRegion region = symbolRegion(resident, symbol.first);
+                residentMatch = residentMatch && texels(resident, region) == symbol.second;
+                for (auto const &other : regions) {
+                    noOverlap = noOverlap && !overlap(region, other);
+                }
+                regions.push_back(region);
+            }
+            check(residentMatch, "the symbols merged before keep their texels");
+            check(noOverlap, "no two symbols share texels in the resident atlas");
+
+            if (!update.m_rebuilt) {
+                bool exact = update.m_regions.size() == added.size();
+                for (size_t i = 0; exact && i < added.size(); i++) {
+                    exact = sameRegion(update.m_regions[i], added[i]);
+                }
+                check(exact, "the regions returned are exactly the slots of the new symbols");
+            }
+            return update;
+        }
+
+        TextureAtlasManager &manager() { return m_manager; }
+
+    private:
+        TextureAtlasManager m_manager;
+        // the symbols expected in the resident atlas and their texels.
+        std::map<std::string, std::vector<unsigned char>> m_resident;
+    };
+
+    std::vector<std::string> numbers(uint32_t first, uint32_t last) {
+        std::vector<std::string> symbols;
+        for (uint32_t i = first; i <= last; i++) {
+            symbols.push_back(std::to_string(i));
+        }
+        return symbols;
+    }
+
+    void testMerge() {
+        MergeChecker checker;
+
+        auto d6 = makeAtlas(numbers(1, 6), TextureFormat::alpha8);
+        check(checker.merge(d6, "d6").m_rebuilt, "the first atlas builds the resident atlas");
+
+        auto update = checker.merge(d6, "d6 again");
+        check(!update.m_rebuilt && update.m_regions.empty(), "merging the same atlas does nothing");
+
+        update = checker.merge(makeAtlas(numbers(1, 6), TextureFormat::alpha8, 17), "d6 moved");
+        check(!update.m_rebuilt && update.m_regions.empty(),
+              "the same symbols laid out elsewhere upload nothing");
+
+        update = checker.merge(makeAtlas(numbers(1, 8), TextureFormat::alpha8, 5), "d8");
+        check(!update.m_rebuilt && update.m_regions.size() == 2,
+              "two new symbols are added in place");
+
+        std::vector<std::string> mixed = numbers(7, 10);
+        mixed.push_back("\xe2\x98\x85");
+        update = checker.merge(makeAtlas(mixed, TextureFormat::alpha8), "d10 and a star");
+        check(!update.m_rebuilt && update.m_regions.size() == 3,
+              "only the symbols not resident yet are added");
+
+        update = checker.merge(makeAtlas(numbers(1, 6), TextureFormat::alpha8, 0, {"3"}),
+                               "d6 with a new 3");
+        check(update.m_rebuilt, "a symbol drawn differently rebuilds the resident atlas");
+
+        // keep adding symbols until they do not fit any more.
+        bool grew = false;
+        uint32_t width = checker.manager().atlas()->getImageWidth();
+        for (uint32_t last = 20; last <= 200 && !grew; last += 20) {
+            update = checker.merge(makeAtlas(numbers(1, last), TextureFormat::alpha8, 0, {"3"}),
+                                   "more symbols");
+            grew = update.m_rebuilt;
+        }
+        check(grew && checker.manager().atlas()->getImageWidth() > width,
+              "the resident atlas grows when the new symbols do not fit");
+
+        update = checker.merge(makeAtlas(numbers(1, 6), TextureFormat::rgba8), "rgba d6");
+        check(update.m_rebuilt && checker.manager().atlas()->format() == TextureFormat::rgba8,
+              "a new format rebuilds the resident atlas");
+
+        update = checker.merge(makeAtlas(numbers(1, 12), TextureFormat::rgba8, 9), "rgba d12");
+        check(!update.m_rebuilt && update.m_regions.size() == 6,
+              "rgba symbols are added in place too");
+    }
+
+    void testShelfPacker() {
+        std::mt19937 generator(49);
+        std::uniform_int_distribution<uint32_t> size(1, 60);
+
+        ShelfPacker packer{256, 256};
+        std::vector<AtlasRegion> regions;
+        uint32_t nbrRefused = 0;
+        bool allInside = true;
+        bool noOverlap = true;
+        for (int i = 0; i < 500; i++) {
+            AtlasRegion region{};
+            uint32_t width = size(generator);
+            uint32_t height = size(generator);
+            if (!packer.allocate(width, height, region)) {
+                nbrRefused++;
+                continue;
+            }
+            allInside = allInside && region.width == width && region.height == height &&
+                    inside(region, 256, 256);
+            for (auto const &other : regions) {
+                noOverlap = noOverlap && !overlap(region, other);
+            }
+            regions.push_back(region);
+        }
+        check(allInside, "the packer's rectangles have the size asked for and stay inside it");
+        check(noOverlap, "the packer's rectangles never overlap");
+        check(!regions.empty() && nbrRefused > 0, "the packer fills up");
+
+        AtlasRegion region{};
+        ShelfPacker empty{64, 32};
+        check(empty.allocate(64, 32, region) && region.x == 0 && region.y == 0,
+              "a rectangle the size of the packer fits");
+        check(!empty.allocate(1, 1, region), "a full packer refuses more");
+        check(!ShelfPacker{64, 32}.allocate(65, 1, region), "a rectangle too wide is refused");
+    }
+}
+
+int main() {
+    testMerge();
+    testShelfPacker();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return 0;
+}